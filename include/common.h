@@ -1,6 +1,10 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // recvmmsg/sendmmsg等Linux扩展接口
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,9 +16,13 @@
 #include <errno.h>
 #include <signal.h>
 #include <stdint.h>
+#include <pthread.h>
 #include <sys/time.h>
+#include "histogram.h"
 
 #define MAX_BUFFER_SIZE 65507  // UDP最大数据包大小
+#define MAX_BATCH_SIZE 1024     // recvmmsg/sendmmsg单次最大包数（UIO_MAXIOV）
+#define CACHE_LINE_SIZE 64      // 每线程数据按缓存行对齐，避免伪共享
 #define DEFAULT_PORT 8888
 #define DEFAULT_SERVER_IP "0.0.0.0"
 #define DEFAULT_CLIENT_IP "192.168.1.100"  // TC3开发板IP
@@ -27,7 +35,7 @@ typedef enum {
     PKT_TYPE_ACK = 0x04
 } packet_type_t;
 
-// 性能测试数据包结构
+// 性能测试数据包结构（v1旧格式：主机字节序，gettimeofday()墙上时间）
 typedef struct {
     uint32_t seq_num;          // 序列号
     uint32_t timestamp_sec;     // 时间戳（秒）
@@ -36,6 +44,42 @@ typedef struct {
     char data[0];               // 数据内容
 } perf_packet_t;
 
+#define PERF_MAGIC 0x55445050   // "UDPP"
+#define PERF_VERSION_LEGACY 1
+#define PERF_VERSION 2
+
+// 时间戳时钟源
+typedef enum {
+    PERF_CLOCK_MONOTONIC_RAW = 0,  // 本机单调时钟，不受NTP调整影响（RTT、本机回环）
+    PERF_CLOCK_TAI = 1,            // 国际原子时，跨主机单向延迟（两端需PTP同步）
+    PERF_CLOCK_REALTIME = 2        // 墙上时间（v1旧格式）
+} perf_clock_t;
+
+// 性能测试数据包结构（v2：网络字节序，64位纳秒时间戳）
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // PERF_MAGIC
+    uint8_t version;            // PERF_VERSION
+    uint8_t clock_id;           // perf_clock_t
+    uint16_t header_len;        // 头部长度（便于后续扩展字段）
+    uint32_t flow_id;           // 流标识
+    uint32_t seq_num;           // 序列号
+    uint64_t timestamp_ns;      // 发送时间戳（纳秒）
+    uint32_t data_len;          // 数据长度
+    uint32_t reserved;
+    char data[0];               // 数据内容
+} perf_packet_v2_t;
+
+// 解析后的性能测试包头（主机字节序，v1/v2通用）
+typedef struct {
+    uint8_t version;
+    uint8_t clock_id;
+    uint16_t header_len;
+    uint32_t flow_id;
+    uint32_t seq_num;
+    uint64_t timestamp_ns;
+    uint32_t data_len;
+} perf_header_t;
+
 // 统计信息结构
 typedef struct {
     uint64_t packets_sent;
@@ -47,6 +91,7 @@ typedef struct {
     double max_latency_ms;
     double avg_latency_ms;
     double total_latency_ms;
+    latency_hist_t latency_hist;   // 延迟分布（纳秒），用于计算尾延迟百分位
     struct timeval start_time;
     struct timeval end_time;
 } stats_t;
@@ -60,16 +105,26 @@ typedef struct {
     double *durations;             // 每轮的耗时 (秒)
     uint64_t *packets_sent_total;  // 每轮的发送包数
     uint64_t *packets_received_total; // 每轮的接收包数
+    latency_hist_t latency_hist;   // 所有轮次合并后的延迟分布
 } multi_iteration_stats_t;
 
 // 函数声明
 void print_stats(stats_t *stats);
+void merge_stats(stats_t *dst, const stats_t *src);
+void print_latency_percentiles(const latency_hist_t *hist);
+void format_latency(double latency_ms, char *buf, size_t buf_size);
 void print_multi_iteration_stats(multi_iteration_stats_t *multi_stats);
 void free_multi_iteration_stats(multi_iteration_stats_t *multi_stats);
-double get_time_ms(void);
+double get_time_ms(void);             // 周期计数器时钟，仅用于进程内的时间间隔
 uint64_t get_time_us(void);
+uint64_t get_time_ns(int clock_id);   // 内核时钟，用于包头时间戳和跨进程比较
+size_t perf_header_size(int version);
+void perf_packet_init(void *buf, int version, int clock_id, uint32_t flow_id, uint32_t data_len);
+void perf_packet_stamp(void *buf, int version, uint32_t seq_num, uint64_t timestamp_ns);
+int perf_packet_parse(const void *buf, size_t len, perf_header_t *hdr);
 int create_udp_socket(void);
 int bind_socket(int sockfd, const char *ip, int port);
+int start_background_thread(pthread_t *thread, void *(*fn)(void *), void *arg);
 void print_usage(const char *program_name);
 
 #endif // COMMON_H
@@ -0,0 +1,78 @@
+#ifndef FLOWTAB_H
+#define FLOWTAB_H
+
+#include <stdint.h>
+#include "histogram.h"
+#include "seqwin.h"
+
+// 按发送端区分的流表：多个TC3开发板或客户端进程发往同一端口时，各自的序列号空间互不干扰
+// 开放寻址（线性探测）哈希表，表项来自固定大小的池，内存上限为max_flows个表项
+#define FLOWTAB_DEFAULT_MAX_FLOWS 256
+#define FLOWTAB_DEFAULT_IDLE_SEC  30    // 超过该时间未收到包的流被淘汰，0表示不淘汰
+
+// 流标识：源地址、源端口（网络字节序）及v2包头中的流ID（v1旧格式为0）
+typedef struct {
+    uint32_t addr;
+    uint16_t port;
+    uint32_t flow_id;
+} flow_key_t;
+
+typedef struct {
+    flow_key_t key;
+    uint32_t hash;
+    int in_use;
+    uint64_t first_seen_ns;
+    uint64_t last_seen_ns;
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t lost;              // 最近一次记录的丢失数，用于增量维护全表丢失数
+    uint64_t max_ts_ns;         // 见过的最大发送时间戳，用于识别发送端重新编号
+    uint32_t restarts;          // 发送端重新编号的次数
+    seq_stats_t prev_seq;       // 重新编号之前各段的序列号统计（窗口内缺失已计为丢失）
+    uint64_t latency_sum_ns;
+    latency_hist_t latency;
+    seqwin_t win;               // 窗口位图在表项首次使用时分配，之后随表项复用
+} flow_t;
+
+typedef struct {
+    flow_t *flows;              // 表项池
+    uint32_t *free_list;        // 空闲表项下标栈
+    uint32_t free_count;
+    uint32_t *slots;            // 哈希槽：0为空，否则为表项下标+1
+    uint32_t slot_mask;
+    uint32_t max_flows;
+    uint32_t count;             // 活跃流数
+    uint32_t window;            // 每流序列号窗口大小
+    uint64_t idle_ns;
+    uint64_t next_sweep_ns;
+    uint64_t next_expiry_ns;    // 活跃流中最早可能空闲超时的时间（上次扫描时计算）
+    uint64_t lost;              // 全部流的丢失数（活跃流当前值 + 已淘汰流）
+    uint64_t reordered;         // 全部流的乱序到达数（供周期报告无锁读取）
+    uint64_t flows_created;
+    uint64_t flows_evicted;
+    uint64_t overflow_packets;  // 表满且没有空闲流可淘汰时未能跟踪的包
+    uint64_t evicted_packets;
+    uint64_t evicted_bytes;
+    seq_stats_t evicted_seq;    // 已淘汰流的序列号统计（淘汰时窗口内仍缺失的计为丢失）
+} flowtab_t;
+
+// max_flows为活跃流上限，window为每流序列号窗口；成功返回0
+int flowtab_init(flowtab_t *tab, uint32_t max_flows, uint32_t window, uint32_t idle_sec);
+void flowtab_free(flowtab_t *tab);
+
+// 查找流，不存在时创建（表满时先淘汰空闲流）；无法创建时返回NULL并计入overflow_packets
+// 同时按周期淘汰空闲超时的流
+flow_t *flowtab_lookup(flowtab_t *tab, const flow_key_t *key, uint64_t now_ns);
+
+// 登记流上收到的序列号（ts_ns为包头中的发送时间戳，0表示未知），并更新全表丢失数
+// 序列号落后于窗口顶端而发送时间戳比见过的都新时，判定发送端重新从头编号（客户端多轮测试每轮从0开始），
+// 之前的窗口统计并入prev_seq后重置窗口，而不是把新一轮的包计为重复或迟到
+void flowtab_record_seq(flowtab_t *tab, flow_t *flow, uint32_t seq_num, uint64_t ts_ns);
+
+// 全表序列号统计：活跃流快照 + 已淘汰流
+void flowtab_seq_stats(const flowtab_t *tab, seq_stats_t *out);
+
+// 打印一组流（可来自多个线程的流表），按源地址、端口、流ID排序；now_ns用于计算空闲时间
+void flow_print_report(const flow_t **flows, int count, uint64_t now_ns);
+
+#endif // FLOWTAB_H
@@ -0,0 +1,58 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+// 对数-线性延迟直方图（类HdrHistogram），固定内存，单位纳秒
+// 每个2的幂区间划分为64个线性子桶，相对误差 < 1/64 (~0.8%)，覆盖 0 ~ 2^34 ns (~17秒)
+#define LAT_HIST_SUB_BITS 7
+#define LAT_HIST_SUB_COUNT (1 << LAT_HIST_SUB_BITS)          // 首个区间的桶数 (128)
+#define LAT_HIST_HALF_COUNT (LAT_HIST_SUB_COUNT / 2)         // 其余区间的桶数 (64)
+#define LAT_HIST_MAX_BITS 34
+#define LAT_HIST_HIGHEST_NS ((1ULL << LAT_HIST_MAX_BITS) - 1) // 超出部分计入最后一个桶
+#define LAT_HIST_COUNTS (LAT_HIST_SUB_COUNT + \
+                         (LAT_HIST_MAX_BITS - LAT_HIST_SUB_BITS) * LAT_HIST_HALF_COUNT)
+
+typedef struct {
+    uint64_t total_count;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t counts[LAT_HIST_COUNTS];
+} latency_hist_t;
+
+// 计算值所在桶的下标：一次clz、一次移位
+static inline uint32_t hist_index(uint64_t value_ns) {
+    if (value_ns < LAT_HIST_SUB_COUNT) {
+        return (uint32_t)value_ns;
+    }
+    uint32_t shift = (63 - __builtin_clzll(value_ns)) - (LAT_HIST_SUB_BITS - 1);
+    return LAT_HIST_SUB_COUNT + (shift - 1) * LAT_HIST_HALF_COUNT +
+           (uint32_t)(value_ns >> shift) - LAT_HIST_HALF_COUNT;
+}
+
+// 记录一个延迟样本（无内存分配）
+static inline void hist_record(latency_hist_t *hist, uint64_t value_ns) {
+    if (value_ns > LAT_HIST_HIGHEST_NS) {
+        value_ns = LAT_HIST_HIGHEST_NS;
+    }
+    hist->counts[hist_index(value_ns)]++;
+    if (hist->total_count == 0 || value_ns < hist->min_ns) {
+        hist->min_ns = value_ns;
+    }
+    if (value_ns > hist->max_ns) {
+        hist->max_ns = value_ns;
+    }
+    hist->total_count++;
+}
+
+void hist_reset(latency_hist_t *hist);
+void hist_merge(latency_hist_t *dst, const latency_hist_t *src);
+uint64_t hist_value_at_percentile(const latency_hist_t *hist, double percentile);
+
+// 累加另一线程正在写入的直方图：逐桶原子读取，不加锁（各桶之间不是同一时刻的一致快照）
+void hist_accumulate_live(latency_hist_t *dst, const latency_hist_t *src);
+
+// 两次累计快照之差（cur - prev）：总数和最小/最大值由各桶的增量重新得出
+void hist_delta(latency_hist_t *out, const latency_hist_t *cur, const latency_hist_t *prev);
+
+#endif // HISTOGRAM_H
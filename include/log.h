@@ -0,0 +1,69 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// 异步日志：调用线程只把格式化后的消息放入无锁环，由后台线程写到终端，
+// 终端/管道的写入速度不再拖慢收发循环
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN  1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+
+// 编译期级别：高于该级别的日志调用是常量假分支，连同参数求值一起被编译器删除
+// 例如 make LOG_LEVEL=1 只保留错误和警告
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_DEFAULT_RATE 50     // 每类消息每秒最多输出的条数，超出部分只计数
+#define LOG_RING_SIZE    1024   // 日志环槽数（2的幂），环满时丢弃新消息并计数
+#define LOG_MSG_MAX      256    // 单条消息的最大长度（超出部分截断）
+
+// 消息类型：每个日志调用点一个静态实例，按调用点独立限速
+typedef struct log_site {
+    const char *fmt;
+    int level;
+    _Atomic uint64_t window;        // 当前限速窗口（秒）
+    _Atomic uint32_t count;         // 当前窗口内已输出的条数
+    _Atomic uint64_t suppressed;    // 自上次汇总以来被抑制的条数
+    _Atomic int registered;
+    struct log_site *next;          // 已登记调用点链表（用于周期汇总抑制计数）
+} log_site_t;
+
+extern int log_level;               // 运行期级别（不超过编译期级别）
+extern uint32_t log_rate;           // 每类消息每秒条数上限，0表示不限速
+
+// 启动后台写日志线程；未启动时日志同步写出
+int log_init(void);
+
+// 等待已入环的日志写出（打印汇总报告前调用，保证输出顺序）
+void log_flush(void);
+
+// 停止后台线程，写出剩余消息、抑制计数和环满丢弃计数
+void log_shutdown(void);
+
+// 限速判定：返回非0表示本条消息可以输出
+int log_admit(log_site_t *site);
+void log_emit(log_site_t *site, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// 解析级别名称（error、warn、info、debug）
+int parse_log_level(const char *str, int *level);
+
+// 级别或限速不通过时不求值参数（inet_ntop()等转换可以直接写在参数中）
+#define LOG_AT(lvl, format, ...) do { \
+    if ((lvl) <= LOG_COMPILE_LEVEL && (lvl) <= log_level) { \
+        static log_site_t log_site_ = { .fmt = format, .level = (lvl) }; \
+        if (log_admit(&log_site_)) { \
+            log_emit(&log_site_, format, ##__VA_ARGS__); \
+        } \
+    } \
+} while (0)
+
+#define LOG_ERROR(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...)  LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...)  LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+#endif // LOG_H
@@ -0,0 +1,49 @@
+#ifndef LOWLAT_H
+#define LOWLAT_H
+
+#include <stddef.h>
+
+// 低延迟配置：socket忙轮询、非阻塞自旋接收、绑定隔离核、可选SCHED_FIFO与mlockall、预先缺页
+// 去掉阻塞接收的睡眠/唤醒抖动，用于控制回路延迟测试（代价是每个接收线程占满一个核）
+#define LOWLAT_DEFAULT_BUSY_POLL_US 50    // SO_BUSY_POLL：阻塞接收前在网卡队列上忙轮询的时长
+#define LOWLAT_BUSY_POLL_BUDGET     64    // SO_BUSY_POLL_BUDGET：每次忙轮询最多处理的包数
+#define LOWLAT_MAX_CPUS             256
+
+typedef struct {
+    int enabled;
+    int compare;              // 客户端：默认模式与低延迟模式交替运行并对比延迟分布
+    int busy_poll_us;
+    int rt_prio;              // SCHED_FIFO优先级，0表示保持默认调度策略
+    int mlock;                // 是否mlockall()锁定全部内存
+    int cpus[LOWLAT_MAX_CPUS];
+    int num_cpus;             // 0表示按在线核轮流绑定
+    const char *cpu_source;   // 绑定核的来源（显示用）
+} lowlat_t;
+
+void lowlat_defaults(lowlat_t *ll);
+
+// 解析CPU列表（如 "2-3,6"）；返回核数，格式错误返回-1
+int lowlat_parse_cpus(const char *list, int *cpus, int max);
+
+// 未指定--cpus时使用内核隔离的核（isolcpus，/sys/devices/system/cpu/isolated）
+void lowlat_select_cpus(lowlat_t *ll);
+
+// 第index个线程绑定的核
+int lowlat_cpu(const lowlat_t *ll, int index);
+
+// 设置socket忙轮询；busy_poll_us为0时关闭（恢复默认模式）
+int lowlat_socket(int sockfd, int busy_poll_us);
+
+// 把当前线程切换到SCHED_FIFO（rt_prio为0时不变）
+void lowlat_thread(int rt_prio, const char *role);
+
+// 锁定当前和以后分配的全部内存，避免缺页和换出
+int lowlat_lock_memory(void);
+
+// 逐页读写一次缓冲区，使缺页发生在测试开始之前（不改变内容）
+void lowlat_prefault(void *buf, size_t len);
+
+// 打印生效的低延迟设置；threads为自旋线程数，SCHED_FIFO线程多于可用核时给出警告
+void lowlat_print_info(const lowlat_t *ll, int threads);
+
+#endif // LOWLAT_H
@@ -0,0 +1,32 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdint.h>
+
+// 开环速率控制器：截止时间按周期计数器时钟（tsc_now_ns()）从开始时刻累加，不随实际发出时刻漂移
+// 粗粒度等待用clock_nanosleep()睡到截止时间前PACER_SPIN_NS的相对时长，最后一段忙等
+#define PACER_SPIN_NS 10000ULL   // 忙等尾段长度（10μs）
+
+typedef struct {
+    double rate_pps;            // 目标速率（包/秒），0表示不限速
+    int burst_size;             // 每个发送时刻连续发出的包数
+    double interval_ns;         // 相邻突发之间的间隔（纳秒）
+    uint64_t start_ns;          // 开始时间（周期计数器时钟，tsc_now_ns()）
+    uint64_t end_ns;            // 结束时间
+    uint64_t bursts;            // 已调度的突发数
+    uint64_t total_error_ns;    // 累计节拍误差（实际发出时刻晚于截止时间的量）
+    uint64_t max_error_ns;      // 最大节拍误差
+} pacer_t;
+
+// 解析速率字符串："20000" / "20kpps" / "1.5Mpps" (包/秒) 或 "500Mbps" / "2Gbps" / "800kbps" (比特/秒)
+// 比特速率按pkt_bytes（UDP负载字节数）换算为包速率；成功返回0，失败返回-1
+int parse_rate(const char *str, int pkt_bytes, double *rate_pps);
+
+void pacer_init(pacer_t *pacer, double rate_pps, int burst_size);
+void pacer_start(pacer_t *pacer);
+void pacer_wait(pacer_t *pacer);
+void pacer_finish(pacer_t *pacer);
+void pacer_merge(pacer_t *dst, const pacer_t *src);
+void pacer_print_report(const pacer_t *pacer, uint64_t packets_sent, uint64_t bytes_sent);
+
+#endif // PACER_H
@@ -0,0 +1,112 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "common.h"
+#include <stdatomic.h>
+
+// 接收流水线：I/O线程把数据报直接收进缓冲池的槽位，按源地址把槽位下标经无锁SPSC环交给
+// 处理线程；处理线程完成解析和统计后经另一条SPSC环把槽位归还I/O线程
+#define PIPE_MAX_WORKERS        16      // 每个I/O线程的最大处理线程数
+#define PIPE_DEFAULT_POOL_SIZE  4096    // 每个I/O线程的缓冲池槽数
+#define PIPE_DEFAULT_SLOT_SIZE  2048    // 槽大小（字节），容纳一个以太网MTU的包
+#define PIPE_MIN_SLOT_SIZE      256     // 至少容纳性能测试包头
+
+// 单生产者单消费者环，元素为缓冲池槽位下标
+// 生产者和消费者的下标各占一个缓存行，并各自缓存对方的下标，只在看似满/空时才重新读取
+typedef struct {
+    _Atomic uint32_t head __attribute__((aligned(CACHE_LINE_SIZE)));   // 生产者写
+    uint32_t head_local;        // 生产者本地下标（spsc_publish()时发布）
+    uint32_t tail_cache;        // 生产者缓存的消费者下标
+    _Atomic uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE)));   // 消费者写
+    uint32_t head_cache;        // 消费者缓存的生产者下标
+    uint32_t *slots __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint32_t mask;
+} spsc_ring_t;
+
+// 固定大小槽位的缓冲池（一次连续分配），空闲栈只由I/O线程访问
+typedef struct {
+    char *slab;
+    uint32_t slot_size;
+    uint32_t count;
+    uint32_t *lens;             // 每个槽中数据报的实际长度（可能大于槽大小，超出部分被截断）
+    struct sockaddr_in *addrs;  // 每个槽中数据报的源地址
+    uint32_t *free_stack;
+    uint32_t free_count;
+    uint32_t min_free;          // 历史最少空闲槽数（峰值使用 = count - min_free）
+    uint64_t exhausted;         // 缓冲池耗尽（I/O线程因无槽可用而暂停接收）的次数
+    uint64_t truncated;         // 超过槽大小而被截断的数据报数
+} buf_pool_t;
+
+// 处理环的占用统计（I/O线程每次分发后采样）
+typedef struct {
+    uint64_t samples;
+    uint64_t occupancy_sum;
+    uint32_t peak;
+} pipe_ring_stats_t;
+
+// 一个I/O线程及其处理线程共享的流水线
+typedef struct {
+    buf_pool_t pool;
+    int num_workers;
+    spsc_ring_t *work;          // I/O线程 → 处理线程i
+    spsc_ring_t *done;          // 处理线程i → I/O线程（归还槽位）
+    pipe_ring_stats_t *ring_stats;
+    _Atomic int io_done;        // I/O线程已退出，处理线程取空环后即可退出
+} pipe_t;
+
+int pipe_init(pipe_t *pipe, int num_workers, uint32_t pool_size, uint32_t slot_size);
+void pipe_free(pipe_t *pipe);
+
+static inline char *pipe_slot(const pipe_t *pipe, uint32_t idx) {
+    return pipe->pool.slab + (size_t)idx * pipe->pool.slot_size;
+}
+
+// 生产者：本地排队一个元素（环容量不小于缓冲池槽数，不会溢出）
+static inline void spsc_push(spsc_ring_t *ring, uint32_t value) {
+    ring->slots[ring->head_local & ring->mask] = value;
+    ring->head_local++;
+}
+
+// 生产者：发布本地排队的元素
+static inline void spsc_publish(spsc_ring_t *ring) {
+    atomic_store_explicit(&ring->head, ring->head_local, memory_order_release);
+}
+
+// 消费者：最多取出max个元素；返回个数
+static inline uint32_t spsc_pop_batch(spsc_ring_t *ring, uint32_t *out, uint32_t max) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (ring->head_cache == tail) {
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+    }
+    uint32_t n = ring->head_cache - tail;
+    if (n > max) {
+        n = max;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = ring->slots[(tail + i) & ring->mask];
+    }
+    if (n > 0) {
+        atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+    }
+    return n;
+}
+
+// 生产者视角的环占用（已发布但尚未被取走的元素数）
+static inline uint32_t spsc_occupancy(spsc_ring_t *ring) {
+    ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return ring->head_local - ring->tail_cache;
+}
+
+// 取回各处理线程归还的槽位
+void pipe_reclaim(pipe_t *pipe);
+
+// 按源地址选择处理线程（同一发送端的包始终由同一线程处理，保持流内顺序）
+static inline int pipe_pick_worker(const pipe_t *pipe, const struct sockaddr_in *addr) {
+    uint32_t h = (addr->sin_addr.s_addr ^ ((uint32_t)addr->sin_port << 16)) * 0x9E3779B1U;
+    return (int)(((uint64_t)h * (uint32_t)pipe->num_workers) >> 32);
+}
+
+// 打印缓冲池使用和处理环占用情况，label为I/O线程标识
+void pipe_print_report(const pipe_t *pipe, int label);
+
+#endif // PIPELINE_H
@@ -0,0 +1,76 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "histogram.h"
+
+// 周期时间序列报告：后台线程按固定间隔无锁读取收发线程的累计计数器，
+// 与上一次采样相减得到本区间的包速率、吞吐量、丢包、乱序和延迟百分位，
+// 每个区间输出一行JSON（JSON Lines）或CSV，供监控面板观察吞吐骤降和延迟尖峰
+#define REPORT_DEFAULT_INTERVAL_MS 1000
+#define REPORT_MIN_INTERVAL_MS     10
+#define REPORT_POLL_MS             20     // 等待下一区间时检查退出标志的间隔
+
+typedef enum {
+    REPORT_OFF = 0,
+    REPORT_JSON,
+    REPORT_CSV
+} report_format_t;
+
+// 一次采样：各计数器的累计值，由采样回调无锁读取热路径计数器汇总得到
+typedef struct {
+    uint64_t packets_sent;
+    uint64_t bytes_sent;
+    uint64_t packets_received;
+    uint64_t bytes_received;
+    uint64_t packets_lost;        // 可能减少（服务器端乱序补到），区间增量按0计
+    uint64_t reordered;
+    uint64_t socket_drops;
+    latency_hist_t latency;       // 只使用各桶计数（hist_accumulate_live()累加）
+} report_sample_t;
+
+// 采样回调：把arg对应的全部计数器累加到已清零的out中
+typedef void (*report_sample_fn)(void *arg, report_sample_t *out);
+
+typedef struct {
+    report_format_t format;
+    int interval_ms;
+    const char *path;             // 输出文件，NULL或"-"表示标准输出
+    const char *role;             // "server" 或 "client"
+    FILE *out;
+    int header_done;              // CSV表头已输出
+    int round;                    // 客户端轮次（从1开始），服务器为0
+    report_sample_fn sample;
+    void *arg;
+    pthread_t thread;
+    atomic_int stop;
+    int running;
+    uint64_t start_ns;            // 本次报告开始的单调时间
+    uint64_t last_ns;             // 上一次采样的单调时间
+    report_sample_t prev;
+    report_sample_t cur;
+} report_t;
+
+void report_defaults(report_t *r);
+
+// 解析输出格式（json或csv）；成功返回0
+int report_parse_format(const char *str, report_format_t *format);
+
+// 打开输出；输出到标准输出时其余输出改到标准错误（需在任何输出之前调用）；未启用时直接返回0，失败返回-1
+int report_open(report_t *r, const char *role);
+
+// 启动采样线程（round为客户端轮次，服务器传0）；失败返回-1
+int report_start(report_t *r, report_sample_fn sample, void *arg, int round);
+
+// 停止采样线程，并输出最后一个不足一个间隔的区间
+void report_stop(report_t *r);
+
+void report_close(report_t *r);
+
+// 打印报告设置（启动信息）
+void report_print_info(const report_t *r);
+
+#endif // REPORT_H
@@ -0,0 +1,67 @@
+#ifndef SEQWIN_H
+#define SEQWIN_H
+
+#include <stdint.h>
+
+#define SEQWIN_DEFAULT_SIZE 65536      // 默认窗口大小（序列号个数）
+#define SEQ_REORDER_BUCKETS 32         // 乱序距离直方图桶数：第i桶为[2^i, 2^(i+1))
+
+// 单个序列号的判定结果
+typedef enum {
+    SEQ_IN_ORDER = 0,   // 紧接在已收到的最大序列号之后
+    SEQ_GAP,            // 比预期更新，中间的序列号暂记为缺失
+    SEQ_REORDERED,      // 比最大序列号旧但首次到达（窗口内）
+    SEQ_DUPLICATE,      // 窗口内已收到过
+    SEQ_LATE            // 比窗口更旧，已无法判断（滑出窗口时已计为丢失）
+} seq_result_t;
+
+// 序列号统计（可跨线程合并）
+typedef struct {
+    uint64_t received;          // 首次到达的序列号数
+    uint64_t lost;              // 滑出窗口时仍未到达的序列号数
+    uint64_t reordered;
+    uint64_t duplicates;
+    uint64_t late;
+    uint64_t max_distance;      // 最大乱序距离
+    uint64_t reorder_hist[SEQ_REORDER_BUCKETS];
+    uint64_t missing;           // 窗口内仍缺失的序列号数（快照时填入，可能稍后乱序到达）
+} seq_stats_t;
+
+// 位图滑动窗口：覆盖(top - size, top]，每个序列号一位，按64位字批量滑动
+// 32位线上序列号相对top扩展为64位，可跨越回绕
+typedef struct {
+    uint64_t *bits;
+    uint64_t size;              // 窗口大小（64的倍数且为2的幂）
+    uint64_t mask;
+    int started;
+    uint64_t first;             // 收到的最小扩展序列号（此前的序列号不计入丢失）
+    uint64_t top;               // 收到的最大扩展序列号
+    uint64_t in_window;         // 窗口内已收到的序列号数
+    seq_stats_t stats;
+} seqwin_t;
+
+// 窗口大小向上取整为2的幂（至少64）；成功返回0
+int seqwin_init(seqwin_t *win, uint32_t size);
+void seqwin_free(seqwin_t *win);
+void seqwin_reset(seqwin_t *win);
+
+// 登记一个收到的序列号
+seq_result_t seqwin_update(seqwin_t *win, uint32_t seq_num);
+
+// 序列号是否落后于已收到的最大序列号（重复、迟到或乱序）
+int seqwin_behind(const seqwin_t *win, uint32_t seq_num);
+
+// 当前的丢失数：已滑出窗口的丢失 + 窗口内仍缺失的序列号
+uint64_t seqwin_lost(const seqwin_t *win);
+
+// 取统计快照（填入missing）；merge用于汇总多个线程
+void seqwin_snapshot(const seqwin_t *win, seq_stats_t *out);
+void seq_stats_merge(seq_stats_t *dst, const seq_stats_t *src);
+
+// 打印丢失/乱序/重复/迟到及乱序距离分布，title为行首标签
+void seq_stats_print(const seq_stats_t *stats, const char *title);
+
+// 只打印乱序距离分布（没有乱序时不输出）
+void seq_print_reorder_hist(const seq_stats_t *stats);
+
+#endif // SEQWIN_H
@@ -0,0 +1,120 @@
+#ifndef SHMSTATS_H
+#define SHMSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "histogram.h"
+
+// 共享内存实时统计：服务器把各线程的累计计数器、延迟直方图和流表摘要发布到命名POSIX共享内存，
+// 外部监控（udp_stat）只读映射后自行计算速率，不需要停止服务器或解析标准输出
+// 每个线程一个按缓存行对齐的槽位，只由该线程在发布周期到来时用普通写入更新，seqlock保证读到一致的快照
+#define SHMSTATS_MAGIC               0x55445353   // "UDSS"
+#define SHMSTATS_VERSION             1
+#define SHMSTATS_NAME_MAX            64
+#define SHMSTATS_MAX_FLOWS           64           // 每个线程发布的流数上限（按流表顺序取活跃流）
+#define SHMSTATS_DEFAULT_INTERVAL_MS 100          // 发布周期
+#define SHMSTATS_READ_RETRIES        1000         // 读者遇到写入中的槽位时的最大重试次数
+
+// 线程槽位的角色
+#define SHMSTATS_ROLE_RECEIVE  0
+#define SHMSTATS_ROLE_PIPELINE 1
+
+typedef struct {
+    uint32_t addr;              // 源地址（网络字节序）
+    uint16_t port;              // 源端口（网络字节序）
+    uint16_t reserved;
+    uint32_t flow_id;
+    uint32_t reserved2;
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t lost;
+    uint64_t latency_count;
+    uint64_t latency_sum_ns;
+    uint64_t idle_ns;           // 发布时距该流最后一个包的时间
+} shmstats_flow_t;
+
+// 单个线程的槽位：seq为奇数时正在写入
+typedef struct __attribute__((aligned(64))) {
+    _Atomic uint32_t seq;
+    int32_t role;               // SHMSTATS_ROLE_*
+    uint64_t publish_ns;        // 发布时刻（CLOCK_MONOTONIC_RAW，纳秒），读者据此计算速率
+    uint64_t packets_received;
+    uint64_t bytes_received;
+    uint64_t packets_sent;
+    uint64_t bytes_sent;
+    uint64_t packets_lost;
+    uint64_t reordered;
+    uint64_t socket_drops;
+    uint32_t flows_active;      // 活跃流数（可能多于发布的flow_count）
+    uint32_t flow_count;
+    latency_hist_t latency;     // 累计延迟分布，读者对两次快照逐桶相减得到区间百分位
+    shmstats_flow_t flows[SHMSTATS_MAX_FLOWS];
+} shmstats_thread_t;
+
+typedef struct __attribute__((aligned(64))) {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;              // 整个段的字节数
+    uint32_t num_threads;
+    uint32_t interval_ms;
+    int32_t pid;
+    uint16_t port;
+    uint16_t reserved;
+    char bind_ip[16];
+    uint64_t start_ns;          // 服务器启动时刻（CLOCK_MONOTONIC_RAW）
+    _Atomic uint64_t heartbeat_ns;  // 发布线程最近一次推进周期的时刻
+    _Atomic uint32_t running;   // 服务器退出时清零
+} shmstats_header_t;
+
+// 进程内句柄（服务器创建或监控程序只读映射）
+typedef struct {
+    char name[SHMSTATS_NAME_MAX];
+    int interval_ms;
+    size_t size;
+    shmstats_header_t *hdr;
+    shmstats_thread_t *threads;
+    atomic_uint gen;            // 发布周期编号：发布线程递增，各线程发现变化后写一次自己的槽位
+    atomic_int stop;
+    pthread_t thread;
+    int running;
+    int owner;                  // 由本进程创建，关闭时删除
+} shmstats_t;
+
+// 默认段名 "/udp_server.<port>"（位于/dev/shm）
+void shmstats_default_name(char *buf, size_t len, int port);
+
+// 创建（覆盖同名段）并初始化num_threads个槽位，发布周期为interval_ms；成功返回0
+int shmstats_create(shmstats_t *shm, const char *name, int num_threads, const char *bind_ip, int port,
+                    int interval_ms);
+
+// 启动发布线程，每个周期推进一次发布周期编号并更新心跳
+int shmstats_start(shmstats_t *shm);
+
+// 停止发布线程，标记服务器已退出，解除映射并删除段
+void shmstats_destroy(shmstats_t *shm);
+
+// 只读映射已有的段，检查版本和大小；成功返回0
+int shmstats_attach(shmstats_t *shm, const char *name);
+void shmstats_detach(shmstats_t *shm);
+
+// 写者：只由槽位所属线程调用，中间的字段用普通写入
+static inline void shmstats_write_begin(shmstats_thread_t *t) {
+    uint32_t seq = atomic_load_explicit(&t->seq, memory_order_relaxed);
+    atomic_store_explicit(&t->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void shmstats_write_end(shmstats_thread_t *t) {
+    uint32_t seq = atomic_load_explicit(&t->seq, memory_order_relaxed);
+    atomic_store_explicit(&t->seq, seq + 1, memory_order_release);
+}
+
+// 读者：复制一份一致的槽位快照；重试多次仍在写入时返回-1
+int shmstats_read_thread(const shmstats_thread_t *t, shmstats_thread_t *out);
+
+// 打印段名和发布设置（启动信息）
+void shmstats_print_info(const shmstats_t *shm);
+
+#endif // SHMSTATS_H
@@ -0,0 +1,61 @@
+#ifndef SOCKBUF_H
+#define SOCKBUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+// socket缓冲区与内核丢包统计：SO_RXQ_OVFL在每个接收包的cmsg中附带该socket的累计丢弃数，
+// 接收队列溢出（缓冲区太小或应用取包太慢）的丢包因此能与线路上的丢包区分开；
+// 自动调整模式在观察到丢弃时成倍扩大接收缓冲区
+#define SOCKBUF_DEFAULT_SIZE     (1024 * 1024)        // 默认请求的收发缓冲区（1MB）
+#define SOCKBUF_AUTO_MAX         (256 * 1024 * 1024)  // 自动调整的上限（有CAP_NET_ADMIN时用SO_RCVBUFFORCE越过rmem_max）
+#define SOCKBUF_TUNE_INTERVAL_MS 100                  // 两次扩大之间的最短间隔，等待上次扩大生效
+
+extern int sockbuf_rcvbuf;    // 请求的接收缓冲区大小（字节）
+extern int sockbuf_sndbuf;    // 请求的发送缓冲区大小（字节）
+extern int sockbuf_auto;      // 非0时观察到丢弃后自动扩大接收缓冲区
+
+// 单个接收socket的丢弃计数与缓冲区状态（只由接收线程写）
+typedef struct {
+    uint32_t drops;           // 累计丢弃数（socket创建以来）
+    uint32_t tuned_drops;     // 上次调整时的累计丢弃数
+    uint64_t last_tune_ns;
+    int rcvbuf;               // 内核实际分配的接收缓冲区（getsockopt读回，含内核记账开销的翻倍）
+    int grows;                // 自动扩大次数
+    int at_limit;             // 已达到可设置的上限
+} sockbuf_stats_t;
+
+// 从接收消息的控制信息中更新累计丢弃数；队列未溢出过时内核不附带该cmsg
+static inline void sockbuf_note(sockbuf_stats_t *sb, const struct msghdr *msg) {
+    if (msg->msg_controllen == 0) {
+        return;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR((struct msghdr *)msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR((struct msghdr *)msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            __builtin_memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+            if (drops > sb->drops) {
+                __atomic_store_n(&sb->drops, drops, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+// 按请求大小设置收发缓冲区并启用SO_RXQ_OVFL
+void sockbuf_apply(int sockfd);
+
+// 读回实际缓冲区大小，并用SO_MEMINFO补上最后一个接收包之后发生的丢弃
+void sockbuf_read(int sockfd, sockbuf_stats_t *sb);
+
+// 自动调整：丢弃数自上次调整后增加时把接收缓冲区扩大一倍；返回1表示本次扩大了缓冲区
+int sockbuf_autotune(int sockfd, sockbuf_stats_t *sb);
+
+// 打印请求与实际的缓冲区大小、rmem_max/wmem_max和自动调整状态
+void sockbuf_print_info(int sockfd);
+
+// 解析大小（字节，可带k/m后缀）
+int sockbuf_parse_size(const char *str, int *bytes);
+
+#endif // SOCKBUF_H
@@ -0,0 +1,47 @@
+#ifndef TIMESTAMPING_H
+#define TIMESTAMPING_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include "histogram.h"
+
+// SO_TIMESTAMPING内核/网卡时间戳
+// 软件时间戳为CLOCK_REALTIME；硬件时间戳为网卡PHC时钟，仅用于同一网卡的两个硬件时间戳相减
+#define TS_MODE_OFF 0
+#define TS_MODE_SOFTWARE 1
+#define TS_MODE_HARDWARE 2
+
+#define TS_CONTROL_LEN 256   // 接收cmsg缓冲区长度
+
+// 一个内核时间戳（0表示不可用）
+typedef struct {
+    uint64_t sw_ns;
+    uint64_t hw_ns;
+} kernel_ts_t;
+
+// 延迟分解：应用发送→内核发送、线路与协议栈、内核接收→应用
+typedef struct {
+    latency_hist_t app_to_kernel_tx;
+    latency_hist_t wire;
+    latency_hist_t kernel_rx_to_app;
+} ts_breakdown_t;
+
+// 启用时间戳：mode为TS_MODE_SOFTWARE/HARDWARE，ifname用于开启网卡硬件时间戳（可为NULL）
+// want_tx非0时同时请求发送时间戳（通过错误队列返回，OPT_ID标识第几个发送的包）
+// 硬件时间戳不可用时自动回退到软件时间戳；返回实际生效的模式，失败返回-1
+int ts_enable(int sockfd, int mode, const char *ifname, int want_tx);
+
+// 从recvmsg()返回的控制消息中提取接收时间戳，成功返回0
+int ts_get_rx(const struct msghdr *msg, kernel_ts_t *ts);
+
+// 从错误队列读取一个发送时间戳，成功返回1，队列为空返回0，出错返回-1
+int ts_read_tx(int sockfd, uint32_t *id, kernel_ts_t *ts);
+
+// 以CLOCK_REALTIME纳秒读取当前时间（与软件时间戳同一时钟）
+uint64_t ts_realtime_ns(void);
+
+void ts_breakdown_reset(ts_breakdown_t *breakdown);
+void ts_breakdown_merge(ts_breakdown_t *dst, const ts_breakdown_t *src);
+void ts_print_breakdown(const ts_breakdown_t *breakdown);
+
+#endif // TIMESTAMPING_H
@@ -0,0 +1,96 @@
+#ifndef TSC_H
+#define TSC_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// 周期计数器时钟：直接读取CPU计数器（x86的TSC，ARM64的CNTVCT_EL0），
+// 启动时对照CLOCK_MONOTONIC_RAW标定频率，之后每秒对照一次，用整数乘法和移位换算为纳秒
+// 对照时不直接跳到参考时间，而是从当前读数连续地调整换算系数，在下一个周期内追上参考时钟，读数不会倒退
+// 因此读数只近似等于CLOCK_MONOTONIC_RAW：偏差为上一周期的换算误差（通常为微秒级），各进程各自标定，
+// 只能用于本进程内的时间间隔；写入包头、由其他进程比较的时间戳用clock_gettime()
+// 计数器不可用或不可靠（x86未声明invariant TSC）时退回clock_gettime()
+#define TSC_SHIFT        32     // 换算系数的定点小数位数
+#define TSC_CALIBRATE_MS 20     // 启动标定的时间窗口
+#define TSC_RESYNC_MS    1000   // 重新对齐周期
+
+typedef struct {
+    _Atomic uint32_t seq;           // 顺序锁：奇数表示换算参数正在更新
+    _Atomic uint64_t base_cycles;   // 对齐点的计数器值
+    _Atomic uint64_t base_ns;       // 对齐点的CLOCK_MONOTONIC_RAW时间
+    _Atomic uint64_t mult;          // 每周期纳秒数 << TSC_SHIFT（含追赶参考时钟的调整）
+    _Atomic uint64_t rate;          // 标定的每周期纳秒数 << TSC_SHIFT，超出调整周期的部分按此换算
+    uint64_t resync_cycles;         // 距对齐点超过该周期数时重新对齐
+    uint64_t init_cycles;           // 启动标定的起点，重新对齐时按此长窗口计算频率
+    uint64_t init_ns;
+    uint64_t freq_hz;
+    atomic_int resyncing;
+    int enabled;
+} tsc_clock_t;
+
+extern tsc_clock_t tsc_clock;
+extern _Thread_local uint64_t tsc_last_ns;     // 本线程上次返回的时间，跨核计数器偏差时用于保证不倒退
+
+// 读取计数器原始值（ARM64先isb，避免读取被提前）
+static inline uint64_t tsc_read(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t value;
+    __asm__ volatile("isb; mrs %0, cntvct_el0" : "=r"(value) : : "memory");
+    return value;
+#else
+    return 0;
+#endif
+}
+
+// 标定并启用计数器时钟；不可用时返回-1（tsc_now_ns()退回clock_gettime()）
+int tsc_init(void);
+
+// 打印时钟来源、频率和单次读取开销
+void tsc_print_info(void);
+
+uint64_t tsc_fallback_ns(void);
+void tsc_resync(void);
+
+// 当前时间（纳秒，近似CLOCK_MONOTONIC_RAW，单线程内不倒退）
+static inline uint64_t tsc_now_ns(void) {
+    if (!tsc_clock.enabled) {
+        return tsc_fallback_ns();
+    }
+    uint32_t seq;
+    uint64_t cycles, base_cycles, base_ns, mult, rate;
+    do {
+        seq = atomic_load_explicit(&tsc_clock.seq, memory_order_acquire);
+        base_cycles = atomic_load_explicit(&tsc_clock.base_cycles, memory_order_relaxed);
+        base_ns = atomic_load_explicit(&tsc_clock.base_ns, memory_order_relaxed);
+        mult = atomic_load_explicit(&tsc_clock.mult, memory_order_relaxed);
+        rate = atomic_load_explicit(&tsc_clock.rate, memory_order_relaxed);
+        cycles = tsc_read();
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&tsc_clock.seq, memory_order_relaxed));
+    
+    // 各核计数器之间的微小偏差可能使读数略早于对齐点
+    uint64_t now;
+    int64_t delta = (int64_t)(cycles - base_cycles);
+    if (delta < 0) {
+        now = base_ns - (uint64_t)(((unsigned __int128)(uint64_t)-delta * mult) >> TSC_SHIFT);
+    } else if ((uint64_t)delta <= tsc_clock.resync_cycles) {
+        now = base_ns + (uint64_t)(((unsigned __int128)(uint64_t)delta * mult) >> TSC_SHIFT);
+    } else {
+        // 长时间未读取：调整只作用于一个周期，其余部分按标定频率换算，空闲间隔不会放大调整量
+        tsc_resync();
+        now = base_ns + (uint64_t)(((unsigned __int128)tsc_clock.resync_cycles * mult) >> TSC_SHIFT) +
+              (uint64_t)(((unsigned __int128)((uint64_t)delta - tsc_clock.resync_cycles) * rate) >> TSC_SHIFT);
+    }
+    if (now < tsc_last_ns) {
+        return tsc_last_ns;
+    }
+    tsc_last_ns = now;
+    return now;
+}
+
+#endif // TSC_H
@@ -0,0 +1,94 @@
+#ifndef URING_H
+#define URING_H
+
+#include "common.h"
+#include <linux/io_uring.h>
+
+// I/O后端：socket系统调用（recvmmsg/sendmmsg）、io_uring或AF_XDP（见xdp.h）
+#define IO_BACKEND_SOCKET 0
+#define IO_BACKEND_URING  1
+#define IO_BACKEND_XDP    2
+
+#define URING_ENTRIES     256   // 提交队列深度
+#define URING_BUFFERS     64    // 提供缓冲区环中的缓冲区数（2的幂）
+#define URING_BUF_GROUP   0     // 提供缓冲区组ID
+
+// 最小化的io_uring封装（直接使用系统调用，不依赖liburing）
+typedef struct {
+    int ring_fd;
+    
+    // 提交队列
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    unsigned sqe_tail;          // 本地已填充但尚未发布的SQE尾部
+    
+    // 完成队列
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    
+    void *sq_ring_ptr;
+    void *cq_ring_ptr;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    
+    // 提供缓冲区环（多发接收由内核从中挑选缓冲区）
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    unsigned buf_count;
+    unsigned buf_mask;
+    uint16_t buf_tail;          // 本地尾部，uring_buf_publish()时发布给内核
+    char *buffers;
+    size_t buf_size;
+    struct msghdr recv_template; // 多发recvmsg的布局模板（地址与控制消息长度）
+} uring_t;
+
+// 多发recvmsg的一次完成：指向提供缓冲区内的地址、控制消息和负载
+typedef struct {
+    unsigned bid;               // 缓冲区ID，处理完后需uring_buf_recycle()
+    char *payload;
+    uint32_t payload_len;
+    struct sockaddr_in *addr;
+    struct msghdr msg;          // msg_control指向缓冲区内的cmsg，可直接交给ts_get_rx()
+} uring_recv_t;
+
+// 解析"socket"/"uring"/"xdp"；成功返回0，失败返回-1
+int parse_io_backend(const char *str, int *backend);
+
+// 创建/销毁io_uring实例；内核不支持或被禁用时返回-1（errno保留原因）
+int uring_init(uring_t *ring, unsigned entries);
+void uring_free(uring_t *ring);
+
+// 注册count个提供缓冲区（每个可容纳地址、control_len字节控制消息和最大UDP负载）
+int uring_setup_buffers(uring_t *ring, unsigned count, size_t control_len);
+
+// 获取一个空闲SQE，队列满时返回NULL（调用者应先uring_submit()）
+struct io_uring_sqe *uring_get_sqe(uring_t *ring);
+
+// 提交所有已填充的SQE，并等待至少wait_nr个完成（timeout_ms < 0 表示不超时）
+// 返回提交数，超时返回0，出错返回-1（EINTR时errno保留）
+int uring_submit(uring_t *ring, unsigned wait_nr, int timeout_ms);
+
+// 取下一个完成事件（无则返回NULL），处理完后调用uring_cqe_seen()
+struct io_uring_cqe *uring_peek_cqe(uring_t *ring);
+void uring_cqe_seen(uring_t *ring);
+
+void uring_prep_recvmsg_multishot(uring_t *ring, struct io_uring_sqe *sqe, int fd, uint64_t user_data);
+void uring_prep_sendmsg(struct io_uring_sqe *sqe, int fd, const struct msghdr *msg, uint64_t user_data);
+
+// 解析一次多发recvmsg完成；成功返回0，完成不携带缓冲区时返回-1
+int uring_recv_parse(uring_t *ring, const struct io_uring_cqe *cqe, uring_recv_t *out);
+
+// 归还缓冲区（先在本地排队，uring_buf_publish()时一次性发布给内核）
+void uring_buf_recycle(uring_t *ring, unsigned bid);
+void uring_buf_publish(uring_t *ring);
+
+// 检查当前内核是否支持所需特性（io_uring + 提供缓冲区环）；支持返回0
+int uring_probe(void);
+
+#endif // URING_H
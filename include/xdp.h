@@ -0,0 +1,132 @@
+#ifndef XDP_H
+#define XDP_H
+
+#include "common.h"
+#include <linux/if_xdp.h>
+#include <linux/if_ether.h>
+
+// AF_XDP后端：绕过内核UDP协议栈，由XDP程序把匹配的UDP包直接重定向到用户态的UMEM
+// 通用（SKB）模式可在veth、测试网络命名空间等任意网卡上运行，原生模式需网卡驱动支持
+#define XSK_MODE_SKB      0     // XDP通用模式（内核复制，任意网卡）
+#define XSK_MODE_NATIVE   1     // XDP原生模式（驱动支持时尝试零拷贝）
+
+#define XSK_FRAME_SIZE    4096  // UMEM帧大小（每帧容纳一个以太网帧）
+#define XSK_RING_SIZE     2048  // 各环的描述符数（2的幂）
+#define XSK_NUM_FRAMES    (2 * XSK_RING_SIZE)   // 一半预先放入填充环，一半留给发送
+
+// 以太网 + IPv4（无选项）+ UDP 头部长度
+#define UDP_FRAME_HDR_LEN (ETH_HLEN + 20 + 8)
+
+// 生产者/消费者环（填充环、发送环由用户态生产，接收环、完成环由用户态消费）
+typedef struct {
+    uint32_t *producer;
+    uint32_t *consumer;
+    uint32_t *flags;
+    void *descs;
+    uint32_t mask;
+    uint32_t size;
+    uint32_t local;         // 生产者环为本地尚未发布的生产者下标，消费者环为本地消费者下标
+    void *map;
+    size_t map_size;
+} xsk_ring_t;
+
+// 一个AF_XDP socket及其独占的UMEM
+typedef struct {
+    int fd;
+    int ifindex;
+    int queue_id;
+    int zerocopy;           // 绑定结果：1为零拷贝，0为复制模式
+    char *umem;
+    size_t umem_size;
+    xsk_ring_t rx;
+    xsk_ring_t tx;
+    xsk_ring_t fill;
+    xsk_ring_t comp;
+    int has_rx;             // 是否接收（接收时完成的发送帧回到填充环，否则回到空闲栈）
+    uint64_t *free_frames;  // 空闲发送帧栈
+    uint32_t free_count;
+    uint32_t tx_pending;    // 已放入发送环但尚未完成的帧数
+} xsk_t;
+
+// UDP/IP帧的两端地址（网络字节序）
+typedef struct {
+    uint8_t src_mac[ETH_ALEN];
+    uint8_t dst_mac[ETH_ALEN];
+    struct sockaddr_in src;
+    struct sockaddr_in dst;
+} udp_path_t;
+
+// 挂载在网卡上的XDP程序：IPv4/UDP目的端口（及可选目的地址）匹配的包按接收队列重定向到XSKMAP
+// 中注册的AF_XDP socket，其余包（ARP、其他端口、未注册的队列）交给内核协议栈
+typedef struct {
+    int prog_fd;
+    int map_fd;
+    int link_fd;
+    int ifindex;
+} xdp_prog_t;
+
+// 解析"skb"/"native"；成功返回0，失败返回-1
+int parse_xsk_mode(const char *str, int *mode);
+
+// 加载并挂载XDP程序（bpf_link，进程退出时自动卸载）；dst_ip为0表示不匹配目的地址
+int xdp_prog_attach(xdp_prog_t *prog, int ifindex, uint32_t dst_ip, uint16_t dst_port,
+                    int mode, int max_queues);
+int xdp_prog_register(xdp_prog_t *prog, int queue_id, int xsk_fd);
+void xdp_prog_detach(xdp_prog_t *prog);
+
+// 创建AF_XDP socket并绑定到网卡的queue_id队列；want_rx为0时只发送（无需XDP程序）
+int xsk_open(xsk_t *xsk, int ifindex, int queue_id, int mode, int want_rx);
+void xsk_close(xsk_t *xsk);
+
+static inline char *xsk_frame(const xsk_t *xsk, uint64_t addr) {
+    return xsk->umem + addr;
+}
+
+// 取出最多max个接收描述符（复制到descs并立即释放接收环槽位）；返回个数
+uint32_t xsk_recv(xsk_t *xsk, struct xdp_desc *descs, uint32_t max);
+
+// 把接收帧归还填充环（本地排队，xsk_flush()时发布）
+void xsk_recycle(xsk_t *xsk, uint64_t addr);
+
+// 从空闲栈取一个发送帧；无空闲帧时返回-1（应先xsk_flush()/xsk_complete()）
+int xsk_tx_alloc(xsk_t *xsk, uint64_t *addr);
+
+// 把取出但未发送的帧归还空闲栈
+void xsk_tx_release(xsk_t *xsk, uint64_t addr);
+
+// 把len字节的帧放入发送环（本地排队）；发送环满时返回-1
+int xsk_send(xsk_t *xsk, uint64_t addr, uint32_t len);
+
+// 发布填充环和发送环，必要时唤醒内核发送
+void xsk_flush(xsk_t *xsk);
+
+// 回收完成环中已发出的帧；返回回收数
+uint32_t xsk_complete(xsk_t *xsk);
+
+// 等待接收环可读，最多timeout_ms毫秒；返回poll()结果
+int xsk_wait(xsk_t *xsk, int timeout_ms);
+
+// 在所有空闲发送帧中预先构造UDP/IP帧并写入负载模板（发送时只需改写变化的字段）
+void xsk_tx_prepare(xsk_t *xsk, const udp_path_t *path, const void *payload, size_t len);
+
+// 读取内核的AF_XDP丢包/环满统计
+int xsk_get_stats(const xsk_t *xsk, struct xdp_statistics *stats);
+
+// 构造以太网/IPv4/UDP头部（UDP校验和置0），返回整帧长度
+size_t udp_frame_build(char *frame, const udp_path_t *path, size_t payload_len);
+
+// 解析以太网/IPv4/UDP帧，取出负载和源地址；不是IPv4/UDP或长度不符时返回-1
+int udp_frame_parse(char *frame, uint32_t len, char **payload, uint32_t *payload_len,
+                    struct sockaddr_in *src);
+
+// 原地交换帧的MAC、IP和端口，用于反射（交换不改变IP校验和，UDP校验和置0）
+void udp_frame_reflect(char *frame);
+
+// 按本地地址查找网卡名；找不到返回-1
+int xdp_iface_by_addr(const char *ip, char *ifname, size_t len);
+
+// 解析到dst的发送路径：网卡（iface为NULL时按路由选择）、源地址、下一跳MAC和MTU
+int xdp_resolve_path(const char *iface, const struct sockaddr_in *dst, uint16_t src_port,
+                     udp_path_t *path, int *ifindex, int *mtu);
+
+#endif // XDP_H
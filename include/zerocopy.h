@@ -0,0 +1,25 @@
+#ifndef ZEROCOPY_H
+#define ZEROCOPY_H
+
+#include <stdint.h>
+
+// MSG_ZEROCOPY发送：内核直接引用用户缓冲区的页，发送完成后通过错误队列通知
+// 通知可能表明内核最终仍做了复制（如回环接口、网卡不支持分散/聚集），需单独统计
+typedef struct {
+    uint64_t calls;         // 带MSG_ZEROCOPY的成功发送调用数（每次调用占用一个通知编号）
+    uint64_t completed;     // 已收到完成通知的调用数
+    uint64_t copied;        // 其中内核回退为复制的调用数
+} zc_stats_t;
+
+// 在socket上启用SO_ZEROCOPY；成功返回0，内核不支持时返回-1
+int zc_enable(int sockfd);
+
+// 非阻塞地读取错误队列中的完成通知并累加到stats；返回本次新完成的调用数
+int zc_read_completions(int sockfd, zc_stats_t *stats);
+
+// 等待最多timeout_ms毫秒直到有完成通知可读，然后读取；返回新完成的调用数
+int zc_wait_completions(int sockfd, zc_stats_t *stats, int timeout_ms);
+
+void zc_print_report(const zc_stats_t *stats);
+
+#endif // ZEROCOPY_H
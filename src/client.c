@@ -1,61 +1,1308 @@
 #include "../include/common.h"
-#include <sys/select.h>
+#include "../include/pacer.h"
+#include "../include/timestamping.h"
+#include "../include/uring.h"
+#include "../include/zerocopy.h"
+#include "../include/xdp.h"
+#include "../include/seqwin.h"
+#include "../include/log.h"
+#include "../include/tsc.h"
+#include "../include/lowlat.h"
+#include "../include/sockbuf.h"
+#include "../include/report.h"
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <getopt.h>
+#include <netinet/udp.h>
+#include <net/if.h>
+#include <sys/resource.h>
 
-static volatile int running = 1;
-
-// 发送时间戳映射结构（用于计算RTT）
-typedef struct {
-    uint32_t seq_num;
-    struct timeval send_time;
-} send_time_entry_t;
+#define DEFAULT_INFLIGHT_WINDOW 65536   // 在途包表默认容量（包）
+#define GSO_MAX_SEGMENTS 64   // 内核单次UDP GSO发送允许的最大段数（UDP_MAX_SEGMENTS）
+#define ZC_POOL_BATCHES 8     // 零拷贝模式下发送缓冲池的块数（每块batch_size个包）
+#define ZC_WAIT_TIMEOUT_MS 1000  // 等待一个块的零拷贝完成通知的最长时间
+#define MAX_CLIENT_FLOWS 64   // -F并行测试流数上限
+#define FLOW_PROGRESS_INTERVAL_MS 1000   // 多流模式下汇总进度的打印周期
 
-static send_time_entry_t *send_time_map = NULL;
-static uint32_t send_time_map_size = 0;
-static uint32_t send_time_map_capacity = 0;
+static volatile int running = 1;
 
 void signal_handler(int sig) {
     (void)sig;  // 避免未使用参数警告
     running = 0;
 }
 
-// 添加发送时间戳
-static void add_send_time(uint32_t seq_num, struct timeval *send_time) {
-    // 如果映射表满了，扩大容量
-    if (send_time_map_size >= send_time_map_capacity) {
-        uint32_t new_capacity = send_time_map_capacity == 0 ? 1024 : send_time_map_capacity * 2;
-        send_time_entry_t *new_map = realloc(send_time_map, new_capacity * sizeof(send_time_entry_t));
-        if (!new_map) {
-            fprintf(stderr, "Warning: Failed to expand send time map\n");
-            return;
+// 在途包表槽位：tag保存64位扩展序列号+1（0表示空槽），同时起到代数(generation)校验作用
+typedef struct {
+    _Atomic uint64_t tag;
+    _Atomic uint64_t send_time_ns;   // 本地CLOCK_MONOTONIC_RAW发送时间
+} inflight_slot_t;
+
+// 在途包表（用于计算RTT）：按seq_num % capacity直接索引的定长环
+// 插入、查找、过期均为O(1)且热路径无内存分配；发送线程单写插入，接收线程通过CAS领取
+typedef struct {
+    inflight_slot_t *slots;
+    uint32_t capacity;            // 2的幂
+    uint32_t mask;
+    _Atomic uint64_t next_seq;    // 下一个待登记的扩展序列号（已登记总数）
+    _Atomic uint64_t matched;     // 成功匹配的响应数（接收线程写）
+    _Atomic uint64_t expired;     // 槽位被新包复用时仍未收到响应的包数（发送线程写）
+    uint64_t late;                // 槽位已被复用后才到达的迟到响应（接收线程写）
+    uint64_t duplicates;          // 已匹配过的重复响应（接收线程写）
+    uint64_t unknown;             // 从未发送过的序列号（接收线程写）
+} inflight_table_t;
+
+// 查找结果
+typedef enum {
+    INFLIGHT_MATCHED = 0,
+    INFLIGHT_LATE,
+    INFLIGHT_DUPLICATE,
+    INFLIGHT_UNKNOWN
+} inflight_result_t;
+
+// 初始化在途包表，容量向上取整为2的幂
+static int inflight_init(inflight_table_t *table, uint32_t capacity) {
+    memset(table, 0, sizeof(*table));
+    uint32_t cap = 1;
+    while (cap < capacity && cap < (1U << 31)) {
+        cap <<= 1;
+    }
+    table->slots = calloc(cap, sizeof(inflight_slot_t));
+    if (!table->slots) {
+        fprintf(stderr, "Error: Failed to allocate in-flight table (%u entries)\n", cap);
+        return -1;
+    }
+    table->capacity = cap;
+    table->mask = cap - 1;
+    return 0;
+}
+
+// 释放在途包表
+static void inflight_free(inflight_table_t *table) {
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+// 清空在途包表（每轮测试开始前调用，此时没有其他线程访问）
+static void inflight_reset(inflight_table_t *table) {
+    memset(table->slots, 0, (size_t)table->capacity * sizeof(inflight_slot_t));
+    atomic_store(&table->next_seq, 0);
+    atomic_store(&table->matched, 0);
+    atomic_store(&table->expired, 0);
+    table->late = 0;
+    table->duplicates = 0;
+    table->unknown = 0;
+}
+
+// 登记一个已发送的包（发送线程调用），返回其32位线上序列号
+static uint32_t inflight_add(inflight_table_t *table, uint64_t send_time_ns) {
+    uint64_t seq = atomic_load_explicit(&table->next_seq, memory_order_relaxed);
+    inflight_slot_t *slot = &table->slots[seq & table->mask];
+    
+    // 先清空旧槽位：若旧包仍未被领取，则它已超出窗口，计为过期
+    if (atomic_exchange_explicit(&slot->tag, 0, memory_order_acq_rel) != 0) {
+        atomic_store_explicit(&table->expired,
+                              atomic_load_explicit(&table->expired, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+    }
+    atomic_store_explicit(&slot->send_time_ns, send_time_ns, memory_order_relaxed);
+    atomic_store_explicit(&slot->tag, seq + 1, memory_order_release);
+    atomic_store_explicit(&table->next_seq, seq + 1, memory_order_release);
+    return (uint32_t)seq;
+}
+
+// 将32位线上序列号扩展为最接近已发送位置的64位序列号（处理回绕）
+static uint64_t inflight_extend_seq(uint64_t next_seq, uint32_t seq_num) {
+    uint64_t ext = (next_seq & ~0xFFFFFFFFULL) | seq_num;
+    if (ext > next_seq + 0x80000000ULL && ext >= 0x100000000ULL) {
+        ext -= 0x100000000ULL;
+    } else if (ext + 0x80000000ULL < next_seq) {
+        ext += 0x100000000ULL;
+    }
+    return ext;
+}
+
+// 查找并领取发送时间戳（接收线程调用，计算RTT后槽位即被释放）
+static inflight_result_t inflight_take(inflight_table_t *table, uint32_t seq_num,
+                                       uint64_t *send_time_ns) {
+    uint64_t next_seq = atomic_load_explicit(&table->next_seq, memory_order_acquire);
+    uint64_t seq = inflight_extend_seq(next_seq, seq_num);
+    
+    if (seq >= next_seq) {
+        table->unknown++;
+        return INFLIGHT_UNKNOWN;
+    }
+    
+    inflight_slot_t *slot = &table->slots[seq & table->mask];
+    uint64_t tag = seq + 1;
+    if (atomic_load_explicit(&slot->tag, memory_order_acquire) == tag) {
+        uint64_t t = atomic_load_explicit(&slot->send_time_ns, memory_order_relaxed);
+        // CAS成功说明发送线程尚未复用该槽位，读到的时间戳有效
+        if (atomic_compare_exchange_strong_explicit(&slot->tag, &tag, 0,
+                                                    memory_order_acq_rel, memory_order_acquire)) {
+            *send_time_ns = t;
+            atomic_store_explicit(&table->matched,
+                                  atomic_load_explicit(&table->matched, memory_order_relaxed) + 1,
+                                  memory_order_relaxed);
+            return INFLIGHT_MATCHED;
         }
-        send_time_map = new_map;
-        send_time_map_capacity = new_capacity;
     }
     
-    send_time_map[send_time_map_size].seq_num = seq_num;
-    send_time_map[send_time_map_size].send_time = *send_time;
-    send_time_map_size++;
+    // 未匹配：槽位已被更新的包复用则为迟到，否则为重复响应
+    if (next_seq - seq > table->capacity) {
+        table->late++;
+        return INFLIGHT_LATE;
+    }
+    table->duplicates++;
+    return INFLIGHT_DUPLICATE;
+}
+
+// 获取仍在窗口内、尚未收到响应的包数
+static uint64_t inflight_pending(inflight_table_t *table) {
+    uint64_t sent = atomic_load_explicit(&table->next_seq, memory_order_acquire);
+    uint64_t matched = atomic_load_explicit(&table->matched, memory_order_relaxed);
+    uint64_t expired = atomic_load_explicit(&table->expired, memory_order_relaxed);
+    return sent - matched - expired;
+}
+
+// 发送时间戳登记表槽位：内核按发送顺序给每个包编号（SOF_TIMESTAMPING_OPT_ID）
+typedef struct {
+    _Atomic uint64_t tag;       // 编号+1，0表示空槽
+    _Atomic uint64_t seq_num;
+    _Atomic uint64_t app_ns;    // 应用发送时间（CLOCK_REALTIME，与内核软件时间戳同一时钟）
+} tx_ts_slot_t;
+
+// 发送时间戳登记表：发送线程在发送前登记编号→序列号，接收线程读取错误队列时查找
+// kernel_tx_*按序列号索引，只由接收线程访问，用于计算线路与协议栈时间
+typedef struct {
+    tx_ts_slot_t *slots;
+    uint32_t mask;
+    _Atomic uint64_t next_id;   // 下一个发送包的内核编号（只由发送线程写，跨轮次累计；接收线程读）
+    uint64_t *kernel_tx_tag;    // 序列号+1
+    kernel_ts_t *kernel_tx;     // 内核发送时间戳
+} tx_ts_table_t;
+
+// 初始化发送时间戳登记表（容量与在途包表相同）
+static int tx_ts_init(tx_ts_table_t *table, uint32_t capacity) {
+    memset(table, 0, sizeof(*table));
+    table->slots = calloc(capacity, sizeof(tx_ts_slot_t));
+    table->kernel_tx_tag = calloc(capacity, sizeof(uint64_t));
+    table->kernel_tx = calloc(capacity, sizeof(kernel_ts_t));
+    if (!table->slots || !table->kernel_tx_tag || !table->kernel_tx) {
+        fprintf(stderr, "Error: Failed to allocate TX timestamp table\n");
+        return -1;
+    }
+    table->mask = capacity - 1;
+    return 0;
+}
+
+// 释放发送时间戳登记表
+static void tx_ts_free(tx_ts_table_t *table) {
+    free(table->slots);
+    free(table->kernel_tx_tag);
+    free(table->kernel_tx);
+    memset(table, 0, sizeof(*table));
+}
+
+// 清空按序列号索引的内核发送时间戳（每轮序列号从0开始）
+static void tx_ts_reset(tx_ts_table_t *table) {
+    memset(table->kernel_tx_tag, 0, (size_t)(table->mask + 1) * sizeof(uint64_t));
+}
+
+// 下一个发送包的编号（发送线程读取自己写的值）
+static uint64_t tx_ts_next_id(tx_ts_table_t *table) {
+    return atomic_load_explicit(&table->next_id, memory_order_relaxed);
+}
+
+// 发送成功n个包后推进编号；release使接收线程看到新编号时也能看到对应槽位的登记
+static void tx_ts_advance(tx_ts_table_t *table, uint64_t n) {
+    atomic_store_explicit(&table->next_id, tx_ts_next_id(table) + n, memory_order_release);
+}
+
+// 登记即将发送的包（编号id）
+static void tx_ts_register(tx_ts_table_t *table, uint64_t id, uint32_t seq_num, uint64_t app_ns) {
+    tx_ts_slot_t *slot = &table->slots[id & table->mask];
+    atomic_store_explicit(&slot->seq_num, seq_num, memory_order_relaxed);
+    atomic_store_explicit(&slot->app_ns, app_ns, memory_order_relaxed);
+    atomic_store_explicit(&slot->tag, id + 1, memory_order_release);
+}
+
+// 处理一个内核发送时间戳：记录应用→内核发送时间，并保存供线路时间计算
+static void tx_ts_complete(tx_ts_table_t *table, ts_breakdown_t *breakdown,
+                           uint32_t id32, const kernel_ts_t *kts) {
+    // 内核编号为32位，扩展为与发送线程最近公布的编号最接近的值
+    // （发送线程先登记再发送，时间戳可能在编号推进之前到达）
+    uint64_t next_id = atomic_load_explicit(&table->next_id, memory_order_acquire);
+    uint64_t id = (next_id & ~0xFFFFFFFFULL) | id32;
+    if (id > next_id + 0x80000000ULL && id >= 0x100000000ULL) {
+        id -= 0x100000000ULL;
+    } else if (id + 0x80000000ULL < next_id) {
+        id += 0x100000000ULL;
+    }
+    tx_ts_slot_t *slot = &table->slots[id & table->mask];
+    if (atomic_load_explicit(&slot->tag, memory_order_acquire) != id + 1) {
+        return;
+    }
+    uint32_t seq_num = (uint32_t)atomic_load_explicit(&slot->seq_num, memory_order_relaxed);
+    uint64_t app_ns = atomic_load_explicit(&slot->app_ns, memory_order_relaxed);
+    
+    if (kts->sw_ns >= app_ns) {
+        hist_record(&breakdown->app_to_kernel_tx, kts->sw_ns - app_ns);
+    }
+    table->kernel_tx_tag[seq_num & table->mask] = (uint64_t)seq_num + 1;
+    table->kernel_tx[seq_num & table->mask] = *kts;
+}
+
+// 批量发送环：预先构造好的数据包及其mmsghdr/iovec，发送时只需写入序列号和时间戳
+// 缓冲池由pool_batches个块组成，packets/iovecs/msgs指向当前块；普通模式只有一个块，
+// 零拷贝模式下轮流使用各块，内核仍在引用的块要等完成通知后才能改写
+typedef struct {
+    int batch_size;
+    int pkt_size;
+    int version;          // 线上包格式版本（PERF_VERSION或PERF_VERSION_LEGACY）
+    int clock_id;         // 线上时间戳时钟源
+    int record_app_ns;    // 是否记录应用发送时间（内核时间戳模式）
+    int send_flags;       // 发送标志（零拷贝模式为MSG_ZEROCOPY）
+    uint64_t calls;       // 成功的发送调用数（每次调用对应一个零拷贝通知编号）
+    int pool_batches;
+    int chunk;                    // 当前块
+    uint64_t *chunk_calls;        // 每块最近一次发送完成后的调用计数
+    char *pool_packets;
+    struct iovec *pool_iovecs;
+    struct mmsghdr *pool_msgs;
+    char *packets;
+    struct iovec *iovecs;
+    struct mmsghdr *msgs;
+    uint32_t *seqs;       // 每个包的序列号
+    uint64_t *app_ns;     // 每个包的应用发送时间（CLOCK_REALTIME）
+    struct sockaddr_in *dest;
+    
+    // UDP GSO：相邻的包本身就是连续存放的，一个超级缓冲区即packets中连续的gso_segs个包
+    int gso_segs;                 // 每个超级缓冲区的段数，0表示不使用GSO
+    struct mmsghdr *gso_msgs;
+    struct iovec *gso_iovecs;
+    int *gso_counts;              // 每个超级缓冲区实际包含的段数
+    char gso_control[CMSG_SPACE(sizeof(uint16_t))];
+} send_ring_t;
+
+// 切换当前块
+static void send_ring_select_chunk(send_ring_t *ring, int chunk) {
+    size_t first = (size_t)chunk * ring->batch_size;
+    ring->chunk = chunk;
+    ring->packets = ring->pool_packets + first * ring->pkt_size;
+    ring->iovecs = ring->pool_iovecs + first;
+    ring->msgs = ring->pool_msgs + first;
 }
 
-// 查找并移除发送时间戳（计算RTT后删除）
-static int find_and_remove_send_time(uint32_t seq_num, struct timeval *send_time) {
-    for (uint32_t i = 0; i < send_time_map_size; i++) {
-        if (send_time_map[i].seq_num == seq_num) {
-            *send_time = send_time_map[i].send_time;
-            // 移除元素（将最后一个元素移到当前位置）
-            if (i < send_time_map_size - 1) {
-                send_time_map[i] = send_time_map[send_time_map_size - 1];
+// 初始化批量发送环：分配pool_batches块、每块batch_size个数据包并预先填充负载
+static int send_ring_init(send_ring_t *ring, int batch_size, int pool_batches, int packet_size,
+                          struct sockaddr_in *dest_addr, int version, int clock_id,
+                          uint32_t flow_id) {
+    memset(ring, 0, sizeof(*ring));
+    ring->batch_size = batch_size;
+    ring->pool_batches = pool_batches;
+    ring->version = version;
+    ring->clock_id = clock_id;
+    size_t header_len = perf_header_size(version);
+    ring->pkt_size = header_len + packet_size;
+    ring->dest = dest_addr;
+    int total = batch_size * pool_batches;
+    ring->pool_packets = malloc((size_t)total * ring->pkt_size);
+    ring->pool_iovecs = calloc(total, sizeof(struct iovec));
+    ring->pool_msgs = calloc(total, sizeof(struct mmsghdr));
+    ring->chunk_calls = calloc(pool_batches, sizeof(uint64_t));
+    ring->seqs = calloc(batch_size, sizeof(uint32_t));
+    ring->app_ns = calloc(batch_size, sizeof(uint64_t));
+    
+    if (!ring->pool_packets || !ring->pool_iovecs || !ring->pool_msgs || !ring->chunk_calls ||
+        !ring->seqs || !ring->app_ns) {
+        fprintf(stderr, "Error: Failed to allocate send ring (%d packets)\n", total);
+        return -1;
+    }
+    
+    for (int i = 0; i < total; i++) {
+        char *pkt = ring->pool_packets + (size_t)i * ring->pkt_size;
+        perf_packet_init(pkt, version, clock_id, flow_id, packet_size);
+        // 填充测试数据（只需填充一次，之后复用）
+        for (int j = 0; j < packet_size; j++) {
+            pkt[header_len + j] = (char)(j % 256);
+        }
+        
+        ring->pool_iovecs[i].iov_base = pkt;
+        ring->pool_iovecs[i].iov_len = ring->pkt_size;
+        ring->pool_msgs[i].msg_hdr.msg_iov = &ring->pool_iovecs[i];
+        ring->pool_msgs[i].msg_hdr.msg_iovlen = 1;
+        ring->pool_msgs[i].msg_hdr.msg_name = dest_addr;
+        ring->pool_msgs[i].msg_hdr.msg_namelen = sizeof(*dest_addr);
+    }
+    send_ring_select_chunk(ring, 0);
+    return 0;
+}
+
+// 释放批量发送环
+static void send_ring_free(send_ring_t *ring) {
+    free(ring->pool_packets);
+    free(ring->pool_iovecs);
+    free(ring->pool_msgs);
+    free(ring->chunk_calls);
+    free(ring->seqs);
+    free(ring->app_ns);
+    free(ring->gso_msgs);
+    free(ring->gso_iovecs);
+    free(ring->gso_counts);
+    memset(ring, 0, sizeof(*ring));
+}
+
+// 给发送环中第idx个包登记到在途包表，并写入分配的序列号和发送时间戳
+// RTT只在本进程内计算，用周期计数器时钟；包头时间戳由对端用自己的时钟相减，必须读取内核时钟
+static void send_ring_stamp(send_ring_t *ring, int idx, inflight_table_t *inflight) {
+    char *pkt = ring->packets + (size_t)idx * ring->pkt_size;
+    uint64_t now_ns = tsc_now_ns();
+    uint64_t wire_ns = get_time_ns(ring->clock_id);
+    uint32_t seq_num = inflight_add(inflight, now_ns);
+    perf_packet_stamp(pkt, ring->version, seq_num, wire_ns);
+    ring->seqs[idx] = seq_num;
+    if (ring->record_app_ns) {
+        ring->app_ns[idx] = ts_realtime_ns();
+    }
+}
+
+// 启用UDP GSO：每个超级缓冲区最多segs个包（受段数上限和单个UDP数据报最大长度限制）
+// 返回实际生效的段数，不适合GSO（包太大）时返回0
+static int send_ring_enable_gso(send_ring_t *ring, int segs) {
+    int max_segs = MAX_BUFFER_SIZE / ring->pkt_size;
+    if (segs > GSO_MAX_SEGMENTS) {
+        segs = GSO_MAX_SEGMENTS;
+    }
+    if (segs > max_segs) {
+        segs = max_segs;
+    }
+    if (segs < 2) {
+        return 0;
+    }
+    
+    int nmsgs = (ring->batch_size + segs - 1) / segs;
+    ring->gso_msgs = calloc(nmsgs, sizeof(struct mmsghdr));
+    ring->gso_iovecs = calloc(nmsgs, sizeof(struct iovec));
+    ring->gso_counts = calloc(nmsgs, sizeof(int));
+    if (!ring->gso_msgs || !ring->gso_iovecs || !ring->gso_counts) {
+        return 0;
+    }
+    
+    // 所有超级缓冲区共用同一个只读的UDP_SEGMENT控制消息（段大小 = 单包大小）
+    memset(ring->gso_control, 0, sizeof(ring->gso_control));
+    struct cmsghdr *cmsg = (struct cmsghdr *)ring->gso_control;
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t gso_size = (uint16_t)ring->pkt_size;
+    memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+    
+    for (int m = 0; m < nmsgs; m++) {
+        struct msghdr *hdr = &ring->gso_msgs[m].msg_hdr;
+        hdr->msg_iov = &ring->gso_iovecs[m];
+        hdr->msg_iovlen = 1;
+        hdr->msg_name = ring->dest;
+        hdr->msg_namelen = sizeof(*ring->dest);
+        hdr->msg_control = ring->gso_control;
+        hdr->msg_controllen = sizeof(ring->gso_control);
+    }
+    ring->gso_segs = segs;
+    return segs;
+}
+
+// 以GSO超级缓冲区发送环中前count个包：内核（或网卡）只需一次协议栈处理，再切分为独立的UDP包
+// 多个超级缓冲区通过一次sendmmsg()提交；返回成功发送的包数，出错返回-1
+static int send_ring_flush_gso(int sockfd, send_ring_t *ring, int count, stats_t *stats,
+                               tx_ts_table_t *tx_ts) {
+    int nmsgs = 0;
+    for (int first = 0; first < count; first += ring->gso_segs) {
+        int n = count - first;
+        if (n > ring->gso_segs) {
+            n = ring->gso_segs;
+        }
+        ring->gso_iovecs[nmsgs].iov_base = ring->packets + (size_t)first * ring->pkt_size;
+        ring->gso_iovecs[nmsgs].iov_len = (size_t)n * ring->pkt_size;
+        ring->gso_counts[nmsgs] = n;
+        nmsgs++;
+    }
+    
+    int sent_msgs = 0, sent = 0;
+    while (sent_msgs < nmsgs) {
+        // 内核对每次GSO发送只分配一个时间戳编号，登记每个超级缓冲区的第一个包
+        if (tx_ts) {
+            for (int m = sent_msgs; m < nmsgs; m++) {
+                int idx = m * ring->gso_segs;
+                tx_ts_register(tx_ts, tx_ts_next_id(tx_ts) + (m - sent_msgs), ring->seqs[idx], ring->app_ns[idx]);
             }
-            send_time_map_size--;
-            return 1;
+        }
+        int n = sendmmsg(sockfd, ring->gso_msgs + sent_msgs, nmsgs - sent_msgs, ring->send_flags);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EINVAL) {
+                LOG_ERROR("GSO sendmmsg failed: segment (%d bytes) exceeds path MTU or GSO unsupported\n",
+                          ring->pkt_size);
+            } else if (errno != EAGAIN && errno != ENOBUFS) {
+                LOG_ERROR("GSO sendmmsg failed: %s\n", strerror(errno));
+            }
+            return sent > 0 ? sent : -1;
+        }
+        for (int m = sent_msgs; m < sent_msgs + n; m++) {
+            stats->packets_sent += ring->gso_counts[m];
+            stats->bytes_sent += ring->gso_msgs[m].msg_len;
+            sent += ring->gso_counts[m];
+        }
+        sent_msgs += n;
+        ring->calls += n;
+        if (tx_ts) {
+            tx_ts_advance(tx_ts, n);
         }
     }
+    return sent;
+}
+
+// 在发送前登记[first, count)范围内包的内核编号（内核只给成功发送的包编号）
+static void send_ring_register_ids(send_ring_t *ring, tx_ts_table_t *tx_ts, int first, int count) {
+    for (int i = first; i < count; i++) {
+        tx_ts_register(tx_ts, tx_ts_next_id(tx_ts) + (i - first), ring->seqs[i], ring->app_ns[i]);
+    }
+}
+
+// 发送环中前count个包：单包使用sendto()，多包使用sendmmsg()
+// tx_ts非NULL时登记内核发送时间戳编号；返回成功发送的包数，出错返回-1
+static int send_ring_flush(int sockfd, send_ring_t *ring, int count, stats_t *stats,
+                           tx_ts_table_t *tx_ts) {
+    if (count == 1) {
+        if (tx_ts) {
+            send_ring_register_ids(ring, tx_ts, 0, 1);
+        }
+        struct msghdr *hdr = &ring->msgs[0].msg_hdr;
+        ssize_t send_len = sendto(sockfd, ring->packets, ring->pkt_size, ring->send_flags,
+                                  (struct sockaddr *)hdr->msg_name, hdr->msg_namelen);
+        if (send_len < 0) {
+            LOG_ERROR("sendto failed: %s\n", strerror(errno));
+            return -1;
+        }
+        stats->packets_sent++;
+        stats->bytes_sent += send_len;
+        ring->calls++;
+        if (tx_ts) {
+            tx_ts_advance(tx_ts, 1);
+        }
+        return 1;
+    }
+    
+    int sent = 0;
+    while (sent < count) {
+        if (tx_ts) {
+            send_ring_register_ids(ring, tx_ts, sent, count);
+        }
+        int n = sendmmsg(sockfd, ring->msgs + sent, count - sent, ring->send_flags);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("sendmmsg failed: %s\n", strerror(errno));
+            return sent > 0 ? sent : -1;
+        }
+        for (int i = sent; i < sent + n; i++) {
+            stats->bytes_sent += ring->msgs[i].msg_len;
+        }
+        stats->packets_sent += n;
+        sent += n;
+        ring->calls += n;
+        if (tx_ts) {
+            tx_ts_advance(tx_ts, n);
+        }
+    }
+    return sent;
+}
+
+// 性能测试流上下文：发送线程与接收线程共享同一个socket和在途包表
+// 统计信息按线程拆分（tx_stats只由发送线程写，rx_stats只由接收线程写），每轮结束后合并
+// 多流模式下每个流独占socket（源端口）、线程和序列号空间，按缓存行对齐避免伪共享
+typedef struct __attribute__((aligned(CACHE_LINE_SIZE))) {
+    int sockfd;
+    uint16_t local_port;            // 系统分配的源端口（主机字节序）
+    int verbose;                    // 打印发送进度和调试信息（单流模式）
+    int tx_cpu;                     // 发送/接收线程绑定的CPU核，-1表示不绑定
+    int rx_cpu;
+    int spin;                       // 本轮为低延迟模式：接收线程自旋在非阻塞recvmsg()上
+    int rt_prio;                    // 本轮收发线程的SCHED_FIFO优先级，0表示不切换
+    pthread_t tx_thread;
+    pthread_t rx_thread;
+    struct sockaddr_in server_addr;
+    int packet_count;
+    int batch_size;
+    int burst_size;
+    int io_backend;                 // IO_BACKEND_SOCKET、IO_BACKEND_URING 或 IO_BACKEND_XDP
+    xsk_t *xsk;                     // AF_XDP只发送socket（仅xdp后端，回送仍由sockfd接收）
+    udp_path_t xdp_path;            // AF_XDP帧的两端地址
+    send_ring_t ring;
+    pacer_t pacer;
+    stats_t tx_stats;
+    stats_t rx_stats;
+    inflight_table_t inflight;
+    seqwin_t echo_seq;              // 回送到达顺序（乱序距离统计，只由接收线程写）
+    uint32_t flow_id;
+    ts_breakdown_t *ts_breakdown;   // 仅在启用内核时间戳时分配
+    tx_ts_table_t tx_ts;
+    char rx_control[TS_CONTROL_LEN];
+    char *rx_buffer;
+    sockbuf_stats_t sockbuf;        // 接收socket的累计丢弃数与缓冲区自动调整状态（只由接收线程写）
+    uint32_t round_drops_base;      // 本轮开始时的累计丢弃数
+    uint64_t tx_cpu_user_ns;  // 发送线程本轮消耗的用户态CPU时间
+    uint64_t tx_cpu_sys_ns;   // 发送线程本轮消耗的内核态CPU时间
+    zc_stats_t zc;            // 零拷贝完成统计（跨轮次累计，只由发送线程写）
+    uint64_t zc_timeouts;     // 等待完成通知超时而强制复用缓冲区的次数
+    volatile int tx_done;     // 发送线程已发完所有包
+    volatile int rx_stop;     // 通知接收线程退出
+} perf_flow_t;
+
+// 根据内核收发时间戳记录回送包的延迟分解
+static void record_echo_timestamps(perf_flow_t *flow, const struct msghdr *msg, uint32_t seq_num) {
+    kernel_ts_t rx_ts;
+    if (ts_get_rx(msg, &rx_ts) < 0 || rx_ts.sw_ns == 0) {
+        return;
+    }
+    
+    uint64_t app_ns = ts_realtime_ns();
+    if (app_ns >= rx_ts.sw_ns) {
+        hist_record(&flow->ts_breakdown->kernel_rx_to_app, app_ns - rx_ts.sw_ns);
+    }
+    
+    // 线路与协议栈时间：内核发送到内核接收（两端都有硬件时间戳时优先使用硬件时间戳）
+    tx_ts_table_t *tx_ts = &flow->tx_ts;
+    uint32_t idx = seq_num & tx_ts->mask;
+    if (tx_ts->kernel_tx_tag[idx] != (uint64_t)seq_num + 1) {
+        return;
+    }
+    const kernel_ts_t *tx = &tx_ts->kernel_tx[idx];
+    uint64_t tx_ns = tx->sw_ns, rx_ns = rx_ts.sw_ns;
+    if (tx->hw_ns && rx_ts.hw_ns) {
+        tx_ns = tx->hw_ns;
+        rx_ns = rx_ts.hw_ns;
+    }
+    if (tx_ns && rx_ns >= tx_ns) {
+        hist_record(&flow->ts_breakdown->wire, rx_ns - tx_ns);
+    }
+}
+
+// 处理一个回送数据包：匹配发送时间计算RTT并检测丢包
+// verbose非0时打印调试信息
+static void handle_echo(perf_flow_t *flow, const char *buffer, ssize_t recv_len,
+                        const struct sockaddr_in *recv_addr, const struct msghdr *msg,
+                        int verbose) {
+    const struct sockaddr_in *server_addr = &flow->server_addr;
+    stats_t *stats = &flow->rx_stats;
+    sockbuf_note(&flow->sockbuf, msg);
+    
+    // 地址字符串只在日志实际输出时转换（级别或限速不通过时不求值）
+    char recv_ip_str[INET_ADDRSTRLEN];
+    char server_ip_str[INET_ADDRSTRLEN];
+    
+    if (verbose) {
+        // 显示所有接收到的数据包（调试用）
+        LOG_DEBUG("[DEBUG] Received UDP packet: size=%zd bytes, from %s:%d (expected from %s)\n",
+                  recv_len, inet_ntop(AF_INET, &recv_addr->sin_addr, recv_ip_str, INET_ADDRSTRLEN),
+                  ntohs(recv_addr->sin_port),
+                  inet_ntop(AF_INET, &server_addr->sin_addr, server_ip_str, INET_ADDRSTRLEN));
+    }
+    
+    // 验证是否来自目标服务器（只检查IP地址，不检查端口）
+    // 因为TC3可能从不同端口回送数据
+    if (recv_addr->sin_addr.s_addr != server_addr->sin_addr.s_addr) {
+        if (verbose) {
+            // 接收到来自非目标IP的包（可能是其他来源）
+            LOG_DEBUG("[DEBUG] Received packet from unexpected source %s:%d (expected %s)\n"
+                      "[DEBUG] This packet is being ignored (IP address mismatch)\n",
+                      inet_ntop(AF_INET, &recv_addr->sin_addr, recv_ip_str, INET_ADDRSTRLEN),
+                      ntohs(recv_addr->sin_port),
+                      inet_ntop(AF_INET, &server_addr->sin_addr, server_ip_str, INET_ADDRSTRLEN));
+        }
+        return;
+    }
+    
+    perf_header_t hdr;
+    if (perf_packet_parse(buffer, recv_len, &hdr) < 0) {
+        if (verbose) {
+            // 接收到非性能测试包
+            LOG_DEBUG("[DEBUG] Received non-perf packet from %s:%d (size=%zd, expected>=%zu)\n"
+                      "[DEBUG] Packet size too small, may not be a perf_packet_t structure\n",
+                      inet_ntop(AF_INET, &recv_addr->sin_addr, recv_ip_str, INET_ADDRSTRLEN),
+                      ntohs(recv_addr->sin_port), recv_len, perf_header_size(flow->ring.version));
+        }
+        return;
+    }
+    
+    // 计算RTT（与发送时刻同为周期计数器时钟）
+    uint64_t recv_time_ns = tsc_now_ns();
+    uint64_t send_time_ns = 0;
+    
+    // 其他流的包（flow_id不同）不参与本流的RTT匹配
+    inflight_result_t result = INFLIGHT_UNKNOWN;
+    if (hdr.version == PERF_VERSION_LEGACY || hdr.flow_id == flow->flow_id) {
+        result = inflight_take(&flow->inflight, hdr.seq_num, &send_time_ns);
+    } else {
+        flow->inflight.unknown++;
+    }
+    if (result != INFLIGHT_MATCHED) {
+        if (verbose) {
+            if (result == INFLIGHT_LATE) {
+                // 迟到响应：对应槽位已被新包复用
+                LOG_DEBUG("[DEBUG] Late echo seq_num=%u from %s:%d arrived outside the %u-packet window\n",
+                          hdr.seq_num, inet_ntop(AF_INET, &recv_addr->sin_addr, recv_ip_str, INET_ADDRSTRLEN),
+                          ntohs(recv_addr->sin_port), flow->inflight.capacity);
+            } else if (result == INFLIGHT_DUPLICATE) {
+                LOG_DEBUG("[DEBUG] Duplicate echo seq_num=%u from %s:%d (size=%zd)\n",
+                          hdr.seq_num, inet_ntop(AF_INET, &recv_addr->sin_addr, recv_ip_str, INET_ADDRSTRLEN),
+                          ntohs(recv_addr->sin_port), recv_len);
+            } else {
+                // 接收到未知序列号的包
+                LOG_DEBUG("[DEBUG] Received packet with unknown seq_num=%u from %s:%d (size=%zd)\n"
+                          "[DEBUG] This packet may be from a previous test or invalid\n",
+                          hdr.seq_num, inet_ntop(AF_INET, &recv_addr->sin_addr, recv_ip_str, INET_ADDRSTRLEN),
+                          ntohs(recv_addr->sin_port), recv_len);
+            }
+        }
+        return;
+    }
+    
+    // 丢失、重复和迟到由在途包表判定，这里只统计首次到达的回送的乱序情况
+    seqwin_update(&flow->echo_seq, hdr.seq_num);
+    
+    // 纳秒单调时钟下回环RTT也不会被截断为0；收发线程在不同核上读取计数器，
+    // 核间偏差可能使接收时间略早于发送时间，这样的响应只计包数，不计入延迟统计
+    int rtt_valid = recv_time_ns >= send_time_ns;
+    uint64_t rtt_ns = rtt_valid ? recv_time_ns - send_time_ns : 0;
+    double rtt_ms = rtt_ns / 1000000.0;
+    if (rtt_valid) {
+        if (stats->latency_hist.total_count == 0 || rtt_ms < stats->min_latency_ms) {
+            stats->min_latency_ms = rtt_ms;
+        }
+        if (rtt_ms > stats->max_latency_ms) {
+            stats->max_latency_ms = rtt_ms;
+        }
+        stats->total_latency_ms += rtt_ms;
+        hist_record(&stats->latency_hist, rtt_ns);
+    }
+    stats->packets_received++;
+    stats->bytes_received += recv_len;
+    
+    if (flow->ts_breakdown) {
+        record_echo_timestamps(flow, msg, hdr.seq_num);
+    }
+    
+    // 每100个包显示一次接收信息
+    if (verbose && stats->packets_received % 100 == 0) {
+        LOG_INFO("[RECV] Packet #%u from %s:%d, RTT=%.4f ms\n",
+                 hdr.seq_num, inet_ntop(AF_INET, &recv_addr->sin_addr, recv_ip_str, INET_ADDRSTRLEN),
+                 ntohs(recv_addr->sin_port), rtt_ms);
+    }
+}
+
+// 通过io_uring发送环中前count个包：每个包一个SENDMSG，整批一次提交并等待全部完成
+// （发送环的缓冲区在下一批复用，必须等完成后才能重新写入）；返回成功发送的包数
+static int send_ring_flush_uring(uring_t *uring, int sockfd, send_ring_t *ring, int count,
+                                 stats_t *stats, tx_ts_table_t *tx_ts) {
+    int sent = 0;
+    for (int first = 0; first < count; ) {
+        int chunk = count - first;
+        if (chunk > (int)uring->sq_entries) {
+            chunk = (int)uring->sq_entries;
+        }
+        if (tx_ts) {
+            send_ring_register_ids(ring, tx_ts, first, first + chunk);
+        }
+        for (int i = first; i < first + chunk; i++) {
+            struct io_uring_sqe *sqe = uring_get_sqe(uring);
+            uring_prep_sendmsg(sqe, sockfd, &ring->msgs[i].msg_hdr, (uint64_t)i);
+            sqe->msg_flags = ring->send_flags;
+        }
+        
+        int reaped = 0, ok = 0;
+        if (uring_submit(uring, chunk, -1) < 0 && errno != EINTR) {
+            perror("io_uring_enter failed");
+            return sent;
+        }
+        while (reaped < chunk) {
+            struct io_uring_cqe *cqe = uring_peek_cqe(uring);
+            if (!cqe) {
+                if (uring_submit(uring, 1, -1) < 0 && errno != EINTR) {
+                    perror("io_uring_enter failed");
+                    return sent + ok;
+                }
+                continue;
+            }
+            if (cqe->res >= 0) {
+                stats->bytes_sent += cqe->res;
+                ok++;
+            } else if (cqe->res != -EAGAIN && cqe->res != -ENOBUFS) {
+                LOG_ERROR("io_uring sendmsg failed: %s\n", strerror(-cqe->res));
+            }
+            uring_cqe_seen(uring);
+            reaped++;
+        }
+        stats->packets_sent += ok;
+        ring->calls += ok;
+        if (tx_ts) {
+            tx_ts_advance(tx_ts, ok);
+        }
+        sent += ok;
+        first += chunk;
+    }
+    return sent;
+}
+
+// 通过AF_XDP发出发送环中前count个包：每个UMEM帧已预先写好以太网/IP/UDP头和负载，
+// 这里只复制写入了序列号和时间戳的性能测试包头；返回发送的包数
+static int send_ring_flush_xdp(xsk_t *xsk, send_ring_t *ring, int count, stats_t *stats) {
+    size_t header_len = perf_header_size(ring->version);
+    int sent = 0;
+    for (; sent < count && running; sent++) {
+        // 没有空闲帧或发送环已满时唤醒内核发送，并回收已完成的帧
+        uint64_t addr;
+        while (xsk_tx_alloc(xsk, &addr) < 0 && running) {
+            xsk_flush(xsk);
+            xsk_complete(xsk);
+        }
+        if (!running) {
+            break;
+        }
+        memcpy(xsk_frame(xsk, addr) + UDP_FRAME_HDR_LEN, ring->packets + (size_t)sent * ring->pkt_size,
+               header_len);
+        // 发送环一直不排空（如链路断开）时也要能响应Ctrl+C，未放入发送环的帧归还空闲栈
+        int queued;
+        while (!(queued = xsk_send(xsk, addr, UDP_FRAME_HDR_LEN + ring->pkt_size) == 0) && running) {
+            xsk_flush(xsk);
+            xsk_complete(xsk);
+        }
+        if (!queued) {
+            xsk_tx_release(xsk, addr);
+            break;
+        }
+    }
+    xsk_flush(xsk);
+    xsk_complete(xsk);
+    stats->packets_sent += sent;
+    stats->bytes_sent += (uint64_t)sent * ring->pkt_size;
+    return sent;
+}
+
+// 读取当前线程已消耗的用户态/内核态CPU时间（纳秒）
+static void thread_cpu_ns(uint64_t *user_ns, uint64_t *sys_ns) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) < 0) {
+        *user_ns = *sys_ns = 0;
+        return;
+    }
+    *user_ns = (uint64_t)usage.ru_utime.tv_sec * 1000000000ULL + usage.ru_utime.tv_usec * 1000ULL;
+    *sys_ns = (uint64_t)usage.ru_stime.tv_sec * 1000000000ULL + usage.ru_stime.tv_usec * 1000ULL;
+}
+
+// 零拷贝模式：切换到下一个发送块。该块上一次发送的页可能仍被内核引用，
+// 必须等其全部完成通知到达后才能改写（超时后强制复用，避免发送线程永久阻塞）
+static void zc_acquire_chunk(perf_flow_t *flow) {
+    send_ring_t *ring = &flow->ring;
+    int next = (ring->chunk + 1) % ring->pool_batches;
+    
+    zc_read_completions(flow->sockfd, &flow->zc);
+    double wait_start = 0.0;
+    while (flow->zc.completed < ring->chunk_calls[next]) {
+        if (wait_start == 0.0) {
+            wait_start = get_time_ms();
+        } else if (get_time_ms() - wait_start > ZC_WAIT_TIMEOUT_MS) {
+            flow->zc_timeouts++;
+            break;
+        }
+        zc_wait_completions(flow->sockfd, &flow->zc, 10);
+    }
+    send_ring_select_chunk(ring, next);
+}
+
+// 把当前线程绑定到指定CPU核（cpu为-1时不绑定）
+static void pin_current_thread(int cpu, const char *role) {
+    if (cpu < 0) {
+        return;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (err != 0) {
+        fprintf(stderr, "Warning: Failed to pin %s thread to CPU %d: %s\n", role, cpu, strerror(err));
+    }
+}
+
+// 发送线程：按pacer节奏发出所有数据包，不受接收处理影响
+static void *tx_thread_main(void *arg) {
+    perf_flow_t *flow = (perf_flow_t *)arg;
+    pin_current_thread(flow->tx_cpu, "send");
+    lowlat_thread(flow->rt_prio, "send");
+    int zerocopy = (flow->ring.send_flags & MSG_ZEROCOPY) != 0;
+    uint64_t cpu_user_start, cpu_sys_start;
+    thread_cpu_ns(&cpu_user_start, &cpu_sys_start);
+    
+    // io_uring实例只在本线程内提交，初始化失败时退回sendmmsg
+    uring_t uring;
+    int use_uring = 0;
+    if (flow->io_backend == IO_BACKEND_URING) {
+        if (uring_init(&uring, URING_ENTRIES) == 0) {
+            use_uring = 1;
+        } else {
+            fprintf(stderr, "Warning: io_uring unavailable for send, falling back to sendmmsg()\n");
+        }
+    }
+    
+    // 每个发送时刻发出一个突发，突发内按batch_size分批sendmmsg()
+    pacer_start(&flow->pacer);
+    for (int i = 0; i < flow->packet_count && running; ) {
+        int burst = flow->packet_count - i;
+        if (burst > flow->burst_size) {
+            burst = flow->burst_size;
+        }
+        
+        pacer_wait(&flow->pacer);
+        
+        for (int done = 0; done < burst; ) {
+            int count = burst - done;
+            if (count > flow->batch_size) {
+                count = flow->batch_size;
+            }
+            
+            if (zerocopy) {
+                zc_acquire_chunk(flow);
+            }
+            
+            // 写入序列号和时间戳
+            for (int k = 0; k < count; k++) {
+                send_ring_stamp(&flow->ring, k, &flow->inflight);
+            }
+            
+            // 发送数据包（失败的包按未响应计入丢包）
+            tx_ts_table_t *tx_ts = flow->ts_breakdown ? &flow->tx_ts : NULL;
+            if (flow->xsk) {
+                send_ring_flush_xdp(flow->xsk, &flow->ring, count, &flow->tx_stats);
+            } else if (flow->ring.gso_segs > 0) {
+                send_ring_flush_gso(flow->sockfd, &flow->ring, count, &flow->tx_stats, tx_ts);
+            } else if (use_uring) {
+                send_ring_flush_uring(&uring, flow->sockfd, &flow->ring, count, &flow->tx_stats, tx_ts);
+            } else {
+                send_ring_flush(flow->sockfd, &flow->ring, count, &flow->tx_stats, tx_ts);
+            }
+            if (zerocopy) {
+                flow->ring.chunk_calls[flow->ring.chunk] = flow->ring.calls;
+                flow->zc.calls = flow->ring.calls;
+            }
+            done += count;
+        }
+        
+        // 显示进度（每100个包显示一次；多流模式由主线程汇总打印）
+        // 经异步日志环输出并按调用点限速，终端写入不会阻塞发送循环
+        int prev = i;
+        i += burst;
+        if (flow->verbose && (i / 100 != prev / 100 || i == flow->packet_count)) {
+            LOG_INFO("Progress: %d/%d sent, %lu received (%.1f%%)\n",
+                     i, flow->packet_count,
+                     __atomic_load_n(&flow->rx_stats.packets_received, __ATOMIC_RELAXED),
+                     i * 100.0 / flow->packet_count);
+        }
+    }
+    pacer_finish(&flow->pacer);
+    
+    // 等待剩余的零拷贝完成通知，使本轮的零拷贝/复制统计完整
+    if (zerocopy) {
+        double wait_start = get_time_ms();
+        while (flow->zc.completed < flow->zc.calls && get_time_ms() - wait_start < ZC_WAIT_TIMEOUT_MS) {
+            zc_wait_completions(flow->sockfd, &flow->zc, 10);
+        }
+    }
+    if (use_uring) {
+        uring_free(&uring);
+    }
+    
+    uint64_t cpu_user_end, cpu_sys_end;
+    thread_cpu_ns(&cpu_user_end, &cpu_sys_end);
+    flow->tx_cpu_user_ns = cpu_user_end - cpu_user_start;
+    flow->tx_cpu_sys_ns = cpu_sys_end - cpu_sys_start;
+    
+    flow->tx_done = 1;
+    return NULL;
+}
+
+// 打印发送路径及发送线程的CPU开销，便于比较sendto/sendmmsg/GSO/io_uring各路径
+// 多流模式下CPU时间为所有发送线程之和，elapsed取各流发送时间范围的并集
+static void print_tx_cpu_report(const perf_flow_t *flows, int num_flows, const pacer_t *pacer,
+                                uint64_t packets_sent) {
+    const perf_flow_t *flow = &flows[0];
+    const char *zc = (flow->ring.send_flags & MSG_ZEROCOPY) ? " + MSG_ZEROCOPY" : "";
+    if (flow->xsk) {
+        printf("发送路径: AF_XDP（每批%d包，%s）\n", flow->batch_size, flow->xsk->zerocopy ? "零拷贝" : "复制模式");
+    } else if (flow->ring.gso_segs > 0) {
+        printf("发送路径: UDP GSO（每次最多%d段）%s\n", flow->ring.gso_segs, zc);
+    } else if (flow->io_backend == IO_BACKEND_URING) {
+        printf("发送路径: io_uring（每次提交%d个SENDMSG）%s\n", flow->batch_size, zc);
+    } else if (flow->batch_size > 1) {
+        printf("发送路径: sendmmsg（每批%d包）%s\n", flow->batch_size, zc);
+    } else {
+        printf("发送路径: sendto（逐包）%s\n", zc);
+    }
+    
+    uint64_t user_ns = 0, sys_ns = 0;
+    for (int f = 0; f < num_flows; f++) {
+        user_ns += flows[f].tx_cpu_user_ns;
+        sys_ns += flows[f].tx_cpu_sys_ns;
+    }
+    uint64_t cpu_ns = user_ns + sys_ns;
+    double elapsed_ns = (double)(pacer->end_ns - pacer->start_ns);
+    printf("发送线程CPU%s: 用户 %.1f ms, 系统 %.1f ms, 占用率 %.1f%%",
+           num_flows > 1 ? "（所有流合计）" : "", user_ns / 1e6, sys_ns / 1e6,
+           elapsed_ns > 0 ? cpu_ns / elapsed_ns * 100.0 : 0.0);
+    if (packets_sent > 0) {
+        printf(", 每包 %.0f ns", (double)cpu_ns / packets_sent);
+    }
+    printf("\n");
+}
+
+// 取走错误队列中的内核发送时间戳
+static void drain_tx_timestamps(perf_flow_t *flow) {
+    uint32_t id;
+    kernel_ts_t kts;
+    while (ts_read_tx(flow->sockfd, &id, &kts) > 0) {
+        tx_ts_complete(&flow->tx_ts, flow->ts_breakdown, id, &kts);
+    }
+}
+
+// io_uring接收循环：多发recvmsg从提供缓冲区环取包，零拷贝交给handle_echo()
+// 内核不支持所需特性时返回-1，由调用者退回poll+recvmsg
+static int rx_loop_uring(perf_flow_t *flow) {
+    uring_t uring;
+    if (uring_init(&uring, URING_ENTRIES) < 0 ||
+        uring_setup_buffers(&uring, URING_BUFFERS, TS_CONTROL_LEN) < 0) {
+        uring_free(&uring);
+        return -1;
+    }
+    
+    int armed = 0;
+    int ret = 0;
+    while (!flow->rx_stop) {
+        if (!armed) {
+            struct io_uring_sqe *sqe = uring_get_sqe(&uring);
+            if (sqe) {
+                uring_prep_recvmsg_multishot(&uring, sqe, flow->sockfd, 0);
+                armed = 1;
+            }
+        }
+        
+        // 短超时等待，以便及时响应退出通知
+        if (uring_submit(&uring, 1, 100) < 0 && errno != EINTR) {
+            perror("io_uring_enter failed");
+            break;
+        }
+        
+        // 先处理错误队列中的内核发送时间戳，保证回送包到达时其发送时间戳已就绪
+        if (flow->ts_breakdown) {
+            drain_tx_timestamps(flow);
+        }
+        
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek_cqe(&uring)) != NULL) {
+            int res = cqe->res;
+            uring_recv_t recv;
+            int have_buf = (res >= 0 && uring_recv_parse(&uring, cqe, &recv) == 0);
+            if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                armed = 0;
+            }
+            uring_cqe_seen(&uring);
+            
+            if (res < 0) {
+                // 旧内核不支持多发recvmsg：尚未收到任何包时退回poll路径
+                if ((res == -EINVAL || res == -EOPNOTSUPP) && flow->rx_stats.packets_received == 0) {
+                    ret = -1;
+                    break;
+                }
+                if (res != -ENOBUFS && res != -EINTR) {
+                    LOG_ERROR("io_uring recvmsg failed: %s\n", strerror(-res));
+                }
+                continue;
+            }
+            if (have_buf) {
+                handle_echo(flow, recv.payload, recv.payload_len, recv.addr, &recv.msg,
+                            flow->verbose && !flow->tx_done);
+                uring_buf_recycle(&uring, recv.bid);
+            }
+        }
+        if (ret < 0) {
+            break;
+        }
+        uring_buf_publish(&uring);
+        if (sockbuf_auto) {
+            sockbuf_autotune(flow->sockfd, &flow->sockbuf);
+        }
+    }
+    
+    uring_free(&uring);
+    return ret;
+}
+
+// 接收线程：持续接收回送数据包并计算RTT，直到收到退出通知
+static void *rx_thread_main(void *arg) {
+    perf_flow_t *flow = (perf_flow_t *)arg;
+    struct pollfd pfd = { .fd = flow->sockfd, .events = POLLIN };
+    pin_current_thread(flow->rx_cpu, "receive");
+    lowlat_thread(flow->rt_prio, "receive");
+    
+    if (flow->io_backend == IO_BACKEND_URING) {
+        if (rx_loop_uring(flow) == 0) {
+            return NULL;
+        }
+        fprintf(stderr, "Warning: io_uring multishot receive unavailable, falling back to poll()\n");
+    }
+    
+    while (!flow->rx_stop) {
+        if (flow->spin) {
+            // 低延迟模式：不经poll()睡眠唤醒，直接自旋在非阻塞接收上
+            if (flow->ts_breakdown) {
+                drain_tx_timestamps(flow);
+            }
+        } else {
+            // 短超时轮询，以便及时响应退出通知
+            int ready = poll(&pfd, 1, 100);
+            if (ready <= 0) {
+                if (ready < 0 && errno != EINTR) {
+                    LOG_ERROR("poll failed: %s\n", strerror(errno));
+                }
+                continue;
+            }
+            
+            // 先处理错误队列中的内核发送时间戳，保证回送包到达时其发送时间戳已就绪
+            if (flow->ts_breakdown && (pfd.revents & POLLERR)) {
+                drain_tx_timestamps(flow);
+            }
+        }
+        
+        // 取走socket队列中所有已到达的包
+        while (!flow->rx_stop) {
+            struct sockaddr_in recv_addr;
+            struct iovec iov = { .iov_base = flow->rx_buffer, .iov_len = MAX_BUFFER_SIZE };
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_name = &recv_addr;
+            msg.msg_namelen = sizeof(recv_addr);
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = flow->rx_control;
+            msg.msg_controllen = sizeof(flow->rx_control);
+            ssize_t recv_len = recvmsg(flow->sockfd, &msg, MSG_DONTWAIT);
+            
+            if (recv_len < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    LOG_ERROR("recvmsg failed: %s\n", strerror(errno));
+                }
+                break;
+            }
+            
+            // 发送阶段打印调试信息，发送完成后的等待阶段静默处理
+            handle_echo(flow, flow->rx_buffer, recv_len, &recv_addr, &msg, flow->verbose && !flow->tx_done);
+        }
+        if (sockbuf_auto) {
+            sockbuf_autotune(flow->sockfd, &flow->sockbuf);
+        }
+    }
+    return NULL;
+}
+
+// 创建UDP socket并绑定到系统分配的本地端口；返回socket，失败返回-1
+static int open_client_socket(uint16_t *local_port) {
+    int sockfd = create_udp_socket();
+    if (sockfd < 0) {
+        return -1;
+    }
+    
+    // 绑定到任意本地端口（让系统自动分配）
+    struct sockaddr_in local_addr;
+    memset(&local_addr, 0, sizeof(local_addr));
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_addr.s_addr = INADDR_ANY;
+    local_addr.sin_port = 0;  // 0表示让系统自动分配端口
+    if (bind(sockfd, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0) {
+        perror("bind failed");
+        close(sockfd);
+        return -1;
+    }
+    
+    // 获取绑定的本地端口
+    socklen_t len = sizeof(local_addr);
+    *local_port = 0;
+    if (getsockname(sockfd, (struct sockaddr *)&local_addr, &len) == 0) {
+        *local_port = ntohs(local_addr.sin_port);
+    }
+    return sockfd;
+}
+
+// 分配测试流的发送环、在途包表和时间戳表（socket、目标地址、批大小和流ID由调用者预先设置）
+static int perf_flow_alloc(perf_flow_t *flow, int packet_size, int pkt_version, int clock_id,
+                           int inflight_window, int zerocopy, int want_ts) {
+    flow->rx_buffer = malloc(MAX_BUFFER_SIZE);
+    if (!flow->rx_buffer ||
+        send_ring_init(&flow->ring, flow->batch_size, zerocopy ? ZC_POOL_BATCHES : 1, packet_size,
+                       &flow->server_addr, pkt_version, clock_id, flow->flow_id) < 0 ||
+        inflight_init(&flow->inflight, inflight_window) < 0 ||
+        seqwin_init(&flow->echo_seq, flow->inflight.capacity) < 0 ||
+        (want_ts &&
+         (!(flow->ts_breakdown = calloc(1, sizeof(ts_breakdown_t))) ||
+          tx_ts_init(&flow->tx_ts, flow->inflight.capacity) < 0))) {
+        return -1;
+    }
+    flow->ring.record_app_ns = (flow->ts_breakdown != NULL);
+    flow->ring.send_flags = zerocopy ? MSG_ZEROCOPY : 0;
     return 0;
 }
 
-// 清理发送时间映射表
-static void clear_send_time_map(void) {
-    send_time_map_size = 0;
+// 低延迟模式：测试开始前让接收缓冲区、在途包表和时间戳表完成缺页
+static void perf_flow_prefault(perf_flow_t *flow) {
+    lowlat_prefault(flow->rx_buffer, MAX_BUFFER_SIZE);
+    lowlat_prefault(flow->inflight.slots, flow->inflight.capacity * sizeof(inflight_slot_t));
+    if (flow->ts_breakdown) {
+        lowlat_prefault(flow->tx_ts.slots, (flow->tx_ts.mask + 1) * sizeof(tx_ts_slot_t));
+    }
+}
+
+// 设置本轮的收发模式：低延迟模式绑定隔离核、自旋接收并开启socket忙轮询；
+// 默认模式阻塞在poll()中，单流不绑核（对比模式下两种模式逐轮交替）
+static void perf_flow_set_mode(perf_flow_t *flow, int index, int num_flows, long num_cpus,
+                               const lowlat_t *ll, int low) {
+    flow->spin = low;
+    flow->rt_prio = low ? ll->rt_prio : 0;
+    if (low) {
+        flow->rx_cpu = lowlat_cpu(ll, index);
+        flow->tx_cpu = lowlat_cpu(ll, num_flows + index);
+    } else {
+        flow->tx_cpu = num_flows > 1 ? (int)(index % num_cpus) : -1;
+        flow->rx_cpu = num_flows > 1 ? (int)((num_flows + index) % num_cpus) : -1;
+    }
+    if (ll->enabled) {
+        lowlat_socket(flow->sockfd, low ? ll->busy_poll_us : 0);
+    }
+}
+
+// 对比模式：默认模式与低延迟模式的RTT分布并列输出
+static void print_mode_comparison(const latency_hist_t *hists, const int *rounds) {
+    static const char *names[] = { "默认模式", "低延迟模式" };
+    static const double percentiles[] = { 50.0, 99.0, 99.9 };
+    static const char *labels[] = { "p50", "p99", "p99.9" };
+    char before[64], after[64];
+    
+    printf("\n========== 延迟模式对比 ==========\n");
+    for (int m = 0; m < 2; m++) {
+        printf("%s (%d 轮) ", names[m], rounds[m]);
+        if (hists[m].total_count == 0) {
+            printf("无RTT样本\n");
+            continue;
+        }
+        print_latency_percentiles(&hists[m]);
+    }
+    if (hists[0].total_count > 0 && hists[1].total_count > 0) {
+        for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+            uint64_t a = hist_value_at_percentile(&hists[0], percentiles[i]);
+            uint64_t b = hist_value_at_percentile(&hists[1], percentiles[i]);
+            format_latency(a / 1e6, before, sizeof(before));
+            format_latency(b / 1e6, after, sizeof(after));
+            printf("%s: %s -> %s (%+.1f%%)\n", labels[i], before, after,
+                   a > 0 ? ((double)b - (double)a) * 100.0 / a : 0.0);
+        }
+        format_latency(hists[0].max_ns / 1e6, before, sizeof(before));
+        format_latency(hists[1].max_ns / 1e6, after, sizeof(after));
+        printf("max: %s -> %s\n", before, after);
+    }
+    printf("===================================\n");
+}
+
+// 释放测试流的资源（socket由调用者关闭）
+static void perf_flow_free(perf_flow_t *flow) {
+    send_ring_free(&flow->ring);
+    free(flow->rx_buffer);
+    flow->rx_buffer = NULL;
+    inflight_free(&flow->inflight);
+    seqwin_free(&flow->echo_seq);
+    tx_ts_free(&flow->tx_ts);
+    free(flow->ts_breakdown);
+    flow->ts_breakdown = NULL;
+    if (flow->xsk) {
+        xsk_close(flow->xsk);
+        free(flow->xsk);
+        flow->xsk = NULL;
+    }
+}
+
+// 释放所有测试流；流0的socket是主socket，由main()关闭
+static void perf_flows_destroy(perf_flow_t *flows, int num_flows) {
+    for (int f = 0; f < num_flows; f++) {
+        perf_flow_free(&flows[f]);
+        if (f > 0 && flows[f].sockfd >= 0) {
+            close(flows[f].sockfd);
+        }
+    }
+    free(flows);
+}
+
+// 每轮开始前重置测试流的统计和在途包表
+static void perf_flow_reset(perf_flow_t *flow) {
+    inflight_reset(&flow->inflight);
+    seqwin_reset(&flow->echo_seq);
+    if (flow->ts_breakdown) {
+        tx_ts_reset(&flow->tx_ts);
+        ts_breakdown_reset(flow->ts_breakdown);
+    }
+    memset(&flow->tx_stats, 0, sizeof(flow->tx_stats));
+    memset(&flow->rx_stats, 0, sizeof(flow->rx_stats));
+    sockbuf_read(flow->sockfd, &flow->sockbuf);
+    flow->round_drops_base = flow->sockbuf.drops;
+    flow->tx_done = 0;
+    flow->rx_stop = 0;
+}
+
+// 周期时间序列报告的采样回调：无锁读取各流收发线程的累计计数器
+// 未响应数（发送数 - 接收数）包含在途的包，区间丢包按其增量计
+typedef struct {
+    perf_flow_t *flows;
+    int num_flows;
+} client_report_arg_t;
+
+static void client_report_sample(void *arg, report_sample_t *out) {
+    const client_report_arg_t *ra = (const client_report_arg_t *)arg;
+    for (int f = 0; f < ra->num_flows; f++) {
+        const perf_flow_t *flow = &ra->flows[f];
+        uint64_t sent = __atomic_load_n(&flow->tx_stats.packets_sent, __ATOMIC_RELAXED);
+        uint64_t received = __atomic_load_n(&flow->rx_stats.packets_received, __ATOMIC_RELAXED);
+        out->packets_sent += sent;
+        out->bytes_sent += __atomic_load_n(&flow->tx_stats.bytes_sent, __ATOMIC_RELAXED);
+        out->packets_received += received;
+        out->bytes_received += __atomic_load_n(&flow->rx_stats.bytes_received, __ATOMIC_RELAXED);
+        out->packets_lost += sent > received ? sent - received : 0;
+        out->reordered += __atomic_load_n(&flow->echo_seq.stats.reordered, __ATOMIC_RELAXED);
+        out->socket_drops += __atomic_load_n(&flow->sockbuf.drops, __ATOMIC_RELAXED) - flow->round_drops_base;
+        hist_accumulate_live(&out->latency, &flow->rx_stats.latency_hist);
+    }
+}
+
+// 打印多流模式下单个流的本轮结果
+static void print_flow_result(int idx, perf_flow_t *flow) {
+    uint64_t sent = flow->tx_stats.packets_sent;
+    uint64_t lost = inflight_pending(&flow->inflight) + atomic_load(&flow->inflight.expired);
+    const latency_hist_t *hist = &flow->rx_stats.latency_hist;
+    double elapsed_sec = (flow->pacer.end_ns - flow->pacer.start_ns) / 1e9;
+    printf("流 %d (端口 %u, 流ID %u): 发送 %lu (%.0f pps), 接收 %lu, 丢失 %lu (%.2f%%)",
+           idx, flow->local_port, flow->flow_id, sent, elapsed_sec > 0 ? sent / elapsed_sec : 0.0,
+           flow->rx_stats.packets_received, lost, sent > 0 ? lost * 100.0 / sent : 0.0);
+    if (hist->total_count > 0) {
+        printf(", 平均RTT %.4f ms, p99 %.4f ms",
+               flow->rx_stats.total_latency_ms / hist->total_count,
+               hist_value_at_percentile(hist, 99.0) / 1e6);
+    }
+    printf("\n");
 }
 
 int main(int argc, char *argv[]) {
@@ -68,12 +1315,66 @@ int main(int argc, char *argv[]) {
     int test_packet_count = 1000;
     int packet_size = 0;  // 0表示使用最大UDP包大小
     int iterations = 1;   // 迭代轮数，默认为1
+    int batch_size = 1;   // 每次sendmmsg()发送的包数，1表示逐包sendto()
+    const char *rate_str = "1000pps";  // 目标发送速率，0表示不限速
+    int burst_size = 0;   // 每个发送时刻的突发包数，0表示与batch_size相同
+    int inflight_window = DEFAULT_INFLIGHT_WINDOW;  // 在途包表容量（RTT匹配窗口）
+    int pkt_version = PERF_VERSION;   // 线上包格式版本
+    int clock_id = PERF_CLOCK_MONOTONIC_RAW;  // 线上时间戳时钟源
+    uint32_t flow_id = 0;
+    int ts_mode = TS_MODE_OFF;        // 内核/网卡时间戳模式
+    const char *ts_iface = NULL;
+    int io_backend = IO_BACKEND_SOCKET;  // 性能测试模式的I/O后端
+    int gso_segs = 0;     // UDP GSO每个超级缓冲区的段数，0表示不使用GSO
+    int zerocopy = 0;     // MSG_ZEROCOPY零拷贝发送
+    const char *xdp_iface = NULL;   // AF_XDP网卡，NULL表示按路由选择
+    int xdp_mode = XSK_MODE_SKB;
+    int xdp_queue = 0;
+    int num_flows = 1;    // 并行测试流数（每个流独立的socket、线程和序列号空间）
+    lowlat_t ll;          // 低延迟配置（--low-latency）
+    lowlat_defaults(&ll);
+    report_t report;      // 周期时间序列报告（--report，仅性能测试模式）
+    report_defaults(&report);
     stats_t stats = {0};
-    uint32_t seq_num = 0;
     
     // 解析命令行参数
+    enum { OPT_RATE = 256, OPT_BURST, OPT_WINDOW, OPT_LEGACY, OPT_CLOCK, OPT_FLOW_ID,
+           OPT_TIMESTAMPING, OPT_TS_IFACE, OPT_IO, OPT_GSO, OPT_ZEROCOPY, OPT_XDP_IFACE,
+           OPT_XDP_MODE, OPT_XDP_QUEUE, OPT_LOG_LEVEL, OPT_LOG_RATE, OPT_LOW_LATENCY, OPT_BUSY_POLL,
+           OPT_RT_PRIO, OPT_MLOCK, OPT_CPUS, OPT_RCVBUF, OPT_SNDBUF, OPT_RCVBUF_AUTO, OPT_REPORT,
+           OPT_REPORT_INTERVAL, OPT_REPORT_FILE };
+    static const struct option long_options[] = {
+        {"rate",   required_argument, NULL, OPT_RATE},
+        {"burst",  required_argument, NULL, OPT_BURST},
+        {"window", required_argument, NULL, OPT_WINDOW},
+        {"legacy", no_argument,       NULL, OPT_LEGACY},
+        {"clock",  required_argument, NULL, OPT_CLOCK},
+        {"flow-id", required_argument, NULL, OPT_FLOW_ID},
+        {"timestamping", optional_argument, NULL, OPT_TIMESTAMPING},
+        {"ts-iface", required_argument, NULL, OPT_TS_IFACE},
+        {"io", required_argument, NULL, OPT_IO},
+        {"gso", required_argument, NULL, OPT_GSO},
+        {"zerocopy", no_argument, NULL, OPT_ZEROCOPY},
+        {"xdp-iface", required_argument, NULL, OPT_XDP_IFACE},
+        {"xdp-mode", required_argument, NULL, OPT_XDP_MODE},
+        {"xdp-queue", required_argument, NULL, OPT_XDP_QUEUE},
+        {"log-level", required_argument, NULL, OPT_LOG_LEVEL},
+        {"log-rate", required_argument, NULL, OPT_LOG_RATE},
+        {"low-latency", optional_argument, NULL, OPT_LOW_LATENCY},
+        {"busy-poll", required_argument, NULL, OPT_BUSY_POLL},
+        {"rt-prio", required_argument, NULL, OPT_RT_PRIO},
+        {"mlock", no_argument, NULL, OPT_MLOCK},
+        {"cpus", required_argument, NULL, OPT_CPUS},
+        {"rcvbuf", required_argument, NULL, OPT_RCVBUF},
+        {"sndbuf", required_argument, NULL, OPT_SNDBUF},
+        {"rcvbuf-auto", no_argument, NULL, OPT_RCVBUF_AUTO},
+        {"report", required_argument, NULL, OPT_REPORT},
+        {"report-interval", required_argument, NULL, OPT_REPORT_INTERVAL},
+        {"report-file", required_argument, NULL, OPT_REPORT_FILE},
+        {NULL, 0, NULL, 0}
+    };
     int opt;
-    while ((opt = getopt(argc, argv, "hp:i:tn:s:r:")) != -1) {
+    while ((opt = getopt_long(argc, argv, "hp:i:tn:s:r:b:F:", long_options, NULL)) != -1) {
         switch (opt) {
             case 'h':
                 print_usage(argv[0]);
@@ -94,8 +1395,6 @@ int main(int argc, char *argv[]) {
                 packet_size = atoi(optarg);
                 if (packet_size < 0) {
                     packet_size = 0;  // 0表示使用最大UDP包大小
-                } else if (packet_size > (int)(MAX_BUFFER_SIZE - sizeof(perf_packet_t))) {
-                    packet_size = (int)(MAX_BUFFER_SIZE - sizeof(perf_packet_t));
                 }
                 break;
             case 'r':
@@ -104,6 +1403,166 @@ int main(int argc, char *argv[]) {
                     iterations = 1;
                 }
                 break;
+            case 'b':
+                batch_size = atoi(optarg);
+                if (batch_size < 1) {
+                    batch_size = 1;
+                } else if (batch_size > MAX_BATCH_SIZE) {
+                    batch_size = MAX_BATCH_SIZE;
+                }
+                break;
+            case 'F':
+                num_flows = atoi(optarg);
+                if (num_flows < 1) {
+                    num_flows = 1;
+                } else if (num_flows > MAX_CLIENT_FLOWS) {
+                    num_flows = MAX_CLIENT_FLOWS;
+                }
+                break;
+            case OPT_RATE:
+                rate_str = optarg;
+                break;
+            case OPT_BURST:
+                burst_size = atoi(optarg);
+                if (burst_size < 0) {
+                    burst_size = 0;
+                }
+                break;
+            case OPT_WINDOW:
+                inflight_window = atoi(optarg);
+                if (inflight_window < 1) {
+                    inflight_window = DEFAULT_INFLIGHT_WINDOW;
+                }
+                break;
+            case OPT_LEGACY:
+                pkt_version = PERF_VERSION_LEGACY;
+                break;
+            case OPT_CLOCK:
+                if (strcmp(optarg, "mono") == 0) {
+                    clock_id = PERF_CLOCK_MONOTONIC_RAW;
+                } else if (strcmp(optarg, "tai") == 0) {
+                    clock_id = PERF_CLOCK_TAI;
+                } else {
+                    fprintf(stderr, "Error: Unknown clock '%s' (use mono or tai)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_FLOW_ID:
+                flow_id = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case OPT_TIMESTAMPING:
+                if (!optarg || strcmp(optarg, "sw") == 0) {
+                    ts_mode = TS_MODE_SOFTWARE;
+                } else if (strcmp(optarg, "hw") == 0) {
+                    ts_mode = TS_MODE_HARDWARE;
+                } else {
+                    fprintf(stderr, "Error: Unknown timestamping mode '%s' (use sw or hw)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_TS_IFACE:
+                ts_iface = optarg;
+                break;
+            case OPT_ZEROCOPY:
+                zerocopy = 1;
+                break;
+            case OPT_GSO:
+                gso_segs = atoi(optarg);
+                if (gso_segs < 0) {
+                    gso_segs = 0;
+                }
+                break;
+            case OPT_IO:
+                if (parse_io_backend(optarg, &io_backend) < 0) {
+                    fprintf(stderr, "Error: Unknown I/O backend '%s' (use socket, uring or xdp)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_XDP_IFACE:
+                xdp_iface = optarg;
+                break;
+            case OPT_XDP_MODE:
+                if (parse_xsk_mode(optarg, &xdp_mode) < 0) {
+                    fprintf(stderr, "Error: Unknown XDP mode '%s' (use skb or native)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_XDP_QUEUE:
+                xdp_queue = atoi(optarg);
+                if (xdp_queue < 0) {
+                    xdp_queue = 0;
+                }
+                break;
+            case OPT_LOG_LEVEL:
+                if (parse_log_level(optarg, &log_level) < 0) {
+                    fprintf(stderr, "Error: Unknown log level '%s' (use error, warn, info or debug)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_LOG_RATE:
+                log_rate = (uint32_t)(atoi(optarg) > 0 ? atoi(optarg) : 0);
+                break;
+            case OPT_LOW_LATENCY:
+                ll.enabled = 1;
+                if (optarg && strcmp(optarg, "compare") == 0) {
+                    ll.compare = 1;
+                } else if (optarg) {
+                    fprintf(stderr, "Error: Unknown low-latency option '%s' (use --low-latency or --low-latency=compare)\n",
+                            optarg);
+                    return 1;
+                }
+                break;
+            case OPT_BUSY_POLL:
+                ll.enabled = 1;
+                ll.busy_poll_us = atoi(optarg) > 0 ? atoi(optarg) : 0;
+                break;
+            case OPT_RT_PRIO:
+                ll.enabled = 1;
+                ll.rt_prio = atoi(optarg);
+                if (ll.rt_prio < 1 || ll.rt_prio > 99) {
+                    fprintf(stderr, "Error: --rt-prio must be between 1 and 99\n");
+                    return 1;
+                }
+                break;
+            case OPT_MLOCK:
+                ll.enabled = 1;
+                ll.mlock = 1;
+                break;
+            case OPT_CPUS:
+                ll.enabled = 1;
+                ll.num_cpus = lowlat_parse_cpus(optarg, ll.cpus, LOWLAT_MAX_CPUS);
+                if (ll.num_cpus <= 0) {
+                    fprintf(stderr, "Error: Invalid CPU list '%s' (example: 2-3,6)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_RCVBUF:
+            case OPT_SNDBUF:
+                if (sockbuf_parse_size(optarg, opt == OPT_RCVBUF ? &sockbuf_rcvbuf : &sockbuf_sndbuf) < 0) {
+                    fprintf(stderr, "Error: Invalid buffer size '%s' (bytes, k/m suffix, up to %d MB)\n",
+                            optarg, SOCKBUF_AUTO_MAX / (1024 * 1024));
+                    return 1;
+                }
+                break;
+            case OPT_RCVBUF_AUTO:
+                sockbuf_auto = 1;
+                break;
+            case OPT_REPORT:
+                if (report_parse_format(optarg, &report.format) < 0) {
+                    fprintf(stderr, "Error: Invalid report format '%s' (use json or csv)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_REPORT_INTERVAL:
+                report.interval_ms = atoi(optarg);
+                if (report.interval_ms < REPORT_MIN_INTERVAL_MS) {
+                    fprintf(stderr, "Error: --report-interval must be at least %d ms\n", REPORT_MIN_INTERVAL_MS);
+                    return 1;
+                }
+                break;
+            case OPT_REPORT_FILE:
+                report.path = optarg;
+                break;
             default:
                 print_usage(argv[0]);
                 return 1;
@@ -117,33 +1576,22 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
+    // 报告写到标准输出时在任何输出之前打开，使其余输出全部改到标准错误
+    if (perf_test_mode && report_open(&report, "client") < 0) {
+        return 1;
+    }
+    
     // 注册信号处理
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
-    // 创建socket
-    sockfd = create_udp_socket();
+    // 创建socket并绑定到任意本地端口
+    uint16_t local_port;
+    sockfd = open_client_socket(&local_port);
     if (sockfd < 0) {
         return 1;
     }
-    
-    // 绑定到任意本地端口（让系统自动分配）
-    struct sockaddr_in local_addr;
-    memset(&local_addr, 0, sizeof(local_addr));
-    local_addr.sin_family = AF_INET;
-    local_addr.sin_addr.s_addr = INADDR_ANY;
-    local_addr.sin_port = 0;  // 0表示让系统自动分配端口
-    if (bind(sockfd, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0) {
-        perror("bind failed");
-        close(sockfd);
-        return 1;
-    }
-    
-    // 获取绑定的本地端口
-    socklen_t len = sizeof(local_addr);
-    if (getsockname(sockfd, (struct sockaddr *)&local_addr, &len) == 0) {
-        printf("Client bound to local port: %d\n", ntohs(local_addr.sin_port));
-    }
+    printf("Client bound to local port: %d\n", local_port);
     
     // 设置服务器地址
     memset(&server_addr, 0, sizeof(server_addr));
@@ -159,15 +1607,203 @@ int main(int argc, char *argv[]) {
     if (perf_test_mode) {
         // 性能测试模式：发送数据包到TC3
         // 如果packet_size为0或未指定，使用最大UDP包大小
-        if (packet_size <= 0) {
-            packet_size = MAX_BUFFER_SIZE - sizeof(perf_packet_t);
+        // v1旧格式只支持墙上时间戳
+        if (pkt_version == PERF_VERSION_LEGACY) {
+            clock_id = PERF_CLOCK_REALTIME;
+        }
+        // 自旋接收只实现在socket接收循环中（AF_XDP后端的回送同样由socket接收）
+        if (ll.enabled && io_backend == IO_BACKEND_URING) {
+            fprintf(stderr, "Error: --low-latency cannot be combined with --io uring\n");
+            close(sockfd);
+            return 1;
+        }
+        if (ll.enabled) {
+            lowlat_select_cpus(&ll);
+        }
+        // 对比模式两种模式逐轮交替（默认模式在前），轮数取偶数使两种模式轮数相同
+        if (ll.compare && iterations % 2 != 0) {
+            iterations++;
+        }
+        int max_payload = MAX_BUFFER_SIZE - (int)perf_header_size(pkt_version);
+        
+        // 多流模式：流0使用主socket，其余流各自打开socket（不同源端口，对端按四元组分到不同接收队列）
+        if (test_packet_count > 0 && num_flows > test_packet_count) {
+            num_flows = test_packet_count;
+        }
+        perf_flow_t *flows = NULL;
+        if (posix_memalign((void **)&flows, CACHE_LINE_SIZE, sizeof(perf_flow_t) * num_flows) != 0) {
+            fprintf(stderr, "Error: Failed to allocate flow contexts\n");
+            close(sockfd);
+            return 1;
+        }
+        memset(flows, 0, sizeof(perf_flow_t) * num_flows);
+        for (int f = 0; f < num_flows; f++) {
+            flows[f].sockfd = -1;
+        }
+        flows[0].sockfd = sockfd;
+        flows[0].local_port = local_port;
+        for (int f = 1; f < num_flows; f++) {
+            flows[f].sockfd = open_client_socket(&flows[f].local_port);
+            if (flows[f].sockfd < 0) {
+                perf_flows_destroy(flows, num_flows);
+                close(sockfd);
+                return 1;
+            }
         }
         
+        // AF_XDP：解析发送路径并为每个流打开只发送的AF_XDP socket（不经过协议栈，不能分片）
+        // 未共享UMEM的AF_XDP socket不能绑定同一队列，第i个流绑定队列xdp_queue + i
+        if (io_backend == IO_BACKEND_XDP) {
+            if (gso_segs > 0 || zerocopy || ts_mode != TS_MODE_OFF) {
+                fprintf(stderr, "Error: --io xdp cannot be combined with --gso, --zerocopy or --timestamping\n");
+                perf_flows_destroy(flows, num_flows);
+                close(sockfd);
+                return 1;
+            }
+            int ifindex, mtu = 0;
+            int ok = 1;
+            for (int f = 0; f < num_flows && ok; f++) {
+                perf_flow_t *flow = &flows[f];
+                flow->xsk = calloc(1, sizeof(xsk_t));
+                if (!flow->xsk ||
+                    xdp_resolve_path(xdp_iface, &server_addr, htons(flow->local_port), &flow->xdp_path,
+                                     &ifindex, &mtu) < 0 ||
+                    xsk_open(flow->xsk, ifindex, xdp_queue + f, xdp_mode, 0) < 0) {
+                    free(flow->xsk);
+                    flow->xsk = NULL;
+                    ok = 0;
+                }
+            }
+            if (!ok) {
+                fprintf(stderr, "Warning: AF_XDP unavailable, falling back to socket I/O\n");
+                for (int f = 0; f < num_flows; f++) {
+                    if (flows[f].xsk) {
+                        xsk_close(flows[f].xsk);
+                        free(flows[f].xsk);
+                        flows[f].xsk = NULL;
+                    }
+                }
+                io_backend = IO_BACKEND_SOCKET;
+            } else {
+                // 每个包必须装进一个以太网帧（MTU）和一个UMEM帧
+                int frame_payload = mtu - (UDP_FRAME_HDR_LEN - ETH_HLEN);
+                if (frame_payload > XSK_FRAME_SIZE - UDP_FRAME_HDR_LEN) {
+                    frame_payload = XSK_FRAME_SIZE - UDP_FRAME_HDR_LEN;
+                }
+                max_payload = frame_payload - (int)perf_header_size(pkt_version);
+                if (packet_size > max_payload) {
+                    printf("[INFO] Packet size limited to %d bytes by MTU %d for AF_XDP\n", max_payload, mtu);
+                }
+            }
+        }
+        if (packet_size <= 0 || packet_size > max_payload) {
+            packet_size = max_payload;
+        }
+        
+        // 解析目标速率（比特速率按UDP负载大小换算为包速率）
+        double rate_pps = 0.0;
+        if (parse_rate(rate_str, perf_header_size(pkt_version) + packet_size, &rate_pps) < 0) {
+            fprintf(stderr, "Error: Invalid rate '%s' (examples: 20000, 50kpps, 500Mbps, 0 = unlimited)\n",
+                    rate_str);
+            perf_flows_destroy(flows, num_flows);
+            close(sockfd);
+            return 1;
+        }
+        // GSO在每批发送的包内组装超级缓冲区，批大小至少为段数
+        if (gso_segs > batch_size) {
+            batch_size = gso_segs > MAX_BATCH_SIZE ? MAX_BATCH_SIZE : gso_segs;
+        }
+        if (burst_size <= 0) {
+            burst_size = batch_size;
+        }
+        
+        // 周期计数器时钟：启动时标定，之后收发时间戳不再调用clock_gettime()
+        tsc_init();
+        
         printf("UDP Client sending to %s:%d\n", server_ip, port);
         printf("Performance test mode: Send and receive echo for RTT measurement\n");
         printf("Packet count per iteration: %d\n", test_packet_count);
         printf("Packet size: %d bytes\n", packet_size);
+        if (pkt_version == PERF_VERSION_LEGACY) {
+            printf("Packet format: v1 (legacy, wall-clock microsecond timestamps)\n");
+        } else if (num_flows > 1) {
+            printf("Packet format: v2 (flow ids %u-%u, %s nanosecond timestamps)\n", flow_id,
+                   flow_id + num_flows - 1, clock_id == PERF_CLOCK_TAI ? "CLOCK_TAI" : "CLOCK_MONOTONIC_RAW");
+        } else {
+            printf("Packet format: v2 (flow id %u, %s nanosecond timestamps)\n", flow_id,
+                   clock_id == PERF_CLOCK_TAI ? "CLOCK_TAI" : "CLOCK_MONOTONIC_RAW");
+        }
+        tsc_print_info();
         printf("Number of iterations: %d\n", iterations);
+        // io_uring不可用（内核过旧或被禁用）时退回socket路径
+        if (io_backend == IO_BACKEND_URING && uring_probe() < 0) {
+            fprintf(stderr, "Warning: io_uring unavailable (%s), falling back to socket I/O\n", strerror(errno));
+            io_backend = IO_BACKEND_SOCKET;
+        }
+        if (io_backend == IO_BACKEND_XDP) {
+            char ifname[IF_NAMESIZE];
+            printf("I/O backend: AF_XDP send on %s queue %d%s (%s mode, %s), echoes received on the UDP socket\n",
+                   if_indextoname(flows[0].xsk->ifindex, ifname), xdp_queue, num_flows > 1 ? "+" : "",
+                   xdp_mode == XSK_MODE_NATIVE ? "native" : "skb", flows[0].xsk->zerocopy ? "zero-copy" : "copy");
+        } else if (io_backend == IO_BACKEND_URING) {
+            printf("I/O backend: io_uring (up to %d SENDMSG per submission, multishot recvmsg)\n", batch_size);
+        } else if (batch_size > 1) {
+            printf("Batched send: %d packets per sendmmsg()\n", batch_size);
+        }
+        if (rate_pps > 0) {
+            printf("Target rate: %.0f pps, burst: %d packets\n", rate_pps, burst_size);
+        } else {
+            printf("Target rate: unlimited\n");
+        }
+        
+        // 多流模式：包数和目标速率平均分给各流；发送线程和接收线程分别绑定到不同的核
+        long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (num_cpus < 1) {
+            num_cpus = 1;
+        }
+        if (num_flows > 1) {
+            printf("Parallel flows: %d (%.0f pps each), source ports:", num_flows, rate_pps / num_flows);
+            for (int f = 0; f < num_flows; f++) {
+                printf(" %u", flows[f].local_port);
+            }
+            printf("\n");
+        }
+        
+        // 零拷贝完成通知与发送时间戳共用错误队列，分别由发送线程和接收线程读取，不能同时启用
+        if (zerocopy && ts_mode != TS_MODE_OFF) {
+            fprintf(stderr, "Error: --zerocopy cannot be combined with --timestamping\n");
+            perf_flows_destroy(flows, num_flows);
+            close(sockfd);
+            return 1;
+        }
+        if (zerocopy) {
+            for (int f = 0; f < num_flows; f++) {
+                if (zc_enable(flows[f].sockfd) < 0) {
+                    perror("Warning: setsockopt SO_ZEROCOPY failed, using copying sends");
+                    zerocopy = 0;
+                    break;
+                }
+            }
+            if (zerocopy) {
+                printf("Zero-copy send: MSG_ZEROCOPY with a %d x %d packet buffer pool%s\n",
+                       ZC_POOL_BATCHES, batch_size, num_flows > 1 ? " per flow" : "");
+            }
+        }
+        
+        // 启用内核/网卡收发时间戳（发送时间戳经错误队列返回）
+        if (ts_mode != TS_MODE_OFF) {
+            int mode = ts_mode;
+            for (int f = 0; f < num_flows && mode >= 0; f++) {
+                mode = ts_enable(flows[f].sockfd, ts_mode, ts_iface, 1);
+            }
+            if (mode < 0) {
+                perf_flows_destroy(flows, num_flows);
+                close(sockfd);
+                return 1;
+            }
+            ts_mode = mode;
+            printf("Kernel timestamping: %s\n", ts_mode == TS_MODE_HARDWARE ? "hardware" : "software");
+        }
         printf("\n[INFO] Waiting for echo responses from TC3...\n");
         printf("[INFO] If no responses received, TC3 may not be configured for echo mode\n");
         printf("Press Ctrl+C to stop\n\n");
@@ -186,251 +1822,226 @@ int main(int argc, char *argv[]) {
             !multi_stats.packet_loss_rates || !multi_stats.durations ||
             !multi_stats.packets_sent_total || !multi_stats.packets_received_total) {
             fprintf(stderr, "Error: Memory allocation failed\n");
+            free_multi_iteration_stats(&multi_stats);
+            perf_flows_destroy(flows, num_flows);
             close(sockfd);
             return 1;
         }
         
+        // 初始化测试流：预构造发送环（批量发送）并分配接收缓冲区
+        for (int f = 0; f < num_flows; f++) {
+            perf_flow_t *flow = &flows[f];
+            flow->server_addr = server_addr;
+            flow->packet_count = test_packet_count / num_flows + (f < test_packet_count % num_flows ? 1 : 0);
+            flow->batch_size = batch_size;
+            flow->burst_size = burst_size;
+            flow->flow_id = flow_id + f;
+            flow->io_backend = io_backend;
+            flow->verbose = (num_flows == 1);
+            perf_flow_set_mode(flow, f, num_flows, num_cpus, &ll, ll.enabled);
+            pacer_init(&flow->pacer, rate_pps / num_flows, burst_size);
+            if (perf_flow_alloc(flow, packet_size, pkt_version, clock_id, inflight_window, zerocopy,
+                                ts_mode != TS_MODE_OFF) < 0) {
+                fprintf(stderr, "Error: Memory allocation failed\n");
+                free_multi_iteration_stats(&multi_stats);
+                perf_flows_destroy(flows, num_flows);
+                close(sockfd);
+                return 1;
+            }
+            
+            // 把帧头和负载一次性写入所有UMEM发送帧，发送时只需改写性能测试包头
+            if (flow->xsk) {
+                xsk_tx_prepare(flow->xsk, &flow->xdp_path, flow->ring.packets, flow->ring.pkt_size);
+            }
+        }
+        
+        // 低延迟模式：先锁定内存，再让收发缓冲区提前完成缺页
+        if (ll.enabled) {
+            if (ll.mlock) {
+                lowlat_lock_memory();
+            }
+            for (int f = 0; f < num_flows; f++) {
+                perf_flow_prefault(&flows[f]);
+            }
+            lowlat_print_info(&ll, 2 * num_flows);
+            if (ll.compare) {
+                printf("Mode comparison: %d iterations alternating default and low-latency mode\n", iterations);
+            }
+        }
+        sockbuf_print_info(flows[0].sockfd);
+        report_print_info(&report);
+        if (gso_segs > 0) {
+            int segs = 0;
+            for (int f = 0; f < num_flows; f++) {
+                segs = send_ring_enable_gso(&flows[f].ring, gso_segs);
+            }
+            if (segs > 0) {
+                printf("UDP GSO: up to %d segments of %d bytes per send\n", segs, flows[0].ring.pkt_size);
+            } else {
+                printf("[WARNING] Packet size too large for UDP GSO, using plain send path\n");
+            }
+        }
+        
+        // 收发线程的逐包日志经后台线程异步写出
+        log_init();
+        
+        // 对比模式下按模式分别累计的RTT分布（0为默认模式，1为低延迟模式）
+        latency_hist_t mode_hists[2];
+        int mode_rounds[2] = { 0, 0 };
+        memset(mode_hists, 0, sizeof(mode_hists));
+        
+        client_report_arg_t report_arg = { .flows = flows, .num_flows = num_flows };
+        
         // 执行多轮测试
         for (int iter = 0; iter < iterations && running; iter++) {
-            printf("\n========== 第 %d/%d 轮测试 ==========\n", iter + 1, iterations);
+            int low = ll.enabled && (!ll.compare || iter % 2 == 1);
+            if (ll.compare) {
+                printf("\n========== 第 %d/%d 轮测试（%s） ==========\n", iter + 1, iterations,
+                       low ? "低延迟模式" : "默认模式");
+                for (int f = 0; f < num_flows; f++) {
+                    perf_flow_set_mode(&flows[f], f, num_flows, num_cpus, &ll, low);
+                }
+            } else {
+                printf("\n========== 第 %d/%d 轮测试 ==========\n", iter + 1, iterations);
+            }
             
             // 重置统计信息
             memset(&stats, 0, sizeof(stats));
-            seq_num = 0;
-            clear_send_time_map();
+            zc_stats_t zc_round_start = {0};
+            for (int f = 0; f < num_flows; f++) {
+                perf_flow_reset(&flows[f]);
+                zc_round_start.calls += flows[f].zc.calls;
+                zc_round_start.completed += flows[f].zc.completed;
+                zc_round_start.copied += flows[f].zc.copied;
+            }
             gettimeofday(&stats.start_time, NULL);
+            report_start(&report, client_report_sample, &report_arg, iter + 1);
             
-            uint32_t packets_sent_this_round = 0;
-            uint32_t expected_seq = 0;
-            
-            // 发送所有数据包
-            for (int i = 0; i < test_packet_count && running; i++) {
-                // 准备测试数据包
-                int pkt_size = sizeof(perf_packet_t) + packet_size;
-                perf_packet_t *pkt = (perf_packet_t *)buffer;
-                
-                pkt->seq_num = seq_num;
-                struct timeval tv;
-                gettimeofday(&tv, NULL);
-                pkt->timestamp_sec = tv.tv_sec;
-                pkt->timestamp_usec = tv.tv_usec;
-                pkt->data_len = packet_size;
-                
-                // 记录发送时间
-                add_send_time(seq_num, &tv);
-                
-                // 填充测试数据
-                for (int j = 0; j < packet_size; j++) {
-                    pkt->data[j] = (char)(j % 256);
-                }
-                
-                // 发送数据包
-                ssize_t send_len = sendto(sockfd, buffer, pkt_size, 0,
-                                         (struct sockaddr *)&server_addr, sizeof(server_addr));
-                
-                if (send_len < 0) {
-                    perror("sendto failed");
-                    continue;
-                }
-                
-                stats.packets_sent++;
-                stats.bytes_sent += send_len;
-                packets_sent_this_round++;
-                seq_num++;
-                
-                // 尝试接收响应（非阻塞）
-                fd_set read_fds;
-                struct timeval timeout;
-                FD_ZERO(&read_fds);
-                FD_SET(sockfd, &read_fds);
-                timeout.tv_sec = 0;
-                timeout.tv_usec = 10000;  // 10ms超时
-                
-                int select_result = select(sockfd + 1, &read_fds, NULL, NULL, &timeout);
-                
-                // 调试信息：前几个包显示select结果
-                if (i < 5 && select_result == 0) {
-                    printf("[DEBUG] No data available for packet #%u (select timeout)\n", seq_num - 1);
-                }
-                
-                while (select_result > 0) {
-                    struct sockaddr_in recv_addr;
-                    socklen_t recv_addr_len = sizeof(recv_addr);
-                    ssize_t recv_len = recvfrom(sockfd, buffer, MAX_BUFFER_SIZE, 0,
-                                               (struct sockaddr *)&recv_addr, &recv_addr_len);
-                    
-                    if (recv_len < 0) {
-                        if (errno != EINTR) {
-                            perror("recvfrom failed");
-                        }
-                        break;
+            // 启动接收线程和发送线程：发送不被回送处理阻塞，接收也不受发送影响
+            int rx_started = 0, tx_started = 0;
+            for (; rx_started < num_flows; rx_started++) {
+                if (pthread_create(&flows[rx_started].rx_thread, NULL, rx_thread_main, &flows[rx_started]) != 0) {
+                    fprintf(stderr, "Error: Failed to create receive thread\n");
+                    break;
+                }
+            }
+            for (; rx_started == num_flows && tx_started < num_flows; tx_started++) {
+                if (pthread_create(&flows[tx_started].tx_thread, NULL, tx_thread_main, &flows[tx_started]) != 0) {
+                    fprintf(stderr, "Error: Failed to create send thread\n");
+                    break;
+                }
+            }
+            if (tx_started < num_flows) {
+                // 已启动的发送线程随running清零退出
+                running = 0;
+                for (int f = 0; f < tx_started; f++) {
+                    pthread_join(flows[f].tx_thread, NULL);
+                }
+                for (int f = 0; f < rx_started; f++) {
+                    flows[f].rx_stop = 1;
+                    pthread_join(flows[f].rx_thread, NULL);
+                }
+                report_stop(&report);
+                break;
+            }
+            
+            // 多流模式：等待所有发送线程完成，期间周期打印汇总进度
+            if (num_flows > 1) {
+                double last_progress = get_time_ms();
+                for (;;) {
+                    int done = 1;
+                    uint64_t sent = 0, received = 0;
+                    for (int f = 0; f < num_flows; f++) {
+                        done &= flows[f].tx_done;
+                        sent += __atomic_load_n(&flows[f].tx_stats.packets_sent, __ATOMIC_RELAXED);
+                        received += __atomic_load_n(&flows[f].rx_stats.packets_received, __ATOMIC_RELAXED);
                     }
-                    
-                    // 获取接收方的IP地址字符串
-                    char recv_ip_str[INET_ADDRSTRLEN];
-                    inet_ntop(AF_INET, &recv_addr.sin_addr, recv_ip_str, INET_ADDRSTRLEN);
-                    char server_ip_str[INET_ADDRSTRLEN];
-                    inet_ntop(AF_INET, &server_addr.sin_addr, server_ip_str, INET_ADDRSTRLEN);
-                    
-                    // 显示所有接收到的数据包（调试用）
-                    printf("[DEBUG] Received UDP packet: size=%zd bytes, from %s:%d (expected from %s)\n",
-                           recv_len, recv_ip_str, ntohs(recv_addr.sin_port), server_ip_str);
-                    
-                    // 验证是否来自目标服务器（只检查IP地址，不检查端口）
-                    // 因为TC3可能从不同端口回送数据
-                    if (recv_addr.sin_addr.s_addr == server_addr.sin_addr.s_addr) {
-                        if (recv_len >= (ssize_t)sizeof(perf_packet_t)) {
-                            perf_packet_t *recv_pkt = (perf_packet_t *)buffer;
-                            
-                            // 计算RTT
-                            struct timeval recv_time, send_time;
-                            gettimeofday(&recv_time, NULL);
-                            
-                            if (find_and_remove_send_time(recv_pkt->seq_num, &send_time)) {
-                                struct timeval rtt;
-                                timersub(&recv_time, &send_time, &rtt);
-                                double rtt_ms = rtt.tv_sec * 1000.0 + rtt.tv_usec / 1000.0;
-                                
-                                if (rtt_ms > 0) {
-                                    if (stats.min_latency_ms == 0 || rtt_ms < stats.min_latency_ms) {
-                                        stats.min_latency_ms = rtt_ms;
-                                    }
-                                    if (rtt_ms > stats.max_latency_ms) {
-                                        stats.max_latency_ms = rtt_ms;
-                                    }
-                                    stats.total_latency_ms += rtt_ms;
-                                    stats.packets_received++;
-                                    stats.bytes_received += recv_len;
-                                    
-                                    // 检测丢包
-                                    if (recv_pkt->seq_num == expected_seq) {
-                                        expected_seq++;
-                                    } else if (recv_pkt->seq_num > expected_seq) {
-                                        stats.packets_lost += (recv_pkt->seq_num - expected_seq);
-                                        expected_seq = recv_pkt->seq_num + 1;
-                                    }
-                                    
-                                    // 每100个包显示一次接收信息
-                                    if (stats.packets_received % 100 == 0) {
-                                        printf("[RECV] Packet #%u from %s:%d, RTT=%.4f ms\n",
-                                               recv_pkt->seq_num, recv_ip_str, ntohs(recv_addr.sin_port), rtt_ms);
-                                    }
-                                }
-                            } else {
-                                // 接收到未知序列号的包
-                                printf("[DEBUG] Received packet with unknown seq_num=%u from %s:%d (size=%zd)\n",
-                                       recv_pkt->seq_num, recv_ip_str, ntohs(recv_addr.sin_port), recv_len);
-                                printf("[DEBUG] This packet may be from a previous test or invalid\n");
-                            }
-                        } else {
-                            // 接收到非性能测试包
-                            printf("[DEBUG] Received non-perf packet from %s:%d (size=%zd, expected>=%zu)\n",
-                                   recv_ip_str, ntohs(recv_addr.sin_port), recv_len, sizeof(perf_packet_t));
-                            printf("[DEBUG] Packet size too small, may not be a perf_packet_t structure\n");
-                        }
-                    } else {
-                        // 接收到来自非目标IP的包（可能是其他来源）
-                        printf("[DEBUG] Received packet from unexpected source %s:%d (expected %s)\n",
-                               recv_ip_str, ntohs(recv_addr.sin_port), server_ip_str);
-                        printf("[DEBUG] This packet is being ignored (IP address mismatch)\n");
+                    double now = get_time_ms();
+                    if (done || now - last_progress >= FLOW_PROGRESS_INTERVAL_MS) {
+                        printf("Progress: %lu/%d sent, %lu received (%.1f%%), %d flows\n",
+                               sent, test_packet_count, received,
+                               test_packet_count > 0 ? sent * 100.0 / test_packet_count : 0.0, num_flows);
+                        last_progress = now;
                     }
-                    
-                    // 继续检查是否还有数据
-                    FD_ZERO(&read_fds);
-                    FD_SET(sockfd, &read_fds);
-                    timeout.tv_sec = 0;
-                    timeout.tv_usec = 0;
-                    select_result = select(sockfd + 1, &read_fds, NULL, NULL, &timeout);
-                }
-                
-                // 显示进度（每100个包显示一次）
-                if ((i + 1) % 100 == 0 || i == test_packet_count - 1) {
-                    printf("Progress: %d/%d sent, %lu received (%.1f%%)\n",
-                           i + 1, test_packet_count, stats.packets_received,
-                           (i + 1) * 100.0 / test_packet_count);
-                }
-                
-                // 控制发送速率（可选，避免过快发送）
-                usleep(1000);  // 1ms延迟
-            }
-            
-            // 发送完成后，等待一段时间接收剩余的响应
-            printf("\n[INFO] Sending complete. Waiting 2 seconds for remaining responses...\n");
-            struct timeval wait_start;
-            gettimeofday(&wait_start, NULL);
-            double wait_duration = 2.0;  // 等待2秒接收剩余响应
-            
-            while (running) {
-                struct timeval now;
-                gettimeofday(&now, NULL);
-                double elapsed = (now.tv_sec - wait_start.tv_sec) + 
-                                (now.tv_usec - wait_start.tv_usec) / 1000000.0;
-                if (elapsed >= wait_duration) {
+                    if (done) {
+                        break;
+                    }
+                    usleep(10000);
+                }
+            }
+            for (int f = 0; f < num_flows; f++) {
+                pthread_join(flows[f].tx_thread, NULL);
+            }
+            log_flush();
+            
+            // 发送完成后，等待一段时间接收剩余的响应（全部收到则提前结束）
+            printf("\n[INFO] Sending complete. Waiting up to 2 seconds for remaining responses...\n");
+            double wait_start = get_time_ms();
+            double wait_duration_ms = 2000.0;  // 最多等待2秒接收剩余响应
+            while (running && get_time_ms() - wait_start < wait_duration_ms) {
+                uint64_t pending = 0;
+                for (int f = 0; f < num_flows; f++) {
+                    pending += inflight_pending(&flows[f].inflight);
+                }
+                if (pending == 0) {
                     break;
                 }
-                
-                fd_set read_fds;
-                struct timeval timeout;
-                FD_ZERO(&read_fds);
-                FD_SET(sockfd, &read_fds);
-                double remaining = wait_duration - elapsed;
-                timeout.tv_sec = (long)remaining;
-                timeout.tv_usec = (long)((remaining - timeout.tv_sec) * 1000000);
-                
-                if (select(sockfd + 1, &read_fds, NULL, NULL, &timeout) > 0) {
-                    struct sockaddr_in recv_addr;
-                    socklen_t recv_addr_len = sizeof(recv_addr);
-                    ssize_t recv_len = recvfrom(sockfd, buffer, MAX_BUFFER_SIZE, 0,
-                                               (struct sockaddr *)&recv_addr, &recv_addr_len);
-                    
-                    if (recv_len < 0) {
-                        if (errno != EINTR) {
-                            perror("recvfrom failed");
-                        }
-                        continue;
-                    }
-                    
-                    // 只检查IP地址，不检查端口
-                    if (recv_addr.sin_addr.s_addr == server_addr.sin_addr.s_addr) {
-                        if (recv_len >= (ssize_t)sizeof(perf_packet_t)) {
-                            perf_packet_t *recv_pkt = (perf_packet_t *)buffer;
-                            
-                            struct timeval recv_time, send_time;
-                            gettimeofday(&recv_time, NULL);
-                            
-                            if (find_and_remove_send_time(recv_pkt->seq_num, &send_time)) {
-                                struct timeval rtt;
-                                timersub(&recv_time, &send_time, &rtt);
-                                double rtt_ms = rtt.tv_sec * 1000.0 + rtt.tv_usec / 1000.0;
-                                
-                                if (rtt_ms > 0) {
-                                    if (stats.min_latency_ms == 0 || rtt_ms < stats.min_latency_ms) {
-                                        stats.min_latency_ms = rtt_ms;
-                                    }
-                                    if (rtt_ms > stats.max_latency_ms) {
-                                        stats.max_latency_ms = rtt_ms;
-                                    }
-                                    stats.total_latency_ms += rtt_ms;
-                                    stats.packets_received++;
-                                    stats.bytes_received += recv_len;
-                                    
-                                    if (recv_pkt->seq_num == expected_seq) {
-                                        expected_seq++;
-                                    } else if (recv_pkt->seq_num > expected_seq) {
-                                        stats.packets_lost += (recv_pkt->seq_num - expected_seq);
-                                        expected_seq = recv_pkt->seq_num + 1;
-                                    }
-                                }
-                            }
-                        }
+                usleep(1000);
+            }
+            for (int f = 0; f < num_flows; f++) {
+                flows[f].rx_stop = 1;
+                pthread_join(flows[f].rx_thread, NULL);
+            }
+            report_stop(&report);
+            
+            // 合并各流发送线程和接收线程的统计信息
+            uint64_t pending = 0, expired = 0, late = 0, duplicates = 0, unknown = 0, zc_timeouts = 0;
+            uint64_t socket_drops = 0;
+            seq_stats_t echo_seq;
+            memset(&echo_seq, 0, sizeof(echo_seq));
+            pacer_t pacer = flows[0].pacer;
+            zc_stats_t zc_round = {0};
+            for (int f = 0; f < num_flows; f++) {
+                perf_flow_t *flow = &flows[f];
+                merge_stats(&stats, &flow->tx_stats);
+                merge_stats(&stats, &flow->rx_stats);
+                pending += inflight_pending(&flow->inflight);
+                expired += atomic_load(&flow->inflight.expired);
+                late += flow->inflight.late;
+                duplicates += flow->inflight.duplicates;
+                unknown += flow->inflight.unknown;
+                sockbuf_read(flow->sockfd, &flow->sockbuf);
+                socket_drops += flow->sockbuf.drops - flow->round_drops_base;
+                seq_stats_merge(&echo_seq, &flow->echo_seq.stats);
+                if (f > 0) {
+                    pacer_merge(&pacer, &flow->pacer);
+                    if (flow->ts_breakdown) {
+                        ts_breakdown_merge(flows[0].ts_breakdown, flow->ts_breakdown);
                     }
                 }
+                zc_round.calls += flow->zc.calls;
+                zc_round.completed += flow->zc.completed;
+                zc_round.copied += flow->zc.copied;
+                zc_timeouts += flow->zc_timeouts;
+            }
+            zc_round.calls -= zc_round_start.calls;
+            zc_round.completed -= zc_round_start.completed;
+            zc_round.copied -= zc_round_start.copied;
+            hist_merge(&multi_stats.latency_hist, &stats.latency_hist);
+            if (ll.compare) {
+                hist_merge(&mode_hists[low], &stats.latency_hist);
+                mode_rounds[low]++;
             }
             
-            // 计算剩余未响应的包
-            if (send_time_map_size > 0) {
-                stats.packets_lost += send_time_map_size;
-                printf("[INFO] After waiting, %u packets still pending (no response received)\n", send_time_map_size);
+            // 丢包数 = 窗口内仍未响应的包 + 未响应即被新包覆盖的包（迟到响应不计为收到）
+            if (pending > 0) {
+                stats.packets_lost += pending;
+                printf("[INFO] After waiting, %lu packets still pending (no response received)\n", pending);
+            }
+            if (expired > 0) {
+                stats.packets_lost += expired;
+                printf("[INFO] %lu packets expired from the %u-packet in-flight window before any response\n",
+                       expired, flows[0].inflight.capacity);
             }
             
             if (stats.packets_received == 0) {
@@ -443,8 +2054,8 @@ int main(int argc, char *argv[]) {
             }
             
             // 计算平均延迟
-            if (stats.packets_received > 0) {
-                stats.avg_latency_ms = stats.total_latency_ms / stats.packets_received;
+            if (stats.latency_hist.total_count > 0) {
+                stats.avg_latency_ms = stats.total_latency_ms / stats.latency_hist.total_count;
             }
             
             gettimeofday(&stats.end_time, NULL);
@@ -472,20 +2083,53 @@ int main(int argc, char *argv[]) {
             multi_stats.avg_latencies[iter] = stats.avg_latency_ms;
             
             // 显示本轮结果
+            log_flush();
             printf("\n--- 第 %d 轮结果 ---\n", iter + 1);
             printf("耗时: %.3f 秒\n", elapsed_sec);
             printf("发送包数: %lu\n", stats.packets_sent);
             printf("接收包数: %lu\n", stats.packets_received);
             printf("丢失包数: %lu\n", stats.packets_lost);
+            if (stats.packets_lost > 0 || socket_drops > 0) {
+                printf("  其中本端接收socket丢弃 %lu，其余 %lu 在线路或对端丢失\n", socket_drops,
+                       stats.packets_lost > socket_drops ? stats.packets_lost - socket_drops : 0);
+            }
             printf("丢包率: %.2f%%\n", multi_stats.packet_loss_rates[iter]);
+            if (late > 0 || duplicates > 0 || unknown > 0) {
+                printf("迟到响应(超出窗口): %lu, 重复响应: %lu, 未知序列号: %lu\n", late, duplicates, unknown);
+            }
+            if (echo_seq.reordered > 0) {
+                printf("乱序回送: %lu (%.3f%%, 最大距离 %lu)\n", echo_seq.reordered,
+                       echo_seq.received > 0 ? echo_seq.reordered * 100.0 / echo_seq.received : 0.0,
+                       echo_seq.max_distance);
+                seq_print_reorder_hist(&echo_seq);
+            }
             if (stats.packets_received > 0) {
                 printf("最小RTT: %.4f ms\n", stats.min_latency_ms);
                 printf("最大RTT: %.4f ms\n", stats.max_latency_ms);
                 printf("平均RTT: %.4f ms\n", stats.avg_latency_ms);
+                print_latency_percentiles(&stats.latency_hist);
             }
             printf("发送字节数: %.2f MB\n", stats.bytes_sent / 1024.0 / 1024.0);
             printf("接收字节数: %.2f MB\n", stats.bytes_received / 1024.0 / 1024.0);
             printf("吞吐量: %.2f Mbps\n", multi_stats.throughputs[iter]);
+            pacer_print_report(&pacer, stats.packets_sent, stats.bytes_sent);
+            print_tx_cpu_report(flows, num_flows, &pacer, stats.packets_sent);
+            if (zerocopy) {
+                zc_print_report(&zc_round);
+                if (zc_timeouts > 0) {
+                    printf("[WARNING] %lu buffer reuses timed out waiting for zero-copy completions\n",
+                           zc_timeouts);
+                }
+            }
+            if (flows[0].ts_breakdown) {
+                ts_print_breakdown(flows[0].ts_breakdown);
+            }
+            if (num_flows > 1) {
+                printf("\n--- 各流结果 ---\n");
+                for (int f = 0; f < num_flows; f++) {
+                    print_flow_result(f, &flows[f]);
+                }
+            }
             
             // 每轮之间稍作停顿
             if (iter < iterations - 1) {
@@ -501,17 +2145,15 @@ int main(int argc, char *argv[]) {
             // 单轮测试，直接打印统计信息
             print_stats(&stats);
         }
+        if (ll.compare) {
+            print_mode_comparison(mode_hists, mode_rounds);
+        }
         
         // 释放多轮测试统计内存
         free_multi_iteration_stats(&multi_stats);
-        
-        // 释放发送时间映射表
-        if (send_time_map) {
-            free(send_time_map);
-            send_time_map = NULL;
-            send_time_map_size = 0;
-            send_time_map_capacity = 0;
-        }
+        perf_flows_destroy(flows, num_flows);
+        report_close(&report);
+        log_shutdown();
         
         printf("\nPerformance test completed.\n");
         
@@ -579,12 +2221,6 @@ int main(int argc, char *argv[]) {
         print_stats(&stats);
     }
     
-    // 释放发送时间映射表
-    if (send_time_map) {
-        free(send_time_map);
-        send_time_map = NULL;
-    }
-    
     close(sockfd);
     return 0;
 }
@@ -1,18 +1,106 @@
 #include "../include/common.h"
+#include "../include/tsc.h"
+#include "../include/sockbuf.h"
+#include "../include/report.h"
 #include <math.h>
+#include <endian.h>
 
-// 获取当前时间（毫秒）
+// 获取当前时间（毫秒，单调时钟，仅用于计算时间间隔）
 double get_time_ms(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+    return tsc_now_ns() / 1e6;
 }
 
-// 获取当前时间（微秒）
+// 获取当前时间（微秒，单调时钟，仅用于计算时间间隔）
 uint64_t get_time_us(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (uint64_t)tv.tv_sec * 1000000ULL + tv.tv_usec;
+    return tsc_now_ns() / 1000;
+}
+
+// 获取指定时钟源的当前时间（纳秒），用于写入包头和与其他进程的时间戳比较
+// 始终读取内核时钟（vDSO），同一主机上的两个进程读到的CLOCK_MONOTONIC_RAW完全一致；
+// 进程内的时间间隔（RTT、节拍、报告）用tsc_now_ns()
+uint64_t get_time_ns(int clock_id) {
+    clockid_t clk;
+    switch (clock_id) {
+        case PERF_CLOCK_TAI:      clk = CLOCK_TAI; break;
+        case PERF_CLOCK_REALTIME: clk = CLOCK_REALTIME; break;
+        default:                  clk = CLOCK_MONOTONIC_RAW; break;
+    }
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// 性能测试包头长度
+size_t perf_header_size(int version) {
+    return version == PERF_VERSION_LEGACY ? sizeof(perf_packet_t) : sizeof(perf_packet_v2_t);
+}
+
+// 写入性能测试包头中每个包都相同的字段（发送前只需调用一次）
+void perf_packet_init(void *buf, int version, int clock_id, uint32_t flow_id, uint32_t data_len) {
+    if (version == PERF_VERSION_LEGACY) {
+        perf_packet_t *pkt = (perf_packet_t *)buf;
+        memset(pkt, 0, sizeof(*pkt));
+        pkt->data_len = data_len;
+        return;
+    }
+    perf_packet_v2_t *pkt = (perf_packet_v2_t *)buf;
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->magic = htonl(PERF_MAGIC);
+    pkt->version = PERF_VERSION;
+    pkt->clock_id = (uint8_t)clock_id;
+    pkt->header_len = htons(sizeof(perf_packet_v2_t));
+    pkt->flow_id = htonl(flow_id);
+    pkt->data_len = htonl(data_len);
+}
+
+// 写入序列号和发送时间戳（v1旧格式的时间戳应为CLOCK_REALTIME）
+void perf_packet_stamp(void *buf, int version, uint32_t seq_num, uint64_t timestamp_ns) {
+    if (version == PERF_VERSION_LEGACY) {
+        perf_packet_t *pkt = (perf_packet_t *)buf;
+        pkt->seq_num = seq_num;
+        pkt->timestamp_sec = (uint32_t)(timestamp_ns / 1000000000ULL);
+        pkt->timestamp_usec = (uint32_t)(timestamp_ns % 1000000000ULL / 1000);
+        return;
+    }
+    perf_packet_v2_t *pkt = (perf_packet_v2_t *)buf;
+    pkt->seq_num = htonl(seq_num);
+    pkt->timestamp_ns = htobe64(timestamp_ns);
+}
+
+// 解析性能测试包头：识别v2魔数，否则按v1旧格式解析
+// 成功返回0，长度不足或格式不符返回-1
+int perf_packet_parse(const void *buf, size_t len, perf_header_t *hdr) {
+    if (len >= sizeof(perf_packet_v2_t)) {
+        const perf_packet_v2_t *pkt = (const perf_packet_v2_t *)buf;
+        if (ntohl(pkt->magic) == PERF_MAGIC && pkt->version == PERF_VERSION) {
+            uint16_t header_len = ntohs(pkt->header_len);
+            if (header_len < sizeof(perf_packet_v2_t) || header_len > len) {
+                return -1;
+            }
+            hdr->version = PERF_VERSION;
+            hdr->clock_id = pkt->clock_id;
+            hdr->header_len = header_len;
+            hdr->flow_id = ntohl(pkt->flow_id);
+            hdr->seq_num = ntohl(pkt->seq_num);
+            hdr->timestamp_ns = be64toh(pkt->timestamp_ns);
+            hdr->data_len = ntohl(pkt->data_len);
+            return 0;
+        }
+    }
+    
+    if (len < sizeof(perf_packet_t)) {
+        return -1;
+    }
+    const perf_packet_t *pkt = (const perf_packet_t *)buf;
+    hdr->version = PERF_VERSION_LEGACY;
+    hdr->clock_id = PERF_CLOCK_REALTIME;
+    hdr->header_len = sizeof(perf_packet_t);
+    hdr->flow_id = 0;
+    hdr->seq_num = pkt->seq_num;
+    hdr->timestamp_ns = (uint64_t)pkt->timestamp_sec * 1000000000ULL +
+                        (uint64_t)pkt->timestamp_usec * 1000ULL;
+    hdr->data_len = pkt->data_len;
+    return 0;
 }
 
 // 创建UDP socket
@@ -31,17 +119,8 @@ int create_udp_socket(void) {
         return -1;
     }
     
-    // 设置接收缓冲区大小
-    int rcvbuf = 1024 * 1024;  // 1MB
-    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
-        perror("setsockopt SO_RCVBUF failed");
-    }
-    
-    // 设置发送缓冲区大小
-    int sndbuf = 1024 * 1024;  // 1MB
-    if (setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) < 0) {
-        perror("setsockopt SO_SNDBUF failed");
-    }
+    // 设置收发缓冲区大小（--rcvbuf/--sndbuf，默认1MB），并启用接收队列丢弃计数
+    sockbuf_apply(sockfd);
     
     return sockfd;
 }
@@ -66,6 +145,19 @@ int bind_socket(int sockfd, const char *ip, int port) {
     return 0;
 }
 
+// 启动后台线程：创建期间屏蔽SIGINT/SIGTERM，新线程继承该掩码，信号仍由主线程处理
+// 返回pthread_create()的错误码，0表示成功
+int start_background_thread(pthread_t *thread, void *(*fn)(void *), void *arg) {
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    int err = pthread_create(thread, NULL, fn, arg);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return err;
+}
+
 // 打印统计信息
 void print_stats(stats_t *stats) {
     struct timeval elapsed;
@@ -83,8 +175,13 @@ void print_stats(stats_t *stats) {
            stats->bytes_received, stats->bytes_received / 1024.0 / 1024.0);
     
     if (stats->packets_received > 0) {
+        // 丢包率以应到包数为分母：发送端为发送数；接收端（回送数不代表应到数）为收到数加丢失数
+        uint64_t expected = stats->packets_received + stats->packets_lost;
+        if (stats->packets_sent > expected) {
+            expected = stats->packets_sent;
+        }
         printf("丢包率: %.2f%%\n", 
-               (double)stats->packets_lost / stats->packets_sent * 100.0);
+               (double)stats->packets_lost / expected * 100.0);
         printf("平均吞吐量: %.2f Mbps\n", 
                (stats->bytes_received * 8.0) / elapsed_sec / 1000000.0);
     }
@@ -94,11 +191,34 @@ void print_stats(stats_t *stats) {
         printf("最大延迟: %.3f ms\n", stats->max_latency_ms);
         printf("平均延迟: %.3f ms\n", stats->avg_latency_ms);
     }
+    print_latency_percentiles(&stats->latency_hist);
     printf("===================================\n\n");
 }
 
+// 把src的计数与延迟统计累加到dst（不处理start_time/end_time，由调用者设置）
+void merge_stats(stats_t *dst, const stats_t *src) {
+    if (src->latency_hist.total_count > 0) {
+        if (dst->latency_hist.total_count == 0 || src->min_latency_ms < dst->min_latency_ms) {
+            dst->min_latency_ms = src->min_latency_ms;
+        }
+        if (src->max_latency_ms > dst->max_latency_ms) {
+            dst->max_latency_ms = src->max_latency_ms;
+        }
+    }
+    dst->packets_sent += src->packets_sent;
+    dst->packets_received += src->packets_received;
+    dst->bytes_sent += src->bytes_sent;
+    dst->bytes_received += src->bytes_received;
+    dst->packets_lost += src->packets_lost;
+    dst->total_latency_ms += src->total_latency_ms;
+    hist_merge(&dst->latency_hist, &src->latency_hist);
+    if (dst->latency_hist.total_count > 0) {
+        dst->avg_latency_ms = dst->total_latency_ms / dst->latency_hist.total_count;
+    }
+}
+
 // 格式化延迟显示：根据值大小自动选择单位（微秒或毫秒）
-static void format_latency(double latency_ms, char *buf, size_t buf_size) {
+void format_latency(double latency_ms, char *buf, size_t buf_size) {
     if (latency_ms < 0.001) {
         // 小于0.001ms，使用微秒显示
         double latency_us = latency_ms * 1000.0;
@@ -118,6 +238,25 @@ static void format_latency(double latency_ms, char *buf, size_t buf_size) {
     }
 }
 
+// 打印延迟百分位（p50/p90/p99/p99.9/p99.99/max）
+void print_latency_percentiles(const latency_hist_t *hist) {
+    if (hist->total_count == 0) {
+        return;
+    }
+    
+    static const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+    static const char *labels[] = {"p50", "p90", "p99", "p99.9", "p99.99"};
+    char buf[64];
+    
+    printf("延迟分布 (%lu 个样本):", hist->total_count);
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        format_latency(hist_value_at_percentile(hist, percentiles[i]) / 1e6, buf, sizeof(buf));
+        printf(" %s=%s", labels[i], buf);
+    }
+    format_latency(hist->max_ns / 1e6, buf, sizeof(buf));
+    printf(" max=%s\n", buf);
+}
+
 // 打印多轮迭代测试统计信息
 void print_multi_iteration_stats(multi_iteration_stats_t *multi_stats) {
     if (!multi_stats || multi_stats->iteration_count == 0) {
@@ -177,6 +316,7 @@ void print_multi_iteration_stats(multi_iteration_stats_t *multi_stats) {
     printf("平均耗时: %.3f 秒\n", avg_duration);
     printf("总发送包数: %lu\n", total_packets_sent);
     printf("总接收包数: %lu\n", total_packets_received);
+    print_latency_percentiles(&multi_stats->latency_hist);
     
     printf("\n--- 每轮详细结果 ---\n");
     for (int i = 0; i < multi_stats->iteration_count; i++) {
@@ -223,10 +363,58 @@ void print_usage(const char *program_name) {
         printf("  -p <port>       Specify port (default: %d)\n", DEFAULT_PORT);
         printf("  -i <ip>         Specify bind IP address (default: %s)\n", DEFAULT_SERVER_IP);
         printf("  -t              Enable performance test mode\n");
+        printf("  -e              Echo (reflector) mode: bounce every datagram back to its sender\n");
+        printf("  -B <n>          Receive up to n packets per recvmmsg() call (default: 1, max: %d)\n", MAX_BATCH_SIZE);
+        printf("  -T <threads>    Receive threads, each with its own SO_REUSEPORT socket pinned to a core\n");
+        printf("                  (default: 1, max: 64); aggregated report every second\n");
+        printf("  --seq-window <n>  Sequence window for loss/reorder/duplicate detection (default: 65536)\n");
+        printf("  --max-flows <n>   Senders (source addr/port + flow id) tracked per thread, each with its\n");
+        printf("                  own sequence window and latency stats (default: 256)\n");
+        printf("  --flow-idle <sec> Evict flows idle this long, 0 = never (default: 30)\n");
+        printf("  --timestamping[=sw|hw]  Kernel (sw, default) or NIC (hw) receive timestamps;\n");
+        printf("                  reports kernel RX -> application and wire/stack latency\n");
+        printf("  --ts-iface <if> Interface to enable NIC timestamping on (required for hw)\n");
+        printf("  --io <backend>  I/O backend: socket (recvmsg/recvmmsg, default), uring\n");
+        printf("                  (io_uring multishot recvmsg + provided buffer ring; falls back to socket)\n");
+        printf("                  or xdp (AF_XDP: an XDP program redirects matching UDP frames to a UMEM,\n");
+        printf("                  bypassing the UDP stack; echo mode reflects frames in place)\n");
+        printf("  --gro           Enable UDP_GRO: receive coalesced super-datagrams and split them per packet\n");
+        printf("  --xdp-iface <if>  AF_XDP interface (default: the interface owning the -i address)\n");
+        printf("  --xdp-mode <m>  XDP mode: skb (generic, any interface, default) or native (driver, zero-copy)\n");
+        printf("  --xdp-queue <n> First NIC queue; receive thread i binds queue n+i (default: 0)\n");
+        printf("  --pipeline <n>  Receive pipeline: each receive thread only receives (and echoes) into a\n");
+        printf("                  buffer pool and hands packets to n processing threads over lock-free\n");
+        printf("                  rings (max: 16; socket backend only); reports ring occupancy and pool exhaustion\n");
+        printf("  --pipe-pool <n> Buffers in each receive thread's pool (default: 4096)\n");
+        printf("  --pipe-slot <bytes>  Pool buffer size; longer datagrams are truncated (default: 2048)\n");
+        printf("  --log-level <l> Log level: error, warn, info or debug (default: debug)\n");
+        printf("  --log-rate <n>  Lines per second per message type, the rest are counted and summarized\n");
+        printf("                  (default: 50, 0 = unlimited); logs are written by a background thread\n");
+        printf("  --low-latency   Spin on non-blocking receive with SO_BUSY_POLL/SO_PREFER_BUSY_POLL, pin every\n");
+        printf("                  thread (isolated CPUs if any) and pre-fault buffers (socket backend only)\n");
+        printf("  --busy-poll <us>  SO_BUSY_POLL time in low-latency mode (default: 50, 0 = off)\n");
+        printf("  --rt-prio <p>   Run receive threads under SCHED_FIFO priority p (1-99; implies --low-latency)\n");
+        printf("  --mlock         Lock all memory with mlockall() (implies --low-latency)\n");
+        printf("  --cpus <list>   CPUs for pinned threads, e.g. 2-3,6 (default: isolated CPUs; implies --low-latency)\n");
+        printf("  --rcvbuf <size> Requested SO_RCVBUF in bytes, k/m suffix allowed (default: 1m)\n");
+        printf("  --sndbuf <size> Requested SO_SNDBUF in bytes, k/m suffix allowed (default: 1m)\n");
+        printf("  --rcvbuf-auto   Double the receive buffer whenever the socket drops packets (up to 256m)\n");
+        printf("  --report <fmt>  Interval time series of pps, Mbps, loss, reorder, socket drops and latency\n");
+        printf("                  percentiles as json (JSON Lines) or csv\n");
+        printf("  --report-interval <ms>  Report interval (default: %d, min: %d)\n", REPORT_DEFAULT_INTERVAL_MS,
+               REPORT_MIN_INTERVAL_MS);
+        printf("  --report-file <path>    Write the interval report to a file (default: stdout; other output\n");
+        printf("                          then goes to stderr)\n");
+        printf("  --shm[=name]    Publish live per-thread and per-flow counters to POSIX shared memory\n");
+        printf("                  (default name: /udp_server.<port>); view with udp_stat\n");
         printf("\n");
         printf("Examples:\n");
         printf("  %s -p 8888\n", program_name);
         printf("  %s -i 0.0.0.0 -p 8888 -t\n", program_name);
+        printf("  %s -i 0.0.0.0 -p 8888 -t -B 64\n", program_name);
+        printf("  %s -i 0.0.0.0 -p 8888 -t -B 64 -T 4\n", program_name);
+        printf("  %s -i 127.0.0.1 -p 8888 -t -e -B 64   (local TC3 stand-in for RTT tests)\n", program_name);
+        printf("  %s -i 10.0.0.2 -p 8888 -t -e --io xdp   (AF_XDP reflector, ceiling measurement)\n", program_name);
     } else {
         printf("Usage: %s [options]\n", program_name);
         printf("Description: Send UDP packets to TC3\n");
@@ -240,11 +428,51 @@ void print_usage(const char *program_name) {
         printf("  -n <count>      Number of test packets (default: 1000)\n");
         printf("  -s <size>       Packet size in bytes (0 or not set = max UDP size, default: 0)\n");
         printf("  -r <iterations> Number of test iterations for averaging (default: 1)\n");
+        printf("  -b <n>          Send n packets per sendmmsg() call (default: 1, max: %d)\n", MAX_BATCH_SIZE);
+        printf("  -F <flows>      Parallel flows, each with its own socket/source port, send and receive\n");
+        printf("                  threads, CPU affinity and sequence space; -n and --rate are split evenly\n");
+        printf("                  (default: 1, max: 64)\n");
+        printf("  --rate <rate>   Target send rate: pps (20000, 50kpps, 1Mpps) or bit rate (500Mbps, 2Gbps),\n");
+        printf("                  0 = unlimited (default: 1000pps)\n");
+        printf("  --burst <n>     Packets sent back-to-back per pacing slot (default: same as -b)\n");
+        printf("  --window <n>    In-flight RTT window in packets, rounded up to a power of 2 (default: 65536)\n");
+        printf("  --clock <clk>   Wire timestamp clock: mono (CLOCK_MONOTONIC_RAW, default) or tai (cross-host)\n");
+        printf("  --flow-id <id>  Flow id carried in the v2 packet header (default: 0)\n");
+        printf("  --legacy        Send the legacy v1 packet layout (gettimeofday timestamps)\n");
+        printf("  --timestamping[=sw|hw]  Kernel (sw, default) or NIC (hw) TX/RX timestamps; reports\n");
+        printf("                  app send -> kernel TX, wire/stack and kernel RX -> app latency\n");
+        printf("  --ts-iface <if> Interface to enable NIC timestamping on (required for hw)\n");
+        printf("  --io <backend>  Perf-mode I/O backend: socket (sendmmsg/poll, default), uring\n");
+        printf("                  (batched SENDMSG submissions, multishot recvmsg; falls back to socket)\n");
+        printf("                  or xdp (AF_XDP send bypassing the UDP stack; echoes still use the socket)\n");
+        printf("  --xdp-iface <if>  AF_XDP interface (default: chosen by the route to the server)\n");
+        printf("  --xdp-mode <m>  XDP mode: skb (generic, any interface, default) or native (driver, zero-copy)\n");
+        printf("  --xdp-queue <n> NIC queue the AF_XDP socket is bound to (default: 0)\n");
+        printf("  --gso <segs>    UDP GSO: send up to segs back-to-back packets per call with UDP_SEGMENT\n");
+        printf("                  (max 64; each packet must fit the path MTU; raises -b to segs)\n");
+        printf("  --zerocopy      Send with MSG_ZEROCOPY from a pinned buffer pool; reports zero-copy vs copied completions\n");
+        printf("  --log-level <l> Log level: error, warn, info or debug (default: debug)\n");
+        printf("  --log-rate <n>  Lines per second per message type, the rest are counted and summarized\n");
+        printf("                  (default: 50, 0 = unlimited); logs are written by a background thread\n");
+        printf("  --low-latency[=compare]  Spin on non-blocking receive with SO_BUSY_POLL/SO_PREFER_BUSY_POLL,\n");
+        printf("                  pin send/receive threads (isolated CPUs if any) and pre-fault buffers;\n");
+        printf("                  'compare' alternates default and low-latency iterations and reports both\n");
+        printf("                  RTT distributions (not with --io uring)\n");
+        printf("  --busy-poll <us> / --rt-prio <p> / --mlock / --cpus <list>  Same as the server\n");
+        printf("  --rcvbuf <size> / --sndbuf <size> / --rcvbuf-auto  Same as the server\n");
+        printf("  --report <fmt> / --report-interval <ms> / --report-file <path>  Same as the server, one\n");
+        printf("                  series per iteration (round column), RTT percentiles\n");
         printf("\n");
         printf("Examples:\n");
         printf("  Interactive send: %s -i 192.168.1.100 -p 8888\n", program_name);
         printf("  Send test:        %s -i 192.168.1.100 -p 8888 -t -n 1000 -s 0\n", program_name);
         printf("  Multi-iteration:  %s -i 192.168.1.100 -p 8888 -t -n 1000 -s 0 -r 10\n", program_name);
+        printf("  Batched send:     %s -i 192.168.1.100 -p 8888 -t -n 100000 -s 512 -b 32\n", program_name);
+        printf("  Paced send:       %s -i 192.168.1.100 -p 8888 -t -n 100000 -s 512 --rate 200Mbps\n", program_name);
+        printf("  GSO send:         %s -i 192.168.1.100 -p 8888 -t -n 100000 -s 1400 --gso 32 --rate 0\n", program_name);
+        printf("  Parallel flows:   %s -i 192.168.1.100 -p 8888 -t -n 400000 -s 512 -b 32 --rate 400kpps -F 8\n", program_name);
+        printf("  AF_XDP send:      %s -i 192.168.1.100 -p 8888 -t -n 1000000 -s 1400 -b 64 --rate 0 --io xdp\n", program_name);
+        printf("  Low latency:      %s -i 192.168.1.100 -p 8888 -t -n 10000 -s 64 --rate 1000 -r 10 --low-latency=compare\n", program_name);
     }
 }
 
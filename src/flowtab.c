@@ -0,0 +1,283 @@
+#include "../include/flowtab.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#define FLOWTAB_MIN_SWEEP_NS 1000000000ULL   // 空闲扫描的最小周期
+
+// 64位混合函数（MurmurHash3 fmix64）
+static uint32_t flow_hash(const flow_key_t *key) {
+    uint64_t h = ((uint64_t)key->addr << 32) | ((uint64_t)key->port << 16);
+    h ^= (uint64_t)key->flow_id * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+static int flow_key_equal(const flow_key_t *a, const flow_key_t *b) {
+    return a->addr == b->addr && a->port == b->port && a->flow_id == b->flow_id;
+}
+
+int flowtab_init(flowtab_t *tab, uint32_t max_flows, uint32_t window, uint32_t idle_sec) {
+    memset(tab, 0, sizeof(*tab));
+    if (max_flows < 1) {
+        max_flows = 1;
+    }
+    
+    // 槽数为表项数的2倍以上（2的幂），线性探测的负载因子不超过0.5
+    uint32_t slots = 2;
+    while (slots < 2 * max_flows) {
+        slots <<= 1;
+    }
+    tab->flows = calloc(max_flows, sizeof(flow_t));
+    tab->free_list = malloc(max_flows * sizeof(uint32_t));
+    tab->slots = calloc(slots, sizeof(uint32_t));
+    if (!tab->flows || !tab->free_list || !tab->slots) {
+        fprintf(stderr, "Error: Failed to allocate flow table (%u flows)\n", max_flows);
+        flowtab_free(tab);
+        return -1;
+    }
+    
+    // 空闲栈倒序压入，使表项按下标顺序取用
+    for (uint32_t i = 0; i < max_flows; i++) {
+        tab->free_list[i] = max_flows - 1 - i;
+    }
+    tab->free_count = max_flows;
+    tab->slot_mask = slots - 1;
+    tab->max_flows = max_flows;
+    tab->window = window;
+    tab->idle_ns = (uint64_t)idle_sec * 1000000000ULL;
+    return 0;
+}
+
+void flowtab_free(flowtab_t *tab) {
+    if (tab->flows) {
+        for (uint32_t i = 0; i < tab->max_flows; i++) {
+            if (tab->flows[i].win.bits) {
+                seqwin_free(&tab->flows[i].win);
+            }
+        }
+    }
+    free(tab->flows);
+    free(tab->free_list);
+    free(tab->slots);
+    memset(tab, 0, sizeof(*tab));
+}
+
+// 从哈希表中删除表项idx：找到其槽位后向后移位删除（无墓碑，探测链保持连续）
+static void flowtab_unlink(flowtab_t *tab, uint32_t idx) {
+    uint32_t i = tab->flows[idx].hash & tab->slot_mask;
+    while (tab->slots[i] != idx + 1) {
+        i = (i + 1) & tab->slot_mask;
+    }
+    
+    uint32_t j = i;
+    for (;;) {
+        j = (j + 1) & tab->slot_mask;
+        if (tab->slots[j] == 0) {
+            break;
+        }
+        // j上的表项的理想位置若不在(i, j]区间内，说明它越过了i，可以移到i
+        uint32_t home = tab->flows[tab->slots[j] - 1].hash & tab->slot_mask;
+        if (((j - home) & tab->slot_mask) >= ((j - i) & tab->slot_mask)) {
+            tab->slots[i] = tab->slots[j];
+            i = j;
+        }
+    }
+    tab->slots[i] = 0;
+}
+
+// 流的序列号统计：当前窗口快照 + 重新编号之前的各段
+static void flow_seq_snapshot(const flow_t *flow, seq_stats_t *out) {
+    seqwin_snapshot(&flow->win, out);
+    seq_stats_merge(out, &flow->prev_seq);
+}
+
+// 淘汰一个流：统计并入已淘汰汇总，表项归还空闲栈（窗口位图保留供复用）
+static void flowtab_evict(flowtab_t *tab, uint32_t idx) {
+    flow_t *flow = &tab->flows[idx];
+    seq_stats_t seq;
+    flow_seq_snapshot(flow, &seq);
+    seq.lost += seq.missing;
+    seq.missing = 0;
+    seq_stats_merge(&tab->evicted_seq, &seq);
+    tab->evicted_packets += flow->packets;
+    tab->evicted_bytes += flow->bytes;
+    
+    flowtab_unlink(tab, idx);
+    flow->in_use = 0;
+    tab->free_list[tab->free_count++] = idx;
+    tab->count--;
+    tab->flows_evicted++;
+}
+
+// 淘汰空闲超时的流，并记录剩余流中最早可能超时的时间
+static void flowtab_sweep(flowtab_t *tab, uint64_t now_ns) {
+    uint64_t oldest = now_ns;
+    for (uint32_t i = 0; i < tab->max_flows && tab->count > 0; i++) {
+        flow_t *flow = &tab->flows[i];
+        if (!flow->in_use) {
+            continue;
+        }
+        if (now_ns > flow->last_seen_ns && now_ns - flow->last_seen_ns >= tab->idle_ns) {
+            flowtab_evict(tab, i);
+        } else if (flow->last_seen_ns < oldest) {
+            oldest = flow->last_seen_ns;
+        }
+    }
+    tab->next_expiry_ns = oldest + tab->idle_ns;
+    uint64_t period = tab->idle_ns / 4 > FLOWTAB_MIN_SWEEP_NS ? tab->idle_ns / 4 : FLOWTAB_MIN_SWEEP_NS;
+    tab->next_sweep_ns = now_ns + period;
+}
+
+flow_t *flowtab_lookup(flowtab_t *tab, const flow_key_t *key, uint64_t now_ns) {
+    if (tab->idle_ns > 0 && now_ns >= tab->next_sweep_ns) {
+        flowtab_sweep(tab, now_ns);
+    }
+    
+    uint32_t hash = flow_hash(key);
+    uint32_t i = hash & tab->slot_mask;
+    while (tab->slots[i] != 0) {
+        flow_t *flow = &tab->flows[tab->slots[i] - 1];
+        if (flow->hash == hash && flow_key_equal(&flow->key, key)) {
+            flow->last_seen_ns = now_ns;
+            return flow;
+        }
+        i = (i + 1) & tab->slot_mask;
+    }
+    
+    // 新流：表满时先尝试淘汰空闲流，仍然没有空位则不跟踪，避免挤掉活跃流破坏其统计
+    // 在最早可能超时的时间之前无需重复扫描（表满期间新流的包不会每个都触发全表扫描）
+    if (tab->free_count == 0 && tab->idle_ns > 0 && now_ns >= tab->next_expiry_ns) {
+        flowtab_sweep(tab, now_ns);
+        if (tab->free_count > 0) {
+            // 淘汰后探测链可能前移，重新定位空槽
+            i = hash & tab->slot_mask;
+            while (tab->slots[i] != 0) {
+                i = (i + 1) & tab->slot_mask;
+            }
+        }
+    }
+    if (tab->free_count == 0) {
+        tab->overflow_packets++;
+        return NULL;
+    }
+    
+    uint32_t idx = tab->free_list[--tab->free_count];
+    flow_t *flow = &tab->flows[idx];
+    if (flow->win.bits) {
+        seqwin_reset(&flow->win);
+    } else if (seqwin_init(&flow->win, tab->window) < 0) {
+        tab->free_count++;
+        tab->overflow_packets++;
+        return NULL;
+    }
+    flow->key = *key;
+    flow->hash = hash;
+    flow->in_use = 1;
+    flow->first_seen_ns = flow->last_seen_ns = now_ns;
+    flow->packets = flow->bytes = flow->lost = flow->latency_sum_ns = flow->max_ts_ns = 0;
+    flow->restarts = 0;
+    memset(&flow->prev_seq, 0, sizeof(flow->prev_seq));
+    hist_reset(&flow->latency);
+    tab->slots[i] = idx + 1;
+    tab->count++;
+    tab->flows_created++;
+    return flow;
+}
+
+// 发送端重新编号：当前窗口的统计（仍缺失的计为丢失）并入prev_seq，窗口从下一个包重新开始
+// 丢失总数不变，全表丢失数无需调整
+static void flow_restart(flow_t *flow) {
+    seq_stats_t seq;
+    seqwin_snapshot(&flow->win, &seq);
+    seq.lost += seq.missing;
+    seq.missing = 0;
+    seq_stats_merge(&flow->prev_seq, &seq);
+    seqwin_reset(&flow->win);
+    flow->restarts++;
+}
+
+void flowtab_record_seq(flowtab_t *tab, flow_t *flow, uint32_t seq_num, uint64_t ts_ns) {
+    // 真正的重复、迟到或乱序包都在窗口顶端的包之前发出，发送时间戳不会比见过的最大值更新
+    if (ts_ns > flow->max_ts_ns) {
+        if (flow->max_ts_ns > 0 && seqwin_behind(&flow->win, seq_num)) {
+            flow_restart(flow);
+        }
+        flow->max_ts_ns = ts_ns;
+    }
+    if (seqwin_update(&flow->win, seq_num) == SEQ_REORDERED) {
+        tab->reordered++;
+    }
+    // 丢失数可能因乱序补到而减少，无符号回绕相加结果仍正确
+    uint64_t lost = flow->prev_seq.lost + seqwin_lost(&flow->win);
+    tab->lost += lost - flow->lost;
+    flow->lost = lost;
+}
+
+void flowtab_seq_stats(const flowtab_t *tab, seq_stats_t *out) {
+    *out = tab->evicted_seq;
+    for (uint32_t i = 0; i < tab->max_flows; i++) {
+        if (tab->flows[i].in_use) {
+            seq_stats_t seq;
+            flow_seq_snapshot(&tab->flows[i], &seq);
+            seq_stats_merge(out, &seq);
+        }
+    }
+}
+
+static int flow_compare(const void *a, const void *b) {
+    const flow_key_t *x = &(*(const flow_t * const *)a)->key;
+    const flow_key_t *y = &(*(const flow_t * const *)b)->key;
+    uint32_t xa = ntohl(x->addr), ya = ntohl(y->addr);
+    uint16_t xp = ntohs(x->port), yp = ntohs(y->port);
+    if (xa != ya) {
+        return xa < ya ? -1 : 1;
+    }
+    if (xp != yp) {
+        return xp < yp ? -1 : 1;
+    }
+    if (x->flow_id != y->flow_id) {
+        return x->flow_id < y->flow_id ? -1 : 1;
+    }
+    return 0;
+}
+
+void flow_print_report(const flow_t **flows, int count, uint64_t now_ns) {
+    if (count == 0) {
+        return;
+    }
+    qsort(flows, count, sizeof(flows[0]), flow_compare);
+    
+    printf("\n========== 每流统计 (%d 个活跃流) ==========\n", count);
+    for (int i = 0; i < count; i++) {
+        const flow_t *flow = flows[i];
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &flow->key.addr, ip, sizeof(ip));
+        
+        seq_stats_t seq;
+        flow_seq_snapshot(flow, &seq);
+        uint64_t lost = seq.lost + seq.missing;
+        double active_sec = (flow->last_seen_ns - flow->first_seen_ns) / 1e9;
+        uint64_t samples = flow->latency.total_count;
+        printf("%s:%u 流%u: 接收 %lu 包 (%.2f Mbps), 丢失 %lu (%.2f%%), 乱序 %lu, 重复 %lu, 迟到 %lu",
+               ip, ntohs(flow->key.port), flow->key.flow_id, flow->packets,
+               active_sec > 0 ? flow->bytes * 8.0 / active_sec / 1000000.0 : 0.0,
+               lost, flow->packets + lost > 0 ? lost * 100.0 / (flow->packets + lost) : 0.0,
+               seq.reordered, seq.duplicates, seq.late);
+        if (flow->restarts > 0) {
+            printf(", 发送端重新编号 %u 次", flow->restarts);
+        }
+        if (samples > 0) {
+            printf(", 平均延迟=%.3f ms, p99=%.3f ms",
+                   flow->latency_sum_ns / (double)samples / 1e6,
+                   hist_value_at_percentile(&flow->latency, 99.0) / 1e6);
+        }
+        printf(", 空闲 %.1f 秒\n", now_ns > flow->last_seen_ns ? (now_ns - flow->last_seen_ns) / 1e9 : 0.0);
+    }
+    printf("=============================================\n");
+}
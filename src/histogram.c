@@ -0,0 +1,95 @@
+#include "../include/common.h"
+#include "../include/histogram.h"
+
+// 桶下标对应的取值区间 [lowest, lowest + width)
+static void hist_bucket_range(uint32_t index, uint64_t *lowest, uint64_t *width) {
+    if (index < LAT_HIST_SUB_COUNT) {
+        *lowest = index;
+        *width = 1;
+        return;
+    }
+    uint32_t offset = index - LAT_HIST_SUB_COUNT;
+    uint32_t shift = offset / LAT_HIST_HALF_COUNT + 1;
+    uint64_t sub = offset % LAT_HIST_HALF_COUNT + LAT_HIST_HALF_COUNT;
+    *lowest = sub << shift;
+    *width = 1ULL << shift;
+}
+
+// 清空直方图
+void hist_reset(latency_hist_t *hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+// 合并直方图（用于多线程/多轮测试汇总）
+void hist_merge(latency_hist_t *dst, const latency_hist_t *src) {
+    if (src->total_count == 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < LAT_HIST_COUNTS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    if (dst->total_count == 0 || src->min_ns < dst->min_ns) {
+        dst->min_ns = src->min_ns;
+    }
+    if (src->max_ns > dst->max_ns) {
+        dst->max_ns = src->max_ns;
+    }
+    dst->total_count += src->total_count;
+}
+
+// 获取指定百分位（0~100）的延迟值（纳秒），取所在桶的中点并限制在[min, max]内
+uint64_t hist_value_at_percentile(const latency_hist_t *hist, double percentile) {
+    if (hist->total_count == 0) {
+        return 0;
+    }
+    if (percentile >= 100.0) {
+        return hist->max_ns;
+    }
+    
+    uint64_t target = (uint64_t)(percentile / 100.0 * hist->total_count + 0.5);
+    if (target < 1) {
+        target = 1;
+    }
+    
+    uint64_t cumulative = 0;
+    for (uint32_t i = 0; i < LAT_HIST_COUNTS; i++) {
+        cumulative += hist->counts[i];
+        if (cumulative >= target) {
+            uint64_t lowest, width;
+            hist_bucket_range(i, &lowest, &width);
+            uint64_t value = lowest + width / 2;
+            if (value < hist->min_ns) {
+                value = hist->min_ns;
+            }
+            if (value > hist->max_ns) {
+                value = hist->max_ns;
+            }
+            return value;
+        }
+    }
+    return hist->max_ns;
+}
+
+void hist_accumulate_live(latency_hist_t *dst, const latency_hist_t *src) {
+    for (uint32_t i = 0; i < LAT_HIST_COUNTS; i++) {
+        dst->counts[i] += __atomic_load_n(&src->counts[i], __ATOMIC_RELAXED);
+    }
+}
+
+void hist_delta(latency_hist_t *out, const latency_hist_t *cur, const latency_hist_t *prev) {
+    memset(out, 0, sizeof(*out));
+    for (uint32_t i = 0; i < LAT_HIST_COUNTS; i++) {
+        uint64_t count = cur->counts[i] > prev->counts[i] ? cur->counts[i] - prev->counts[i] : 0;
+        if (count == 0) {
+            continue;
+        }
+        uint64_t lowest, width;
+        hist_bucket_range(i, &lowest, &width);
+        if (out->total_count == 0) {
+            out->min_ns = lowest;
+        }
+        out->max_ns = lowest + width - 1;
+        out->counts[i] = count;
+        out->total_count += count;
+    }
+}
@@ -0,0 +1,226 @@
+#include "../include/log.h"
+#include "../include/common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define LOG_IDLE_SLEEP_US 1000      // 日志环为空时后台线程的休眠时间
+#define LOG_FLUSH_TIMEOUT_MS 1000   // log_flush()最长等待时间
+#define LOG_SUMMARY_FMT_LEN 60      // 抑制汇总中引用的格式串长度
+
+int log_level = LOG_LEVEL_DEBUG;
+uint32_t log_rate = LOG_DEFAULT_RATE;
+
+// 有界多生产者单消费者环：每个槽位的序号表示其状态，生产者用CAS抢占写入位置，
+// 写完后发布序号；消费者只有一个，无需原子读改写
+typedef struct {
+    _Atomic uint64_t seq;
+    int level;
+    char text[LOG_MSG_MAX];
+} log_slot_t;
+
+static log_slot_t log_ring[LOG_RING_SIZE];
+static _Atomic uint64_t log_enqueue_pos __attribute__((aligned(64)));
+static _Atomic uint64_t log_written __attribute__((aligned(64)));   // 已写出的消息数（消费者下标）
+static _Atomic uint64_t log_dropped;
+static _Atomic(log_site_t *) log_sites;
+static atomic_int log_started;
+static atomic_int log_stop;
+static pthread_t log_thread;
+
+static FILE *log_stream(int level) {
+    return level <= LOG_LEVEL_WARN ? stderr : stdout;
+}
+
+// 粗粒度单调时钟（秒），vDSO读取，不进入内核
+static uint64_t log_now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec;
+}
+
+int log_admit(log_site_t *site) {
+    if (!atomic_load_explicit(&site->registered, memory_order_relaxed)) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&site->registered, &expected, 1)) {
+            site->next = atomic_load(&log_sites);
+            while (!atomic_compare_exchange_weak(&log_sites, &site->next, site)) {
+            }
+        }
+    }
+    if (log_rate == 0) {
+        return 1;
+    }
+    
+    // 固定1秒窗口：新窗口由第一个看到它的线程清零计数
+    uint64_t now = log_now_sec();
+    uint64_t window = atomic_load_explicit(&site->window, memory_order_relaxed);
+    if (window != now && atomic_compare_exchange_strong(&site->window, &window, now)) {
+        atomic_store_explicit(&site->count, 0, memory_order_relaxed);
+    }
+    if (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) < log_rate) {
+        return 1;
+    }
+    atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+    return 0;
+}
+
+// 格式化到buf，截断时保留结尾换行
+static void log_format(char *buf, const char *fmt, va_list ap) {
+    int n = vsnprintf(buf, LOG_MSG_MAX, fmt, ap);
+    if (n >= LOG_MSG_MAX) {
+        buf[LOG_MSG_MAX - 2] = '\n';
+    }
+}
+
+void log_emit(log_site_t *site, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    if (!atomic_load_explicit(&log_started, memory_order_acquire)) {
+        vfprintf(log_stream(site->level), fmt, ap);
+        va_end(ap);
+        return;
+    }
+    
+    uint64_t pos = atomic_load_explicit(&log_enqueue_pos, memory_order_relaxed);
+    log_slot_t *slot;
+    for (;;) {
+        slot = &log_ring[pos & (LOG_RING_SIZE - 1)];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&log_enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // 环满：后台线程跟不上，丢弃而不阻塞调用线程
+            atomic_fetch_add_explicit(&log_dropped, 1, memory_order_relaxed);
+            va_end(ap);
+            return;
+        } else {
+            pos = atomic_load_explicit(&log_enqueue_pos, memory_order_relaxed);
+        }
+    }
+    slot->level = site->level;
+    log_format(slot->text, fmt, ap);
+    va_end(ap);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+// 写出环中已发布的消息；返回写出的条数
+static int log_drain(void) {
+    uint64_t pos = atomic_load_explicit(&log_written, memory_order_relaxed);
+    int n = 0;
+    for (;;) {
+        log_slot_t *slot = &log_ring[pos & (LOG_RING_SIZE - 1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1) {
+            break;
+        }
+        fputs(slot->text, log_stream(slot->level));
+        atomic_store_explicit(&slot->seq, pos + LOG_RING_SIZE, memory_order_release);
+        pos++;
+        n++;
+    }
+    if (n > 0) {
+        fflush(stdout);
+        fflush(stderr);
+        atomic_store_explicit(&log_written, pos, memory_order_release);
+    }
+    return n;
+}
+
+// 汇总各类消息自上次汇总以来被抑制的条数
+static void log_print_suppressed(void) {
+    for (log_site_t *site = atomic_load(&log_sites); site != NULL; site = site->next) {
+        uint64_t n = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+        if (n == 0) {
+            continue;
+        }
+        int len = (int)strcspn(site->fmt, "\n");
+        if (len > LOG_SUMMARY_FMT_LEN) {
+            len = LOG_SUMMARY_FMT_LEN;
+        }
+        fprintf(log_stream(site->level), "[LOG] 超过每秒 %u 条的限制，已抑制 %lu 条: %.*s\n",
+                log_rate, n, len, site->fmt);
+    }
+    fflush(stdout);
+    fflush(stderr);
+}
+
+static void *log_thread_main(void *arg) {
+    (void)arg;
+    uint64_t last_summary = log_now_sec();
+    while (!atomic_load_explicit(&log_stop, memory_order_acquire)) {
+        int n = log_drain();
+        uint64_t now = log_now_sec();
+        if (now != last_summary) {
+            log_print_suppressed();
+            last_summary = now;
+        }
+        if (n == 0) {
+            usleep(LOG_IDLE_SLEEP_US);
+        }
+    }
+    log_drain();
+    return NULL;
+}
+
+int log_init(void) {
+    for (uint64_t i = 0; i < LOG_RING_SIZE; i++) {
+        atomic_store_explicit(&log_ring[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store(&log_enqueue_pos, 0);
+    atomic_store(&log_written, 0);
+    atomic_store(&log_stop, 0);
+    
+    int err = start_background_thread(&log_thread, log_thread_main, NULL);
+    if (err != 0) {
+        fprintf(stderr, "Warning: Failed to start log thread, logging synchronously\n");
+        return -1;
+    }
+    atomic_store_explicit(&log_started, 1, memory_order_release);
+    return 0;
+}
+
+void log_flush(void) {
+    if (!atomic_load(&log_started)) {
+        return;
+    }
+    uint64_t target = atomic_load(&log_enqueue_pos);
+    for (int waited = 0; waited < LOG_FLUSH_TIMEOUT_MS * 10; waited++) {
+        if (atomic_load_explicit(&log_written, memory_order_acquire) >= target) {
+            break;
+        }
+        usleep(100);
+    }
+    log_print_suppressed();
+}
+
+void log_shutdown(void) {
+    if (atomic_load(&log_started)) {
+        atomic_store_explicit(&log_started, 0, memory_order_release);
+        atomic_store_explicit(&log_stop, 1, memory_order_release);
+        pthread_join(log_thread, NULL);
+    }
+    log_print_suppressed();
+    uint64_t dropped = atomic_load(&log_dropped);
+    if (dropped > 0) {
+        fprintf(stderr, "[LOG] 日志环已满，丢弃 %lu 条消息\n", dropped);
+    }
+}
+
+int parse_log_level(const char *str, int *level) {
+    static const char *names[] = { "error", "warn", "info", "debug" };
+    for (int i = 0; i <= LOG_LEVEL_DEBUG; i++) {
+        if (strcmp(str, names[i]) == 0) {
+            *level = i;
+            return 0;
+        }
+    }
+    return -1;
+}
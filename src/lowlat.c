@@ -0,0 +1,194 @@
+#include "../include/lowlat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+#define LOWLAT_ISOLATED_PATH "/sys/devices/system/cpu/isolated"
+
+// 各项设置的结果（第一次失败的errno，0表示成功），用于启动信息
+static int busy_poll_err;
+static int prefer_busy_poll_err;
+static int mlock_err;
+static int mlock_done;
+
+void lowlat_defaults(lowlat_t *ll) {
+    memset(ll, 0, sizeof(*ll));
+    ll->busy_poll_us = LOWLAT_DEFAULT_BUSY_POLL_US;
+}
+
+int lowlat_parse_cpus(const char *list, int *cpus, int max) {
+    int n = 0;
+    const char *p = list;
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            return -1;
+        }
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return -1;
+            }
+        }
+        for (long cpu = first; cpu <= last && n < max; cpu++) {
+            cpus[n++] = (int)cpu;
+        }
+        p = end;
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0' && *p != '\n') {
+            return -1;
+        }
+    }
+    return n;
+}
+
+void lowlat_select_cpus(lowlat_t *ll) {
+    if (ll->num_cpus > 0) {
+        ll->cpu_source = "CPUs from --cpus";
+        return;
+    }
+    ll->cpu_source = "online CPUs (none isolated)";
+    FILE *fp = fopen(LOWLAT_ISOLATED_PATH, "r");
+    if (!fp) {
+        return;
+    }
+    char line[256];
+    if (fgets(line, sizeof(line), fp)) {
+        int n = lowlat_parse_cpus(line, ll->cpus, LOWLAT_MAX_CPUS);
+        if (n > 0) {
+            ll->num_cpus = n;
+            ll->cpu_source = "isolated CPUs";
+        }
+    }
+    fclose(fp);
+}
+
+int lowlat_cpu(const lowlat_t *ll, int index) {
+    if (ll->num_cpus > 0) {
+        return ll->cpus[index % ll->num_cpus];
+    }
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return (int)(index % (online > 0 ? online : 1));
+}
+
+// 提高忙轮询时长需要CAP_NET_ADMIN，失败时保留非阻塞自旋接收
+int lowlat_socket(int sockfd, int busy_poll_us) {
+    int ret = 0;
+    int prefer = busy_poll_us > 0;
+    int budget = LOWLAT_BUSY_POLL_BUDGET;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) < 0) {
+        if (busy_poll_err == 0) {
+            busy_poll_err = errno;
+        }
+        ret = -1;
+    }
+    if (setsockopt(sockfd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) < 0) {
+        if (prefer_busy_poll_err == 0) {
+            prefer_busy_poll_err = errno;
+        }
+        ret = -1;
+    }
+    if (prefer) {
+        setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL_BUDGET, &budget, sizeof(budget));
+    }
+    return ret;
+}
+
+void lowlat_thread(int rt_prio, const char *role) {
+    if (rt_prio <= 0) {
+        return;
+    }
+    struct sched_param param = { .sched_priority = rt_prio };
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0) {
+        fprintf(stderr, "Warning: Failed to set SCHED_FIFO priority %d for %s thread: %s\n",
+                rt_prio, role, strerror(err));
+    }
+}
+
+int lowlat_lock_memory(void) {
+    mlock_done = 1;
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        mlock_err = errno;
+        return -1;
+    }
+    return 0;
+}
+
+void lowlat_prefault(void *buf, size_t len) {
+    if (!buf) {
+        return;
+    }
+    volatile char *p = buf;
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) {
+        page = 4096;
+    }
+    for (size_t off = 0; off < len; off += (size_t)page) {
+        p[off] = p[off];
+    }
+    if (len > 0) {
+        p[len - 1] = p[len - 1];
+    }
+}
+
+void lowlat_print_info(const lowlat_t *ll, int threads) {
+    if (!ll->enabled) {
+        return;
+    }
+    printf("Low-latency mode: spinning non-blocking receive, threads pinned to %s",
+           ll->cpu_source ? ll->cpu_source : "online CPUs");
+    if (ll->num_cpus > 0) {
+        printf(" (");
+        for (int i = 0; i < ll->num_cpus && i < 8; i++) {
+            printf("%s%d", i > 0 ? "," : "", ll->cpus[i]);
+        }
+        printf("%s)", ll->num_cpus > 8 ? ",..." : "");
+    }
+    printf("\n");
+    if (ll->busy_poll_us == 0) {
+        printf("  Busy poll: off\n");
+    } else if (busy_poll_err == 0) {
+        printf("  Busy poll: SO_BUSY_POLL %d us%s\n", ll->busy_poll_us,
+               prefer_busy_poll_err == 0 ? ", SO_PREFER_BUSY_POLL" : "");
+    } else {
+        printf("  Busy poll: unavailable (%s), receive still spins in user space\n", strerror(busy_poll_err));
+    }
+    if (ll->busy_poll_us > 0 && busy_poll_err == 0 && prefer_busy_poll_err != 0) {
+        printf("  SO_PREFER_BUSY_POLL unavailable: %s\n", strerror(prefer_busy_poll_err));
+    }
+    if (ll->rt_prio > 0) {
+        printf("  Scheduling: SCHED_FIFO priority %d\n", ll->rt_prio);
+        long cpus = ll->num_cpus > 0 ? ll->num_cpus : sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpus < threads) {
+            fprintf(stderr, "Warning: %d SCHED_FIFO threads share %ld CPUs; threads spinning on the same CPU "
+                    "starve each other (use --cpus with enough isolated cores)\n", threads, cpus);
+        }
+    }
+    if (mlock_done) {
+        if (mlock_err == 0) {
+            printf("  Memory: locked (mlockall), buffers pre-faulted\n");
+        } else {
+            printf("  Memory: mlockall failed (%s), buffers pre-faulted only\n", strerror(mlock_err));
+        }
+    } else {
+        printf("  Memory: buffers pre-faulted\n");
+    }
+}
@@ -0,0 +1,136 @@
+#include "../include/common.h"
+#include "../include/pacer.h"
+#include "../include/tsc.h"
+
+// 截止时间按周期计数器时钟（近似CLOCK_MONOTONIC_RAW）计算，忙等尾段每次读取只需几纳秒
+static uint64_t monotonic_ns(void) {
+    return tsc_now_ns();
+}
+
+// 解析速率字符串
+int parse_rate(const char *str, int pkt_bytes, double *rate_pps) {
+    char *end;
+    double value = strtod(str, &end);
+    if (end == str || value < 0) {
+        return -1;
+    }
+    
+    double scale = 1.0;
+    switch (*end) {
+        case 'k': case 'K': scale = 1e3; end++; break;
+        case 'm': case 'M': scale = 1e6; end++; break;
+        case 'g': case 'G': scale = 1e9; end++; break;
+        default: break;
+    }
+    value *= scale;
+    
+    if (*end == '\0' || strcasecmp(end, "pps") == 0) {
+        *rate_pps = value;
+        return 0;
+    }
+    if (strcasecmp(end, "bps") == 0) {
+        if (pkt_bytes <= 0) {
+            return -1;
+        }
+        *rate_pps = value / (pkt_bytes * 8.0);
+        return 0;
+    }
+    return -1;
+}
+
+// 初始化速率控制器
+void pacer_init(pacer_t *pacer, double rate_pps, int burst_size) {
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->rate_pps = rate_pps;
+    pacer->burst_size = burst_size > 0 ? burst_size : 1;
+    if (rate_pps > 0) {
+        pacer->interval_ns = pacer->burst_size * 1e9 / rate_pps;
+    }
+}
+
+// 开始计时：第一个突发的截止时间即为当前时刻
+void pacer_start(pacer_t *pacer) {
+    pacer->start_ns = monotonic_ns();
+    pacer->end_ns = pacer->start_ns;
+    pacer->bursts = 0;
+    pacer->total_error_ns = 0;
+    pacer->max_error_ns = 0;
+}
+
+// 等待到下一个突发的截止时间
+// 截止时间由起始时间和突发序号直接计算，不会累积漂移；落后时立即发送以追上计划
+void pacer_wait(pacer_t *pacer) {
+    if (pacer->rate_pps <= 0) {
+        return;
+    }
+    
+    uint64_t deadline = pacer->start_ns + (uint64_t)(pacer->bursts * pacer->interval_ns);
+    pacer->bursts++;
+    
+    uint64_t now = monotonic_ns();
+    if (now + PACER_SPIN_NS < deadline) {
+        // 睡眠时长相对当前时刻计算；截止时间本身是绝对的，唤醒误差不会累积
+        uint64_t sleep_ns = deadline - PACER_SPIN_NS - now;
+        struct timespec ts;
+        ts.tv_sec = sleep_ns / 1000000000ULL;
+        ts.tv_nsec = sleep_ns % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR) {
+        }
+        now = monotonic_ns();
+    }
+    
+    // 忙等尾段：避免睡眠唤醒抖动影响亚10μs的间隔
+    while (now < deadline) {
+        now = monotonic_ns();
+    }
+    
+    uint64_t error = now - deadline;
+    pacer->total_error_ns += error;
+    if (error > pacer->max_error_ns) {
+        pacer->max_error_ns = error;
+    }
+}
+
+// 记录发送结束时间
+void pacer_finish(pacer_t *pacer) {
+    pacer->end_ns = monotonic_ns();
+}
+
+// 合并并行发送流的节拍统计：目标速率相加，发送时间范围取并集
+void pacer_merge(pacer_t *dst, const pacer_t *src) {
+    dst->rate_pps += src->rate_pps;
+    if (src->start_ns < dst->start_ns) {
+        dst->start_ns = src->start_ns;
+    }
+    if (src->end_ns > dst->end_ns) {
+        dst->end_ns = src->end_ns;
+    }
+    dst->bursts += src->bursts;
+    dst->total_error_ns += src->total_error_ns;
+    if (src->max_error_ns > dst->max_error_ns) {
+        dst->max_error_ns = src->max_error_ns;
+    }
+}
+
+// 打印目标速率与实际速率对比以及节拍误差
+void pacer_print_report(const pacer_t *pacer, uint64_t packets_sent, uint64_t bytes_sent) {
+    double elapsed_sec = (pacer->end_ns - pacer->start_ns) / 1e9;
+    double achieved_pps = elapsed_sec > 0 ? packets_sent / elapsed_sec : 0.0;
+    double achieved_mbps = elapsed_sec > 0 ? bytes_sent * 8.0 / elapsed_sec / 1000000.0 : 0.0;
+    
+    if (pacer->rate_pps > 0) {
+        double requested_mbps = packets_sent > 0 ?
+            pacer->rate_pps * (bytes_sent * 8.0 / packets_sent) / 1000000.0 : 0.0;
+        printf("目标发送速率: %.0f pps (%.2f Mbps), 突发大小: %d\n",
+               pacer->rate_pps, requested_mbps, pacer->burst_size);
+        printf("实际发送速率: %.0f pps (%.2f Mbps), 达成率: %.1f%%\n",
+               achieved_pps, achieved_mbps, achieved_pps / pacer->rate_pps * 100.0);
+        if (pacer->bursts > 0) {
+            printf("节拍误差: 平均 %.2f μs, 最大 %.2f μs\n",
+                   pacer->total_error_ns / 1000.0 / pacer->bursts,
+                   pacer->max_error_ns / 1000.0);
+        }
+    } else {
+        printf("实际发送速率: %.0f pps (%.2f Mbps)（不限速）\n", achieved_pps, achieved_mbps);
+    }
+}
@@ -0,0 +1,108 @@
+#include "../include/pipeline.h"
+
+// 环容量向上取整为2的幂
+static int spsc_init(spsc_ring_t *ring, uint32_t capacity) {
+    memset(ring, 0, sizeof(*ring));
+    uint32_t cap = 1;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+    ring->slots = calloc(cap, sizeof(uint32_t));
+    if (!ring->slots) {
+        return -1;
+    }
+    ring->mask = cap - 1;
+    return 0;
+}
+
+int pipe_init(pipe_t *pipe, int num_workers, uint32_t pool_size, uint32_t slot_size) {
+    memset(pipe, 0, sizeof(*pipe));
+    buf_pool_t *pool = &pipe->pool;
+    pool->slot_size = (slot_size + CACHE_LINE_SIZE - 1) & ~(uint32_t)(CACHE_LINE_SIZE - 1);
+    pool->count = pool_size;
+    if (posix_memalign((void **)&pool->slab, 4096, (size_t)pool_size * pool->slot_size) != 0) {
+        pool->slab = NULL;
+    }
+    pool->lens = calloc(pool_size, sizeof(uint32_t));
+    pool->addrs = calloc(pool_size, sizeof(struct sockaddr_in));
+    pool->free_stack = malloc(pool_size * sizeof(uint32_t));
+    
+    // 环按缓存行对齐分配（生产者和消费者下标不能与相邻环共享缓存行）
+    pipe->num_workers = num_workers;
+    // posix_memalign()不清零，分配后立即清零，任何一步失败时pipe_free()都只会释放NULL的环槽
+    if (posix_memalign((void **)&pipe->work, CACHE_LINE_SIZE, num_workers * sizeof(spsc_ring_t)) != 0) {
+        pipe->work = NULL;
+    } else {
+        memset(pipe->work, 0, num_workers * sizeof(spsc_ring_t));
+    }
+    if (posix_memalign((void **)&pipe->done, CACHE_LINE_SIZE, num_workers * sizeof(spsc_ring_t)) != 0) {
+        pipe->done = NULL;
+    } else {
+        memset(pipe->done, 0, num_workers * sizeof(spsc_ring_t));
+    }
+    pipe->ring_stats = calloc(num_workers, sizeof(pipe_ring_stats_t));
+    if (!pool->slab || !pool->lens || !pool->addrs || !pool->free_stack ||
+        !pipe->work || !pipe->done || !pipe->ring_stats) {
+        fprintf(stderr, "Error: Failed to allocate receive pipeline (%u x %u byte buffers)\n",
+                pool_size, pool->slot_size);
+        pipe_free(pipe);
+        return -1;
+    }
+    
+    // 每条环的容量都不小于槽数：在途槽位总数不超过槽数，推入时无需检查满
+    for (int i = 0; i < num_workers; i++) {
+        if (spsc_init(&pipe->work[i], pool_size) < 0 || spsc_init(&pipe->done[i], pool_size) < 0) {
+            fprintf(stderr, "Error: Failed to allocate pipeline rings\n");
+            pipe_free(pipe);
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < pool_size; i++) {
+        pool->free_stack[i] = pool_size - 1 - i;
+    }
+    pool->free_count = pool_size;
+    pool->min_free = pool_size;
+    atomic_store(&pipe->io_done, 0);
+    return 0;
+}
+
+void pipe_free(pipe_t *pipe) {
+    for (int i = 0; i < pipe->num_workers; i++) {
+        if (pipe->work) {
+            free(pipe->work[i].slots);
+        }
+        if (pipe->done) {
+            free(pipe->done[i].slots);
+        }
+    }
+    free(pipe->work);
+    free(pipe->done);
+    free(pipe->ring_stats);
+    free(pipe->pool.slab);
+    free(pipe->pool.lens);
+    free(pipe->pool.addrs);
+    free(pipe->pool.free_stack);
+    memset(pipe, 0, sizeof(*pipe));
+}
+
+void pipe_reclaim(pipe_t *pipe) {
+    buf_pool_t *pool = &pipe->pool;
+    for (int i = 0; i < pipe->num_workers; i++) {
+        pool->free_count += spsc_pop_batch(&pipe->done[i], pool->free_stack + pool->free_count,
+                                           pool->count - pool->free_count);
+    }
+}
+
+void pipe_print_report(const pipe_t *pipe, int label) {
+    const buf_pool_t *pool = &pipe->pool;
+    printf("流水线[%d] 缓冲池: %u 槽 x %u 字节, 峰值使用 %u (%.1f%%), 耗尽 %lu 次, 截断的数据报 %lu\n",
+           label, pool->count, pool->slot_size, pool->count - pool->min_free,
+           (pool->count - pool->min_free) * 100.0 / pool->count, pool->exhausted, pool->truncated);
+    printf("流水线[%d] 处理环占用:", label);
+    for (int i = 0; i < pipe->num_workers; i++) {
+        const pipe_ring_stats_t *st = &pipe->ring_stats[i];
+        printf(" [%d] 平均 %.1f 峰值 %u", i,
+               st->samples > 0 ? (double)st->occupancy_sum / st->samples : 0.0, st->peak);
+    }
+    printf("\n");
+}
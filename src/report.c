@@ -0,0 +1,198 @@
+#include "../include/report.h"
+#include "../include/common.h"
+#include "../include/tsc.h"
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *report_fields =
+    "ts,role,round,elapsed_s,interval_s,tx_pps,tx_mbps,rx_pps,rx_mbps,lost,loss_pct,"
+    "reordered,socket_drops,lat_samples,lat_p50_us,lat_p99_us,lat_p999_us,lat_max_us";
+
+void report_defaults(report_t *r) {
+    memset(r, 0, sizeof(*r));
+    r->interval_ms = REPORT_DEFAULT_INTERVAL_MS;
+}
+
+int report_parse_format(const char *str, report_format_t *format) {
+    if (strcmp(str, "json") == 0 || strcmp(str, "jsonl") == 0) {
+        *format = REPORT_JSON;
+    } else if (strcmp(str, "csv") == 0) {
+        *format = REPORT_CSV;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int report_open(report_t *r, const char *role) {
+    r->role = role;
+    if (r->format == REPORT_OFF) {
+        return 0;
+    }
+    // 报告独占标准输出：复制一份描述符给报告，再把标准输出指向标准错误，
+    // 启动信息、进度、[REPORT]行和日志都改到标准错误，管道另一端只收到报告
+    if (r->path == NULL || strcmp(r->path, "-") == 0) {
+        fflush(stdout);
+        int fd = dup(STDOUT_FILENO);
+        r->out = fd >= 0 ? fdopen(fd, "w") : NULL;
+        if (!r->out || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            fprintf(stderr, "Error: Cannot redirect standard output for the report: %s\n", strerror(errno));
+            if (r->out) {
+                fclose(r->out);
+            } else if (fd >= 0) {
+                close(fd);
+            }
+            r->out = NULL;
+            return -1;
+        }
+        setvbuf(stdout, NULL, _IOLBF, 0);
+        return 0;
+    }
+    r->out = fopen(r->path, "w");
+    if (!r->out) {
+        fprintf(stderr, "Error: Cannot open report file '%s': %s\n", r->path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t counter_delta(uint64_t cur, uint64_t prev) {
+    return cur > prev ? cur - prev : 0;
+}
+
+// 采样一次并输出自上次采样以来的区间
+static void report_emit(report_t *r, uint64_t now_ns) {
+    memset(&r->cur, 0, sizeof(r->cur));
+    r->sample(r->arg, &r->cur);
+    
+    const report_sample_t *c = &r->cur;
+    const report_sample_t *p = &r->prev;
+    double interval = (now_ns - r->last_ns) / 1e9;
+    double elapsed = (now_ns - r->start_ns) / 1e9;
+    uint64_t tx = counter_delta(c->packets_sent, p->packets_sent);
+    uint64_t rx = counter_delta(c->packets_received, p->packets_received);
+    uint64_t lost = counter_delta(c->packets_lost, p->packets_lost);
+    double tx_pps = tx / interval;
+    double rx_pps = rx / interval;
+    double tx_mbps = counter_delta(c->bytes_sent, p->bytes_sent) * 8.0 / interval / 1e6;
+    double rx_mbps = counter_delta(c->bytes_received, p->bytes_received) * 8.0 / interval / 1e6;
+    double loss_pct = rx + lost > 0 ? lost * 100.0 / (rx + lost) : 0.0;
+    
+    latency_hist_t hist;
+    hist_delta(&hist, &c->latency, &p->latency);
+    double p50 = hist_value_at_percentile(&hist, 50.0) / 1e3;
+    double p99 = hist_value_at_percentile(&hist, 99.0) / 1e3;
+    double p999 = hist_value_at_percentile(&hist, 99.9) / 1e3;
+    double max = hist_value_at_percentile(&hist, 100.0) / 1e3;
+    
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    double ts = wall.tv_sec + wall.tv_nsec / 1e9;
+    
+    if (r->format == REPORT_JSON) {
+        fprintf(r->out,
+                "{\"ts\":%.3f,\"role\":\"%s\",\"round\":%d,\"elapsed_s\":%.3f,\"interval_s\":%.3f,"
+                "\"tx_pps\":%.0f,\"tx_mbps\":%.3f,\"rx_pps\":%.0f,\"rx_mbps\":%.3f,"
+                "\"lost\":%lu,\"loss_pct\":%.4f,\"reordered\":%lu,\"socket_drops\":%lu,"
+                "\"lat_samples\":%lu,\"lat_p50_us\":%.3f,\"lat_p99_us\":%.3f,\"lat_p999_us\":%.3f,"
+                "\"lat_max_us\":%.3f}\n",
+                ts, r->role, r->round, elapsed, interval, tx_pps, tx_mbps, rx_pps, rx_mbps,
+                lost, loss_pct, counter_delta(c->reordered, p->reordered),
+                counter_delta(c->socket_drops, p->socket_drops),
+                hist.total_count, p50, p99, p999, max);
+    } else {
+        if (!r->header_done) {
+            fprintf(r->out, "%s\n", report_fields);
+            r->header_done = 1;
+        }
+        fprintf(r->out, "%.3f,%s,%d,%.3f,%.3f,%.0f,%.3f,%.0f,%.3f,%lu,%.4f,%lu,%lu,%lu,%.3f,%.3f,%.3f,%.3f\n",
+                ts, r->role, r->round, elapsed, interval, tx_pps, tx_mbps, rx_pps, rx_mbps,
+                lost, loss_pct, counter_delta(c->reordered, p->reordered),
+                counter_delta(c->socket_drops, p->socket_drops),
+                hist.total_count, p50, p99, p999, max);
+    }
+    fflush(r->out);
+    
+    r->prev = r->cur;
+    r->last_ns = now_ns;
+}
+
+// 按绝对截止时间推进区间；采样落后超过一个间隔时不补发，从当前时刻重新计时
+static void *report_thread_main(void *arg) {
+    report_t *r = (report_t *)arg;
+    uint64_t interval_ns = (uint64_t)r->interval_ms * 1000000ULL;
+    uint64_t next = r->start_ns + interval_ns;
+    while (!atomic_load_explicit(&r->stop, memory_order_acquire)) {
+        uint64_t now = tsc_now_ns();
+        if (now < next) {
+            uint64_t wait_ns = next - now;
+            if (wait_ns > (uint64_t)REPORT_POLL_MS * 1000000ULL) {
+                wait_ns = (uint64_t)REPORT_POLL_MS * 1000000ULL;
+            }
+            usleep((useconds_t)(wait_ns / 1000));
+            continue;
+        }
+        report_emit(r, now);
+        next += interval_ns;
+        if (next <= now) {
+            next = now + interval_ns;
+        }
+    }
+    return NULL;
+}
+
+int report_start(report_t *r, report_sample_fn sample, void *arg, int round) {
+    if (r->format == REPORT_OFF) {
+        return 0;
+    }
+    r->sample = sample;
+    r->arg = arg;
+    r->round = round;
+    memset(&r->prev, 0, sizeof(r->prev));
+    sample(arg, &r->prev);
+    r->start_ns = tsc_now_ns();
+    r->last_ns = r->start_ns;
+    atomic_store(&r->stop, 0);
+    
+    int err = start_background_thread(&r->thread, report_thread_main, r);
+    if (err != 0) {
+        fprintf(stderr, "Warning: Failed to start report thread: %s\n", strerror(err));
+        return -1;
+    }
+    r->running = 1;
+    return 0;
+}
+
+void report_stop(report_t *r) {
+    if (!r->running) {
+        return;
+    }
+    atomic_store_explicit(&r->stop, 1, memory_order_release);
+    pthread_join(r->thread, NULL);
+    r->running = 0;
+    
+    // 最后一个区间不足一个间隔也输出，使最后的计数不遗漏
+    uint64_t now = tsc_now_ns();
+    if (now - r->last_ns >= 1000000ULL) {
+        report_emit(r, now);
+    }
+}
+
+void report_close(report_t *r) {
+    report_stop(r);
+    if (r->out) {
+        fclose(r->out);
+    }
+    r->out = NULL;
+}
+
+void report_print_info(const report_t *r) {
+    if (r->format == REPORT_OFF) {
+        return;
+    }
+    printf("Interval report: %s every %d ms to %s\n", r->format == REPORT_JSON ? "JSON Lines" : "CSV",
+           r->interval_ms, (r->path == NULL || strcmp(r->path, "-") == 0) ?
+           "stdout (all other output on stderr)" : r->path);
+}
@@ -0,0 +1,194 @@
+#include "../include/seqwin.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int seqwin_init(seqwin_t *win, uint32_t size) {
+    memset(win, 0, sizeof(*win));
+    uint64_t n = 64;
+    while (n < size && n < (1ULL << 31)) {
+        n <<= 1;
+    }
+    win->bits = calloc(n / 64, sizeof(uint64_t));
+    if (!win->bits) {
+        fprintf(stderr, "Error: Failed to allocate sequence window (%lu entries)\n", n);
+        return -1;
+    }
+    win->size = n;
+    win->mask = n - 1;
+    return 0;
+}
+
+void seqwin_free(seqwin_t *win) {
+    free(win->bits);
+    memset(win, 0, sizeof(*win));
+}
+
+void seqwin_reset(seqwin_t *win) {
+    memset(win->bits, 0, win->size / 8);
+    win->started = 0;
+    win->first = win->top = win->in_window = 0;
+    memset(&win->stats, 0, sizeof(win->stats));
+}
+
+// 将32位序列号扩展为最接近top的64位序列号（处理回绕）
+static uint64_t seqwin_extend(uint64_t top, uint32_t seq_num) {
+    uint64_t ext = (top & ~0xFFFFFFFFULL) | seq_num;
+    if (ext > top + 0x80000000ULL && ext >= 0x100000000ULL) {
+        ext -= 0x100000000ULL;
+    } else if (ext + 0x80000000ULL < top) {
+        ext += 0x100000000ULL;
+    }
+    return ext;
+}
+
+// 窗口前移到ext：复用(top, ext]对应的槽位，被挤出的旧序列号若未收到则计为丢失
+static void seqwin_advance(seqwin_t *win, uint64_t ext) {
+    uint64_t count = ext - win->top;
+    if (count >= win->size) {
+        // 整个窗口滑出，且跳过的序列号从未进入过窗口
+        uint64_t lo = win->top >= win->first + win->size ? win->top - win->size + 1 : win->first;
+        win->stats.lost += (win->top - lo + 1 - win->in_window) + (count - win->size);
+        memset(win->bits, 0, win->size / 8);
+        win->in_window = 0;
+        win->top = ext;
+        return;
+    }
+    
+    // 挤出的序列号为s - size（s ∈ (top, ext]），只有不早于first的才是真实序列号；
+    // 更早的槽位从未被置位，按字统计置位数即可
+    uint64_t valid_from = win->first + win->size;
+    uint64_t valid = 0;
+    if (ext >= valid_from) {
+        valid = ext - (win->top + 1 > valid_from ? win->top + 1 : valid_from) + 1;
+    }
+    uint64_t set = 0;
+    uint64_t pos = win->top + 1;
+    for (uint64_t remaining = count; remaining > 0; ) {
+        uint32_t bit = pos & 63;
+        uint64_t n = 64 - bit < remaining ? 64 - bit : remaining;
+        uint64_t m = (n == 64) ? ~0ULL : ((1ULL << n) - 1) << bit;
+        uint64_t *word = &win->bits[(pos & win->mask) >> 6];
+        set += __builtin_popcountll(*word & m);
+        *word &= ~m;
+        pos += n;
+        remaining -= n;
+    }
+    win->stats.lost += valid - set;
+    win->in_window -= set;
+    win->top = ext;
+}
+
+seq_result_t seqwin_update(seqwin_t *win, uint32_t seq_num) {
+    if (!win->started) {
+        // 从2^32起编号，使首包之前（回绕前）的序列号也能扩展为正数
+        win->started = 1;
+        win->first = win->top = (1ULL << 32) | seq_num;
+        win->bits[(win->top & win->mask) >> 6] |= 1ULL << (seq_num & 63);
+        win->in_window = 1;
+        win->stats.received++;
+        return SEQ_IN_ORDER;
+    }
+    
+    uint64_t ext = seqwin_extend(win->top, seq_num);
+    uint64_t *word = &win->bits[(ext & win->mask) >> 6];
+    uint64_t bit = 1ULL << (ext & 63);
+    
+    if (ext > win->top) {
+        seq_result_t result = (ext == win->top + 1) ? SEQ_IN_ORDER : SEQ_GAP;
+        seqwin_advance(win, ext);
+        *word |= bit;
+        win->in_window++;
+        win->stats.received++;
+        return result;
+    }
+    
+    uint64_t distance = win->top - ext;
+    if (distance >= win->size) {
+        win->stats.late++;
+        return SEQ_LATE;
+    }
+    if (*word & bit) {
+        win->stats.duplicates++;
+        return SEQ_DUPLICATE;
+    }
+    
+    // 首包之前的序列号乱序到达：窗口起点前移（这些槽位尚未被复用过）
+    if (ext < win->first) {
+        win->first = ext;
+    }
+    *word |= bit;
+    win->in_window++;
+    win->stats.received++;
+    win->stats.reordered++;
+    if (distance > win->stats.max_distance) {
+        win->stats.max_distance = distance;
+    }
+    win->stats.reorder_hist[63 - __builtin_clzll(distance)]++;
+    return SEQ_REORDERED;
+}
+
+int seqwin_behind(const seqwin_t *win, uint32_t seq_num) {
+    return win->started && seqwin_extend(win->top, seq_num) < win->top;
+}
+
+// 窗口内仍缺失的序列号数
+static uint64_t seqwin_missing(const seqwin_t *win) {
+    if (!win->started) {
+        return 0;
+    }
+    uint64_t lo = win->top >= win->first + win->size ? win->top - win->size + 1 : win->first;
+    return win->top - lo + 1 - win->in_window;
+}
+
+uint64_t seqwin_lost(const seqwin_t *win) {
+    return win->stats.lost + seqwin_missing(win);
+}
+
+void seqwin_snapshot(const seqwin_t *win, seq_stats_t *out) {
+    *out = win->stats;
+    out->missing = seqwin_missing(win);
+}
+
+void seq_stats_merge(seq_stats_t *dst, const seq_stats_t *src) {
+    dst->received += src->received;
+    dst->lost += src->lost;
+    dst->reordered += src->reordered;
+    dst->duplicates += src->duplicates;
+    dst->late += src->late;
+    dst->missing += src->missing;
+    if (src->max_distance > dst->max_distance) {
+        dst->max_distance = src->max_distance;
+    }
+    for (int i = 0; i < SEQ_REORDER_BUCKETS; i++) {
+        dst->reorder_hist[i] += src->reorder_hist[i];
+    }
+}
+
+void seq_stats_print(const seq_stats_t *stats, const char *title) {
+    printf("%s: 丢失 %lu, 乱序 %lu (%.3f%%, 最大距离 %lu), 重复 %lu, 迟到(超出窗口) %lu\n",
+           title, stats->lost + stats->missing, stats->reordered,
+           stats->received > 0 ? stats->reordered * 100.0 / stats->received : 0.0,
+           stats->max_distance, stats->duplicates, stats->late);
+    seq_print_reorder_hist(stats);
+}
+
+void seq_print_reorder_hist(const seq_stats_t *stats) {
+    if (stats->reordered == 0) {
+        return;
+    }
+    printf("乱序距离分布:");
+    for (int i = 0; i < SEQ_REORDER_BUCKETS; i++) {
+        if (stats->reorder_hist[i] == 0) {
+            continue;
+        }
+        uint64_t lo = 1ULL << i;
+        uint64_t hi = (2ULL << i) - 1;
+        if (lo == hi) {
+            printf(" [%lu]=%lu", lo, stats->reorder_hist[i]);
+        } else {
+            printf(" [%lu-%lu]=%lu", lo, hi, stats->reorder_hist[i]);
+        }
+    }
+    printf("\n");
+}
@@ -1,4 +1,36 @@
 #include "../include/common.h"
+#include "../include/timestamping.h"
+#include "../include/uring.h"
+#include "../include/xdp.h"
+#include "../include/flowtab.h"
+#include "../include/pipeline.h"
+#include "../include/log.h"
+#include "../include/tsc.h"
+#include "../include/lowlat.h"
+#include "../include/sockbuf.h"
+#include "../include/report.h"
+#include "../include/shmstats.h"
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <netinet/udp.h>
+#include <net/if.h>
+
+#define MAX_SERVER_THREADS 64
+#define SERVER_REPORT_INTERVAL_MS 1000   // 多线程模式下汇总报告的周期
+#define WORKER_RECV_TIMEOUT_MS 100       // 工作线程接收超时，用于及时响应退出和报告请求
+
+// io_uring请求标识：多发接收，或回送（低32位为缓冲区ID）
+#define URING_UD_RECV 0ULL
+#define URING_UD_SEND (1ULL << 32)
+
+#define GSO_CONTROL_LEN CMSG_SPACE(sizeof(uint16_t))   // 回送GRO超级数据报时的UDP_SEGMENT控制消息
+
+#define XSK_RX_BATCH 64   // AF_XDP每次从接收环取出的最大描述符数
+
+#define PIPE_POP_BATCH 64        // 处理线程每次从处理环取出的最大槽位数
+#define PIPE_SPIN_LOOPS 1000     // 处理环为空时先让出CPU自旋的次数，之后短暂休眠
+#define PIPE_IDLE_SLEEP_US 50
 
 static volatile int running = 1;
 
@@ -7,20 +39,1112 @@ void signal_handler(int sig) {
     running = 0;
 }
 
-int main(int argc, char *argv[]) {
+// 批量接收上下文：预分配的mmsghdr/iovec/缓冲区数组，供recvmsg()/recvmmsg()复用
+typedef struct {
+    int batch_size;
+    struct mmsghdr *msgs;
+    struct iovec *iovecs;
+    struct sockaddr_in *addrs;
+    char *buffers;
+    char *controls;           // 每个包的cmsg缓冲区（接收时间戳、GRO段大小、socket丢弃计数）
+    size_t *control_lens;     // 回送期间暂存的接收控制消息长度
+    int *gro_sizes;           // 每个数据报的GRO段大小，0表示未合并
+    char *send_controls;      // 回送用的UDP_SEGMENT控制消息
+} recv_batch_t;
+
+// 接收上下文：每个接收线程一份（socket、统计信息和序列号状态），按缓存行对齐避免伪共享
+typedef struct __attribute__((aligned(CACHE_LINE_SIZE))) {
     int sockfd;
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    char buffer[MAX_BUFFER_SIZE];
+    int perf_test_mode;
+    int echo_mode;                 // 反射模式：把收到的包原样回送给发送端
+    int io_backend;                // IO_BACKEND_SOCKET、IO_BACKEND_URING 或 IO_BACKEND_XDP
+    int gro;                       // 是否启用UDP_GRO合并接收
+    uint64_t gro_datagrams;        // 收到的GRO合并数据报数
+    uint64_t gro_segments;         // 合并数据报中拆分出的包数
+    int ts_mode;                   // 实际生效的时间戳模式（TS_MODE_*）
+    int verbose;                   // 性能测试模式下是否每100包打印进度
+    int publish;                   // 是否响应周期报告请求发布统计快照
+    int cpu;                       // 绑定的CPU核，-1表示不绑定
+    sockbuf_stats_t sockbuf;       // 接收socket的丢弃计数与缓冲区自动调整状态
+    int spin;                      // 低延迟模式：非阻塞自旋接收，不在recvmsg()中睡眠
+    int rt_prio;                   // 低延迟模式的SCHED_FIFO优先级，0表示不切换
+    int busy_poll_us;              // 低延迟模式的SO_BUSY_POLL时长，0表示不设置
+    stats_t stats;
+    flowtab_t flows;               // 按发送端区分的流表（每流独立的序列号窗口与延迟统计）
+    ts_breakdown_t *ts_breakdown;  // 仅在启用时间戳时分配
+    recv_batch_t batch;
+    xsk_t *xsk;                    // AF_XDP socket（仅xdp后端）
+    uint64_t xdp_invalid;          // AF_XDP收到的无法解析为IPv4/UDP的帧数
+    pipe_t *pipe;                  // 接收流水线（仅--pipeline），I/O线程与其处理线程共享
+    int pipe_worker;               // 处理线程在流水线中的序号，-1表示I/O线程
+    pthread_t thread;
+    
+    // 统计快照：工作线程在看到新的报告周期时发布，主线程读取汇总（独占缓存行）
+    pthread_mutex_t snapshot_lock __attribute__((aligned(CACHE_LINE_SIZE)));
+    unsigned snapshot_gen;
+    stats_t snapshot;
+    
+    // 共享内存实时统计（仅--shm）：工作线程在看到新的发布周期时写入自己的槽位
+    shmstats_t *shm;
+    shmstats_thread_t *shm_slot;
+    unsigned shm_gen;
+} server_ctx_t;
+
+// 报告周期编号：主线程递增，工作线程发现变化后发布一次统计快照
+static atomic_uint report_gen;
+
+// CLOCK_TAI与CLOCK_REALTIME的差值（纳秒），用于把内核软件时间戳换算到发送端的TAI时钟
+static int64_t tai_offset_ns = 0;
+
+// 初始化批量接收上下文
+static int recv_batch_init(recv_batch_t *batch, int batch_size) {
+    memset(batch, 0, sizeof(*batch));
+    batch->batch_size = batch_size;
+    batch->msgs = calloc(batch_size, sizeof(struct mmsghdr));
+    batch->iovecs = calloc(batch_size, sizeof(struct iovec));
+    batch->addrs = calloc(batch_size, sizeof(struct sockaddr_in));
+    batch->buffers = malloc((size_t)batch_size * MAX_BUFFER_SIZE);
+    batch->controls = calloc(batch_size, TS_CONTROL_LEN);
+    batch->control_lens = calloc(batch_size, sizeof(size_t));
+    batch->gro_sizes = calloc(batch_size, sizeof(int));
+    batch->send_controls = calloc(batch_size, GSO_CONTROL_LEN);
+    
+    if (!batch->msgs || !batch->iovecs || !batch->addrs || !batch->buffers || !batch->controls ||
+        !batch->control_lens || !batch->gro_sizes || !batch->send_controls) {
+        fprintf(stderr, "Error: Failed to allocate receive batch (%d packets)\n", batch_size);
+        return -1;
+    }
+    
+    for (int i = 0; i < batch_size; i++) {
+        batch->iovecs[i].iov_base = batch->buffers + (size_t)i * MAX_BUFFER_SIZE;
+        batch->iovecs[i].iov_len = MAX_BUFFER_SIZE;
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iovecs[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+        batch->msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+    }
+    return 0;
+}
+
+// 释放批量接收上下文
+static void recv_batch_free(recv_batch_t *batch) {
+    free(batch->msgs);
+    free(batch->iovecs);
+    free(batch->addrs);
+    free(batch->buffers);
+    free(batch->controls);
+    free(batch->control_lens);
+    free(batch->gro_sizes);
+    free(batch->send_controls);
+    memset(batch, 0, sizeof(*batch));
+}
+
+// 重置每个消息头中会被内核改写的字段（每次接收前调用）
+// 控制消息缓冲区始终提供：SO_RXQ_OVFL丢弃计数在队列溢出后随每个包到达
+static void recv_batch_prepare(recv_batch_t *batch, int count) {
+    for (int i = 0; i < count; i++) {
+        struct msghdr *hdr = &batch->msgs[i].msg_hdr;
+        batch->iovecs[i].iov_len = MAX_BUFFER_SIZE;
+        hdr->msg_namelen = sizeof(struct sockaddr_in);
+        hdr->msg_flags = 0;
+        hdr->msg_control = batch->controls + (size_t)i * TS_CONTROL_LEN;
+        hdr->msg_controllen = TS_CONTROL_LEN;
+    }
+}
+
+// 根据内核接收时间戳记录延迟分解
+static void record_rx_timestamps(server_ctx_t *ctx, const struct msghdr *msg,
+                                 const perf_header_t *hdr) {
+    kernel_ts_t rx_ts;
+    if (ts_get_rx(msg, &rx_ts) < 0 || rx_ts.sw_ns == 0) {
+        return;
+    }
+    
+    uint64_t app_ns = ts_realtime_ns();
+    if (app_ns >= rx_ts.sw_ns) {
+        hist_record(&ctx->ts_breakdown->kernel_rx_to_app, app_ns - rx_ts.sw_ns);
+    }
+    
+    // 发送端应用时间戳为墙上时间或TAI时，可计算发送端应用到本机内核接收的时间
+    uint64_t kernel_rx_ns;
+    if (hdr->clock_id == PERF_CLOCK_REALTIME) {
+        kernel_rx_ns = rx_ts.sw_ns;
+    } else if (hdr->clock_id == PERF_CLOCK_TAI) {
+        kernel_rx_ns = rx_ts.sw_ns + tai_offset_ns;
+    } else {
+        return;
+    }
+    if (kernel_rx_ns >= hdr->timestamp_ns) {
+        hist_record(&ctx->ts_breakdown->wire, kernel_rx_ns - hdr->timestamp_ns);
+    }
+}
+
+// 处理一个接收到的数据包：更新统计、丢包检测、延迟计算
+static void process_packet(server_ctx_t *ctx, const char *buffer, ssize_t recv_len,
+                           const struct sockaddr_in *client_addr, const struct msghdr *msg) {
+    stats_t *stats = &ctx->stats;
+    stats->packets_received++;
+    stats->bytes_received += recv_len;
+    
+    char client_ip[INET_ADDRSTRLEN];
+    perf_header_t hdr;
+    
+    // 如果是性能测试模式（同时兼容v2和v1旧格式）
+    if (ctx->perf_test_mode && perf_packet_parse(buffer, recv_len, &hdr) == 0) {
+        // 计算延迟（从发送时间戳到接收时间的延迟），接收时间取自发送端声明的同一时钟源
+        uint64_t recv_time_ns = get_time_ns(hdr.clock_id);
+        
+        // 按源地址、端口和流ID找到所属的流，多个发送端的序列号互不干扰
+        // 流的空闲时间用单调时钟计算（发送端使用单调时钟时直接复用接收时间）
+        flow_key_t key = { .addr = client_addr->sin_addr.s_addr, .port = client_addr->sin_port,
+                           .flow_id = hdr.flow_id };
+        uint64_t now_ns = (hdr.clock_id == PERF_CLOCK_MONOTONIC_RAW) ?
+                          recv_time_ns : get_time_ns(PERF_CLOCK_MONOTONIC_RAW);
+        flow_t *flow = flowtab_lookup(&ctx->flows, &key, now_ns);
+        
+        // 丢包检测：各流滑动窗口内缺失的序列号暂计为丢失，乱序补到后即扣除
+        if (flow) {
+            flow->packets++;
+            flow->bytes += recv_len;
+            flowtab_record_seq(&ctx->flows, flow, hdr.seq_num, hdr.timestamp_ns);
+        }
+        stats->packets_lost = ctx->flows.lost;
+        
+        // 接收时间早于发送时间说明两端时钟不同步，不计入延迟统计
+        if (recv_time_ns >= hdr.timestamp_ns) {
+            uint64_t latency_ns = recv_time_ns - hdr.timestamp_ns;
+            double latency_ms = latency_ns / 1000000.0;
+            if (stats->latency_hist.total_count == 0 || latency_ms < stats->min_latency_ms) {
+                stats->min_latency_ms = latency_ms;
+            }
+            if (latency_ms > stats->max_latency_ms) {
+                stats->max_latency_ms = latency_ms;
+            }
+            stats->total_latency_ms += latency_ms;
+            hist_record(&stats->latency_hist, latency_ns);
+            stats->avg_latency_ms = stats->total_latency_ms / stats->latency_hist.total_count;
+            if (flow) {
+                flow->latency_sum_ns += latency_ns;
+                hist_record(&flow->latency, latency_ns);
+            }
+        }
+        
+        if (ctx->ts_breakdown) {
+            record_rx_timestamps(ctx, msg, &hdr);
+        }
+        
+        // 性能测试模式下，每100个包显示一次进度
+        if (ctx->verbose && stats->packets_received % 100 == 0) {
+            LOG_INFO("[RECV] From %s:%d, Packet #%u, Size: %zd bytes, "
+                     "Loss: %lu, Avg Latency: %.3f ms\n",
+                     inet_ntop(AF_INET, &client_addr->sin_addr, client_ip, INET_ADDRSTRLEN),
+                     ntohs(client_addr->sin_port), hdr.seq_num, recv_len,
+                     stats->packets_lost, stats->avg_latency_ms);
+        }
+    } else {
+        // 交互模式或非性能测试包：显示每次接收（超出日志限速的只计数）
+        LOG_INFO("[RECV] From %s:%d, Size: %zd bytes\n",
+                 inet_ntop(AF_INET, &client_addr->sin_addr, client_ip, INET_ADDRSTRLEN),
+                 ntohs(client_addr->sin_port), recv_len);
+    }
+}
+
+// 从控制消息中取出UDP_GRO段大小，未合并时返回0
+static int gro_segment_size(const struct msghdr *msg) {
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR((struct msghdr *)msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR((struct msghdr *)msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int seg_size;
+            memcpy(&seg_size, CMSG_DATA(cmsg), sizeof(seg_size));
+            return seg_size;
+        }
+    }
+    return 0;
+}
+
+// 数据报包含的包数（GRO合并数据报按段大小拆分，最后一段可能较短）
+static int datagram_segments(size_t len, int gro_size) {
+    if (gro_size <= 0 || len <= (size_t)gro_size) {
+        return 1;
+    }
+    return (int)((len + gro_size - 1) / gro_size);
+}
+
+// 在buf中构造UDP_SEGMENT控制消息，使合并数据报回送时由内核重新切分为原来的包
+static void build_gso_control(char *buf, int seg_size) {
+    memset(buf, 0, GSO_CONTROL_LEN);
+    struct cmsghdr *cmsg = (struct cmsghdr *)buf;
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t gso_size = (uint16_t)seg_size;
+    memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+}
+
+// 处理一个接收到的数据报：GRO合并的超级数据报在用户态按段大小拆分为独立的包
+static void process_datagram(server_ctx_t *ctx, char *buffer, size_t len,
+                             const struct sockaddr_in *client_addr, const struct msghdr *msg,
+                             int gro_size) {
+    sockbuf_note(&ctx->sockbuf, msg);
+    int segs = datagram_segments(len, gro_size);
+    if (segs == 1) {
+        process_packet(ctx, buffer, len, client_addr, msg);
+        return;
+    }
+    
+    ctx->gro_datagrams++;
+    ctx->gro_segments += segs;
+    for (size_t off = 0; off < len; off += gro_size) {
+        size_t seg_len = len - off < (size_t)gro_size ? len - off : (size_t)gro_size;
+        process_packet(ctx, buffer + off, seg_len, client_addr, msg);
+    }
+}
+
+// 反射收到的前count个包：复用接收用的mmsghdr原地回送（负载不拷贝，目的地址即接收时的源地址）
+// GRO合并的数据报附带UDP_SEGMENT原样切分回送；回送后恢复接收控制消息，供随后的统计读取
+static void reflect_batch(server_ctx_t *ctx, recv_batch_t *batch, int count) {
+    for (int i = 0; i < count; i++) {
+        struct msghdr *hdr = &batch->msgs[i].msg_hdr;
+        batch->control_lens[i] = hdr->msg_controllen;
+        batch->iovecs[i].iov_len = batch->msgs[i].msg_len;
+        if (datagram_segments(batch->msgs[i].msg_len, batch->gro_sizes[i]) > 1) {
+            hdr->msg_control = batch->send_controls + (size_t)i * GSO_CONTROL_LEN;
+            hdr->msg_controllen = GSO_CONTROL_LEN;
+            build_gso_control(hdr->msg_control, batch->gro_sizes[i]);
+        } else {
+            hdr->msg_control = NULL;
+            hdr->msg_controllen = 0;
+        }
+        hdr->msg_flags = 0;
+    }
+    
+    int sent = 0;
+    while (sent < count) {
+        int n;
+        if (count - sent == 1) {
+            ssize_t len = sendmsg(ctx->sockfd, &batch->msgs[sent].msg_hdr, 0);
+            if (len >= 0) {
+                batch->msgs[sent].msg_len = (unsigned int)len;
+            }
+            n = (len < 0) ? -1 : 1;
+        } else {
+            n = sendmmsg(ctx->sockfd, batch->msgs + sent, count - sent, 0);
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // 发送缓冲区满等错误：丢弃本批剩余的回送，不阻塞接收
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR("echo send failed: %s\n", strerror(errno));
+            }
+            break;
+        }
+        for (int i = sent; i < sent + n; i++) {
+            ctx->stats.bytes_sent += batch->msgs[i].msg_len;
+            ctx->stats.packets_sent += datagram_segments(batch->msgs[i].msg_len, batch->gro_sizes[i]);
+        }
+        sent += n;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        struct msghdr *hdr = &batch->msgs[i].msg_hdr;
+        hdr->msg_controllen = batch->control_lens[i];
+        hdr->msg_control = batch->control_lens[i] ? batch->controls + (size_t)i * TS_CONTROL_LEN : NULL;
+    }
+}
+
+// 把本线程的累计计数器、延迟分布和流表摘要写入共享内存槽位（只有本线程写该槽位）
+static void publish_shm(server_ctx_t *ctx) {
+    shmstats_thread_t *slot = ctx->shm_slot;
+    const stats_t *stats = &ctx->stats;
+    uint64_t now_ns = get_time_ns(PERF_CLOCK_MONOTONIC_RAW);
+    
+    shmstats_write_begin(slot);
+    slot->publish_ns = now_ns;
+    slot->packets_received = stats->packets_received;
+    slot->bytes_received = stats->bytes_received;
+    slot->packets_sent = stats->packets_sent;
+    slot->bytes_sent = stats->bytes_sent;
+    slot->packets_lost = ctx->flows.lost;
+    slot->reordered = ctx->flows.reordered;
+    slot->socket_drops = ctx->sockbuf.drops;
+    slot->latency = stats->latency_hist;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < ctx->flows.max_flows && count < SHMSTATS_MAX_FLOWS; i++) {
+        const flow_t *flow = &ctx->flows.flows[i];
+        if (!flow->in_use) {
+            continue;
+        }
+        shmstats_flow_t *out = &slot->flows[count++];
+        out->addr = flow->key.addr;
+        out->port = flow->key.port;
+        out->flow_id = flow->key.flow_id;
+        out->packets = flow->packets;
+        out->bytes = flow->bytes;
+        out->lost = flow->lost;
+        out->latency_count = flow->latency.total_count;
+        out->latency_sum_ns = flow->latency_sum_ns;
+        out->idle_ns = now_ns > flow->last_seen_ns ? now_ns - flow->last_seen_ns : 0;
+    }
+    slot->flows_active = ctx->flows.count;
+    slot->flow_count = count;
+    shmstats_write_end(slot);
+}
+
+// 发布统计快照（仅在报告周期变化时执行，热路径只有一次原子读）
+static void publish_snapshot(server_ctx_t *ctx) {
+    if (ctx->shm) {
+        unsigned shm_gen = atomic_load_explicit(&ctx->shm->gen, memory_order_relaxed);
+        if (shm_gen != ctx->shm_gen) {
+            ctx->shm_gen = shm_gen;
+            publish_shm(ctx);
+        }
+    }
+    unsigned gen = atomic_load_explicit(&report_gen, memory_order_relaxed);
+    if (gen == ctx->snapshot_gen) {
+        return;
+    }
+    pthread_mutex_lock(&ctx->snapshot_lock);
+    ctx->snapshot = ctx->stats;
+    ctx->snapshot_gen = gen;
+    pthread_mutex_unlock(&ctx->snapshot_lock);
+}
+
+// io_uring接收循环：多发recvmsg + 提供缓冲区环；反射模式下直接从接收缓冲区回送，
+// 回送的SENDMSG与下一次等待合并在同一次io_uring_enter()中批量提交
+// 内核不支持所需特性时返回-1，由调用者退回socket接收循环
+static int server_worker_uring(server_ctx_t *ctx) {
+    uring_t ring;
+    if (uring_init(&ring, URING_ENTRIES) < 0 ||
+        uring_setup_buffers(&ring, URING_BUFFERS, TS_CONTROL_LEN) < 0) {
+        uring_free(&ring);
+        return -1;
+    }
+    
+    // 每个缓冲区一份回送消息头，回送完成后才归还缓冲区
+    struct msghdr *send_msgs = calloc(URING_BUFFERS, sizeof(struct msghdr));
+    struct iovec *send_iovs = calloc(URING_BUFFERS, sizeof(struct iovec));
+    int *send_segs = calloc(URING_BUFFERS, sizeof(int));
+    char *send_ctrls = calloc(URING_BUFFERS, GSO_CONTROL_LEN);
+    if (!send_msgs || !send_iovs || !send_segs || !send_ctrls) {
+        free(send_msgs);
+        free(send_iovs);
+        free(send_segs);
+        free(send_ctrls);
+        uring_free(&ring);
+        return -1;
+    }
+    
+    int armed = 0;
+    int ret = 0;
+    while (running) {
+        if (ctx->publish) {
+            publish_snapshot(ctx);
+        }
+        
+        // 多发接收在缓冲区耗尽或出错时结束，需要重新提交
+        if (!armed) {
+            struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+            if (sqe) {
+                uring_prep_recvmsg_multishot(&ring, sqe, ctx->sockfd, URING_UD_RECV);
+                armed = 1;
+            }
+        }
+        
+        if (uring_submit(&ring, 1, ctx->publish ? WORKER_RECV_TIMEOUT_MS : -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("io_uring_enter failed");
+            break;
+        }
+        
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+            uint64_t user_data = cqe->user_data;
+            int res = cqe->res;
+            uint32_t cflags = cqe->flags;
+            uring_recv_t recv;
+            int have_buf = (user_data == URING_UD_RECV && res >= 0 &&
+                            uring_recv_parse(&ring, cqe, &recv) == 0);
+            uring_cqe_seen(&ring);
+            
+            if (user_data & URING_UD_SEND) {
+                // 回送完成：统计并归还缓冲区
+                unsigned bid = (unsigned)(user_data & 0xFFFFFFFFULL);
+                if (res >= 0) {
+                    ctx->stats.packets_sent += send_segs[bid];
+                    ctx->stats.bytes_sent += res;
+                }
+                uring_buf_recycle(&ring, bid);
+                continue;
+            }
+            
+            if (!(cflags & IORING_CQE_F_MORE)) {
+                armed = 0;
+            }
+            if (res < 0) {
+                // 旧内核不支持多发recvmsg：尚未收到任何包时退回socket路径
+                if ((res == -EINVAL || res == -EOPNOTSUPP) && ctx->stats.packets_received == 0) {
+                    ret = -1;
+                    break;
+                }
+                if (res != -ENOBUFS && res != -EINTR) {
+                    LOG_ERROR("io_uring recvmsg failed: %s\n", strerror(-res));
+                }
+                continue;
+            }
+            if (!have_buf) {
+                continue;
+            }
+            
+            int gro_size = ctx->gro ? gro_segment_size(&recv.msg) : 0;
+            int reflected = 0;
+            if (ctx->echo_mode) {
+                struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+                if (!sqe) {
+                    uring_submit(&ring, 0, -1);
+                    sqe = uring_get_sqe(&ring);
+                }
+                if (sqe) {
+                    struct msghdr *msg = &send_msgs[recv.bid];
+                    send_iovs[recv.bid].iov_base = recv.payload;
+                    send_iovs[recv.bid].iov_len = recv.payload_len;
+                    memset(msg, 0, sizeof(*msg));
+                    msg->msg_name = recv.addr;
+                    msg->msg_namelen = sizeof(struct sockaddr_in);
+                    msg->msg_iov = &send_iovs[recv.bid];
+                    msg->msg_iovlen = 1;
+                    send_segs[recv.bid] = datagram_segments(recv.payload_len, gro_size);
+                    if (send_segs[recv.bid] > 1) {
+                        msg->msg_control = send_ctrls + (size_t)recv.bid * GSO_CONTROL_LEN;
+                        msg->msg_controllen = GSO_CONTROL_LEN;
+                        build_gso_control(msg->msg_control, gro_size);
+                    }
+                    uring_prep_sendmsg(sqe, ctx->sockfd, msg, URING_UD_SEND | recv.bid);
+                    reflected = 1;
+                }
+            }
+            process_datagram(ctx, recv.payload, recv.payload_len, recv.addr, &recv.msg, gro_size);
+            if (!reflected) {
+                uring_buf_recycle(&ring, recv.bid);
+            }
+        }
+        if (ret < 0) {
+            break;
+        }
+        uring_buf_publish(&ring);
+        if (sockbuf_auto) {
+            sockbuf_autotune(ctx->sockfd, &ctx->sockbuf);
+        }
+    }
+    
+    uring_free(&ring);
+    free(send_msgs);
+    free(send_iovs);
+    free(send_segs);
+    free(send_ctrls);
+    return ret;
+}
+
+// AF_XDP接收循环：XDP程序把匹配的UDP帧直接放入UMEM，用户态解析以太网/IP/UDP头后交给统计逻辑
+// 反射模式下原地交换地址后把同一帧放入发送环，发送完成后帧经完成环回到填充环，全程不复制
+static void server_worker_xdp(server_ctx_t *ctx) {
+    xsk_t *xsk = ctx->xsk;
+    struct xdp_desc descs[XSK_RX_BATCH];
+    
+    while (running) {
+        if (ctx->publish) {
+            publish_snapshot(ctx);
+        }
+        
+        xsk_complete(xsk);
+        uint32_t n = xsk_recv(xsk, descs, XSK_RX_BATCH);
+        if (n == 0) {
+            xsk_flush(xsk);
+            if (xsk_wait(xsk, WORKER_RECV_TIMEOUT_MS) < 0 && errno != EINTR) {
+                perror("poll AF_XDP socket failed");
+                break;
+            }
+            continue;
+        }
+        
+        for (uint32_t i = 0; i < n; i++) {
+            char *frame = xsk_frame(xsk, descs[i].addr);
+            char *payload;
+            uint32_t payload_len;
+            struct sockaddr_in client_addr;
+            if (udp_frame_parse(frame, descs[i].len, &payload, &payload_len, &client_addr) < 0) {
+                ctx->xdp_invalid++;
+                xsk_recycle(xsk, descs[i].addr);
+                continue;
+            }
+            
+            // 帧在xsk_flush()发布之前内核不可见，统计可以在放入发送环之后读取负载
+            int reflected = 0;
+            if (ctx->echo_mode) {
+                udp_frame_reflect(frame);
+                if (xsk_send(xsk, descs[i].addr, descs[i].len) == 0) {
+                    ctx->stats.packets_sent++;
+                    ctx->stats.bytes_sent += payload_len;
+                    reflected = 1;
+                }
+            }
+            process_packet(ctx, payload, payload_len, &client_addr, NULL);
+            if (!reflected) {
+                xsk_recycle(xsk, descs[i].addr);
+            }
+        }
+        xsk_flush(xsk);
+    }
+}
+
+// 流水线I/O线程：recvmmsg()直接收进缓冲池的槽位，反射模式下先原地回送，再按源地址把槽位
+// 分发给处理线程；缓冲池耗尽时暂停接收，突发由socket接收缓冲区吸收
+static void server_pipe_io(server_ctx_t *ctx) {
+    pipe_t *pipe = ctx->pipe;
+    buf_pool_t *pool = &pipe->pool;
+    recv_batch_t *batch = &ctx->batch;
+    uint32_t slots[MAX_BATCH_SIZE];
+    int starved = 0;
+    
+    while (running) {
+        if (ctx->publish) {
+            publish_snapshot(ctx);
+        }
+        
+        pipe_reclaim(pipe);
+        if (pool->free_count == 0) {
+            if (!starved) {
+                pool->exhausted++;
+                starved = 1;
+            }
+            sched_yield();
+            continue;
+        }
+        starved = 0;
+        
+        int want = (uint32_t)batch->batch_size < pool->free_count ? batch->batch_size : (int)pool->free_count;
+        for (int i = 0; i < want; i++) {
+            uint32_t idx = pool->free_stack[--pool->free_count];
+            struct msghdr *hdr = &batch->msgs[i].msg_hdr;
+            slots[i] = idx;
+            batch->iovecs[i].iov_base = pipe_slot(pipe, idx);
+            batch->iovecs[i].iov_len = pool->slot_size;
+            hdr->msg_name = &pool->addrs[idx];
+            hdr->msg_namelen = sizeof(struct sockaddr_in);
+            hdr->msg_control = batch->controls + (size_t)i * TS_CONTROL_LEN;
+            hdr->msg_controllen = TS_CONTROL_LEN;
+            hdr->msg_flags = 0;
+        }
+        
+        // MSG_TRUNC使msg_len为数据报的实际长度，超过槽大小的包仍能正确统计字节数
+        int n = recvmmsg(ctx->sockfd, batch->msgs, want, (ctx->spin ? MSG_DONTWAIT : MSG_WAITFORONE) | MSG_TRUNC, NULL);
+        if (n < 0) {
+            n = 0;
+            if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR("recvmmsg failed: %s\n", strerror(errno));
+            }
+        }
+        for (int i = want - 1; i >= n; i--) {
+            pool->free_stack[pool->free_count++] = slots[i];
+        }
+        if (n == 0) {
+            continue;
+        }
+        if (pool->free_count < pool->min_free) {
+            pool->min_free = pool->free_count;
+        }
+        
+        for (int i = 0; i < n; i++) {
+            sockbuf_note(&ctx->sockbuf, &batch->msgs[i].msg_hdr);
+            pool->lens[slots[i]] = batch->msgs[i].msg_len;
+            if (batch->msgs[i].msg_len > pool->slot_size) {
+                pool->truncated++;
+                batch->msgs[i].msg_len = pool->slot_size;
+            }
+            batch->gro_sizes[i] = 0;
+        }
+        if (ctx->echo_mode) {
+            reflect_batch(ctx, batch, n);
+        }
+        
+        // 同一批中发往同一处理线程的槽位一次发布，每条环每批只写一次共享下标
+        uint32_t touched = 0;
+        for (int i = 0; i < n; i++) {
+            int w = pipe_pick_worker(pipe, &pool->addrs[slots[i]]);
+            spsc_push(&pipe->work[w], slots[i]);
+            touched |= 1U << w;
+        }
+        for (int w = 0; w < pipe->num_workers; w++) {
+            if (touched & (1U << w)) {
+                spsc_publish(&pipe->work[w]);
+                pipe_ring_stats_t *st = &pipe->ring_stats[w];
+                uint32_t occupancy = spsc_occupancy(&pipe->work[w]);
+                st->samples++;
+                st->occupancy_sum += occupancy;
+                if (occupancy > st->peak) {
+                    st->peak = occupancy;
+                }
+            }
+        }
+        if (sockbuf_auto) {
+            sockbuf_autotune(ctx->sockfd, &ctx->sockbuf);
+        }
+    }
+    atomic_store_explicit(&pipe->io_done, 1, memory_order_release);
+}
+
+// 流水线处理线程：从处理环取出槽位，完成解析、丢包和延迟统计后经归还环交回I/O线程
+static void server_pipe_worker(server_ctx_t *ctx) {
+    pipe_t *pipe = ctx->pipe;
+    spsc_ring_t *work = &pipe->work[ctx->pipe_worker];
+    spsc_ring_t *done = &pipe->done[ctx->pipe_worker];
+    uint32_t slots[PIPE_POP_BATCH];
+    int idle = 0;
+    
+    for (;;) {
+        if (ctx->publish) {
+            publish_snapshot(ctx);
+        }
+        
+        // 先读退出标志再取环：I/O线程退出前入环的槽位此时都已可见，取空即可结束
+        int io_done = atomic_load_explicit(&pipe->io_done, memory_order_acquire);
+        uint32_t n = spsc_pop_batch(work, slots, PIPE_POP_BATCH);
+        if (n == 0) {
+            if (io_done) {
+                break;
+            }
+            if (ctx->spin) {
+                continue;
+            }
+            if (++idle < PIPE_SPIN_LOOPS) {
+                sched_yield();
+            } else {
+                usleep(PIPE_IDLE_SLEEP_US);
+            }
+            continue;
+        }
+        idle = 0;
+        
+        for (uint32_t i = 0; i < n; i++) {
+            process_packet(ctx, pipe_slot(pipe, slots[i]), pipe->pool.lens[slots[i]],
+                           &pipe->pool.addrs[slots[i]], NULL);
+            spsc_push(done, slots[i]);
+        }
+        spsc_publish(done);
+    }
+}
+
+// 接收循环：单线程模式在主线程中运行，多线程模式下每个工作线程各自运行一份
+static void *server_worker_main(void *arg) {
+    server_ctx_t *ctx = (server_ctx_t *)arg;
+    recv_batch_t *batch = &ctx->batch;
+    int batch_size = batch->batch_size;
+    
+    // 把工作线程绑定到指定CPU核
+    if (ctx->cpu >= 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(ctx->cpu, &cpuset);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+        if (err != 0) {
+            fprintf(stderr, "Warning: Failed to pin receive thread to CPU %d: %s\n", ctx->cpu, strerror(err));
+        }
+    }
+    lowlat_thread(ctx->rt_prio, "receive");
+    
+    if (ctx->pipe) {
+        if (ctx->pipe_worker >= 0) {
+            server_pipe_worker(ctx);
+        } else {
+            server_pipe_io(ctx);
+        }
+        return NULL;
+    }
+    if (ctx->io_backend == IO_BACKEND_XDP) {
+        server_worker_xdp(ctx);
+        return NULL;
+    }
+    if (ctx->io_backend == IO_BACKEND_URING) {
+        if (server_worker_uring(ctx) == 0) {
+            return NULL;
+        }
+        fprintf(stderr, "Warning: io_uring multishot receive unavailable, falling back to socket I/O\n");
+    }
+    
+    while (running) {
+        if (ctx->publish) {
+            publish_snapshot(ctx);
+        }
+        recv_batch_prepare(batch, batch_size);
+        
+        if (batch_size > 1) {
+            // 批量接收：阻塞等待第一个包，然后非阻塞地取走队列中已有的包（低延迟模式不阻塞，队列为空时立即重试）
+            int n = recvmmsg(ctx->sockfd, batch->msgs, batch_size, ctx->spin ? MSG_DONTWAIT : MSG_WAITFORONE, NULL);
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+                    continue;
+                }
+                LOG_ERROR("recvmmsg failed: %s\n", strerror(errno));
+                continue;
+            }
+            
+            for (int i = 0; i < n; i++) {
+                batch->gro_sizes[i] = ctx->gro ? gro_segment_size(&batch->msgs[i].msg_hdr) : 0;
+            }
+            
+            // 先回送再统计，尽量缩短反射延迟（统计只读取负载，不修改）
+            if (ctx->echo_mode) {
+                reflect_batch(ctx, batch, n);
+            }
+            for (int i = 0; i < n; i++) {
+                process_datagram(ctx, batch->iovecs[i].iov_base, batch->msgs[i].msg_len,
+                                 &batch->addrs[i], &batch->msgs[i].msg_hdr, batch->gro_sizes[i]);
+            }
+            if (sockbuf_auto) {
+                sockbuf_autotune(ctx->sockfd, &ctx->sockbuf);
+            }
+            continue;
+        }
+        
+        ssize_t recv_len = recvmsg(ctx->sockfd, &batch->msgs[0].msg_hdr, ctx->spin ? MSG_DONTWAIT : 0);
+        if (recv_len < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+                continue;
+            }
+            LOG_ERROR("recvmsg failed: %s\n", strerror(errno));
+            continue;
+        }
+        
+        batch->gro_sizes[0] = ctx->gro ? gro_segment_size(&batch->msgs[0].msg_hdr) : 0;
+        if (ctx->echo_mode) {
+            batch->msgs[0].msg_len = (unsigned int)recv_len;
+            reflect_batch(ctx, batch, 1);
+        }
+        process_datagram(ctx, batch->iovecs[0].iov_base, recv_len,
+                         &batch->addrs[0], &batch->msgs[0].msg_hdr, batch->gro_sizes[0]);
+        if (sockbuf_auto) {
+            sockbuf_autotune(ctx->sockfd, &ctx->sockbuf);
+        }
+    }
+    return NULL;
+}
+
+// 打开一个接收socket并完成绑定、接收超时与时间戳设置
+static int server_ctx_open(server_ctx_t *ctx, const char *bind_ip, int port, int reuseport,
+                           int recv_timeout, int ts_mode, const char *ts_iface) {
+    ctx->sockfd = create_udp_socket();
+    if (ctx->sockfd < 0) {
+        return -1;
+    }
+    
+    // 多个socket绑定同一端口，由内核按四元组哈希把流分发到各socket
+    if (reuseport) {
+        int opt = 1;
+        if (setsockopt(ctx->sockfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+            perror("setsockopt SO_REUSEPORT failed");
+            return -1;
+        }
+    }
+    
+    // 接收超时，使阻塞的工作线程能周期性检查退出标志并发布统计快照
+    if (recv_timeout) {
+        struct timeval tv = { .tv_sec = 0, .tv_usec = WORKER_RECV_TIMEOUT_MS * 1000 };
+        if (setsockopt(ctx->sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+            perror("setsockopt SO_RCVTIMEO failed");
+        }
+    }
+    
+    if (bind_socket(ctx->sockfd, bind_ip, port) < 0) {
+        return -1;
+    }
+    if (ctx->busy_poll_us > 0) {
+        lowlat_socket(ctx->sockfd, ctx->busy_poll_us);
+    }
+    
+    // 启用UDP GRO：内核把同一流的连续包合并为一个超级数据报交付，减少每包的协议栈和系统调用开销
+    if (ctx->gro) {
+        int opt = 1;
+        if (setsockopt(ctx->sockfd, SOL_UDP, UDP_GRO, &opt, sizeof(opt)) < 0) {
+            perror("Warning: setsockopt UDP_GRO failed, receiving without GRO");
+            ctx->gro = 0;
+        }
+    }
+    
+    // 启用内核/网卡接收时间戳
+    if (ts_mode != TS_MODE_OFF) {
+        ctx->ts_mode = ts_enable(ctx->sockfd, ts_mode, ts_iface, 0);
+        ctx->ts_breakdown = calloc(1, sizeof(ts_breakdown_t));
+        if (ctx->ts_mode < 0 || !ctx->ts_breakdown) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 低延迟模式：测试开始前让接收缓冲区、流表和缓冲池全部完成缺页
+static void server_ctx_prefault(server_ctx_t *ctx) {
+    lowlat_prefault(ctx->batch.buffers, (size_t)ctx->batch.batch_size * MAX_BUFFER_SIZE);
+    if (ctx->flows.flows) {
+        lowlat_prefault(ctx->flows.flows, ctx->flows.max_flows * sizeof(flow_t));
+        lowlat_prefault(ctx->flows.slots, (ctx->flows.slot_mask + 1) * sizeof(uint32_t));
+    }
+    if (ctx->pipe && ctx->pipe_worker < 0) {
+        lowlat_prefault(ctx->pipe->pool.slab, (size_t)ctx->pipe->pool.count * ctx->pipe->pool.slot_size);
+    }
+}
+
+// 释放接收上下文的资源
+static void server_ctx_close(server_ctx_t *ctx) {
+    if (ctx->sockfd >= 0) {
+        close(ctx->sockfd);
+        ctx->sockfd = -1;
+    }
+    free(ctx->ts_breakdown);
+    ctx->ts_breakdown = NULL;
+    flowtab_free(&ctx->flows);
+    if (ctx->xsk) {
+        xsk_close(ctx->xsk);
+        free(ctx->xsk);
+        ctx->xsk = NULL;
+    }
+    recv_batch_free(&ctx->batch);
+    pthread_mutex_destroy(&ctx->snapshot_lock);
+}
+
+// 启用AF_XDP后端：在网卡上挂载XDP程序，第i个接收线程的socket绑定到队列first_queue + i
+// 并注册到XSKMAP；未绑定socket的队列上的包由XDP程序交给内核协议栈
+static int server_xdp_setup(server_ctx_t *ctxs, int num_threads, const char *bind_ip, int port,
+                            const char *iface, int mode, int first_queue, xdp_prog_t *prog) {
+    char ifname[IF_NAMESIZE];
+    if (iface) {
+        snprintf(ifname, sizeof(ifname), "%s", iface);
+    } else if (strcmp(bind_ip, "0.0.0.0") == 0 || xdp_iface_by_addr(bind_ip, ifname, sizeof(ifname)) < 0) {
+        fprintf(stderr, "Error: Cannot determine interface for %s (use --xdp-iface)\n", bind_ip);
+        return -1;
+    }
+    int ifindex = (int)if_nametoindex(ifname);
+    if (ifindex == 0) {
+        fprintf(stderr, "Error: Unknown interface %s\n", ifname);
+        return -1;
+    }
+    
+    struct in_addr dst_ip;
+    if (inet_aton(bind_ip, &dst_ip) == 0) {
+        return -1;
+    }
+    if (xdp_prog_attach(prog, ifindex, dst_ip.s_addr, htons(port), mode, first_queue + num_threads) < 0) {
+        return -1;
+    }
+    for (int i = 0; i < num_threads; i++) {
+        ctxs[i].xsk = calloc(1, sizeof(xsk_t));
+        if (!ctxs[i].xsk || xsk_open(ctxs[i].xsk, ifindex, first_queue + i, mode, 1) < 0 ||
+            xdp_prog_register(prog, first_queue + i, ctxs[i].xsk->fd) < 0) {
+            fprintf(stderr, "Error: Failed to set up AF_XDP socket on %s queue %d\n", ifname, first_queue + i);
+            for (int j = 0; j <= i; j++) {
+                if (ctxs[j].xsk) {
+                    xsk_close(ctxs[j].xsk);
+                    free(ctxs[j].xsk);
+                    ctxs[j].xsk = NULL;
+                }
+            }
+            xdp_prog_detach(prog);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 汇总打印AF_XDP socket的内核统计
+static void print_xdp_report(server_ctx_t *ctxs, int num_threads) {
+    struct xdp_statistics total;
+    memset(&total, 0, sizeof(total));
+    uint64_t invalid = 0;
+    for (int i = 0; i < num_threads; i++) {
+        struct xdp_statistics st;
+        if (ctxs[i].xsk && xsk_get_stats(ctxs[i].xsk, &st) == 0) {
+            total.rx_dropped += st.rx_dropped;
+            total.rx_ring_full += st.rx_ring_full;
+            total.rx_fill_ring_empty_descs += st.rx_fill_ring_empty_descs;
+        }
+        invalid += ctxs[i].xdp_invalid;
+    }
+    printf("AF_XDP统计: 内核丢弃 %llu, 接收环满 %llu, 填充环空 %llu, 无法解析的帧 %lu\n",
+           total.rx_dropped, total.rx_ring_full, total.rx_fill_ring_empty_descs, invalid);
+}
+
+// 打印各线程流表中的活跃流（同一发送端的包由同一线程接收，各线程的流互不重叠）
+static void print_flow_report(server_ctx_t *ctxs, int num_threads, int active_flows) {
+    const flow_t **flows = malloc(sizeof(flow_t *) * (active_flows > 0 ? active_flows : 1));
+    if (!flows) {
+        return;
+    }
+    int count = 0;
+    for (int i = 0; i < num_threads; i++) {
+        flowtab_t *tab = &ctxs[i].flows;
+        for (uint32_t j = 0; j < tab->max_flows && count < active_flows; j++) {
+            if (tab->flows[j].in_use) {
+                flows[count++] = &tab->flows[j];
+            }
+        }
+    }
+    flow_print_report(flows, count, get_time_ns(PERF_CLOCK_MONOTONIC_RAW));
+    free(flows);
+}
+
+// 丢包来源：本端接收socket队列溢出的丢弃（SO_RXQ_OVFL/SO_MEMINFO）与其余在线路或发送端丢失的包
+static void print_sockbuf_report(server_ctx_t *ctxs, int num_ctx, uint64_t packets_lost) {
+    uint64_t drops = 0;
+    int grows = 0, at_limit = 0, rcvbuf = 0;
+    for (int i = 0; i < num_ctx; i++) {
+        if (ctxs[i].sockfd < 0) {
+            continue;
+        }
+        sockbuf_read(ctxs[i].sockfd, &ctxs[i].sockbuf);
+        drops += ctxs[i].sockbuf.drops;
+        grows += ctxs[i].sockbuf.grows;
+        at_limit |= ctxs[i].sockbuf.at_limit;
+        if (ctxs[i].sockbuf.rcvbuf > rcvbuf) {
+            rcvbuf = ctxs[i].sockbuf.rcvbuf;
+        }
+    }
+    printf("丢包来源: 本端接收socket丢弃 %lu, 线路或发送端丢失 %lu\n",
+           drops, packets_lost > drops ? packets_lost - drops : 0);
+    if (sockbuf_auto) {
+        printf("接收缓冲区自动调整: 扩大 %d 次, 最终 %d KB%s\n", grows, rcvbuf / 2 / 1024,
+               at_limit ? "（已达上限）" : "");
+    }
+}
+
+// 周期时间序列报告的采样回调：无锁读取各线程的累计计数器（各线程只写自己的上下文）
+typedef struct {
+    server_ctx_t *ctxs;
+    int num_ctx;
+} server_report_arg_t;
+
+static void server_report_sample(void *arg, report_sample_t *out) {
+    const server_report_arg_t *ra = (const server_report_arg_t *)arg;
+    for (int i = 0; i < ra->num_ctx; i++) {
+        const server_ctx_t *ctx = &ra->ctxs[i];
+        out->packets_sent += __atomic_load_n(&ctx->stats.packets_sent, __ATOMIC_RELAXED);
+        out->bytes_sent += __atomic_load_n(&ctx->stats.bytes_sent, __ATOMIC_RELAXED);
+        out->packets_received += __atomic_load_n(&ctx->stats.packets_received, __ATOMIC_RELAXED);
+        out->bytes_received += __atomic_load_n(&ctx->stats.bytes_received, __ATOMIC_RELAXED);
+        out->packets_lost += __atomic_load_n(&ctx->flows.lost, __ATOMIC_RELAXED);
+        out->reordered += __atomic_load_n(&ctx->flows.reordered, __ATOMIC_RELAXED);
+        out->socket_drops += __atomic_load_n(&ctx->sockbuf.drops, __ATOMIC_RELAXED);
+        hist_accumulate_live(&out->latency, &ctx->stats.latency_hist);
+    }
+}
+
+// 多线程模式的周期报告：请求各线程发布快照，汇总后打印一行
+static void print_periodic_report(server_ctx_t *ctxs, int num_threads, stats_t *prev,
+                                  double interval_sec) {
+    unsigned gen = atomic_fetch_add(&report_gen, 1) + 1;
+    
+    // 等待各线程发布本周期的快照（空闲线程最多在一次接收超时后响应）
+    stats_t total;
+    memset(&total, 0, sizeof(total));
+    uint64_t per_thread[MAX_SERVER_THREADS * (1 + PIPE_MAX_WORKERS)];
+    double deadline = get_time_ms() + 2.0 * WORKER_RECV_TIMEOUT_MS;
+    for (int i = 0; i < num_threads; i++) {
+        for (;;) {
+            pthread_mutex_lock(&ctxs[i].snapshot_lock);
+            if (ctxs[i].snapshot_gen == gen || get_time_ms() >= deadline || !running) {
+                merge_stats(&total, &ctxs[i].snapshot);
+                per_thread[i] = ctxs[i].snapshot.packets_received;
+                pthread_mutex_unlock(&ctxs[i].snapshot_lock);
+                break;
+            }
+            pthread_mutex_unlock(&ctxs[i].snapshot_lock);
+            usleep(1000);
+        }
+    }
+    
+    uint64_t pkts = total.packets_received - prev->packets_received;
+    uint64_t bytes = total.bytes_received - prev->bytes_received;
+    uint64_t socket_drops = 0;
+    for (int i = 0; i < num_threads; i++) {
+        socket_drops += __atomic_load_n(&ctxs[i].sockbuf.drops, __ATOMIC_RELAXED);
+    }
+    printf("[REPORT] %lu pkts (%.0f pps, %.2f Mbps), Loss: %lu (socket drops %lu), Avg Latency: %.3f ms, per thread:",
+           total.packets_received, pkts / interval_sec, bytes * 8.0 / interval_sec / 1000000.0,
+           total.packets_lost, socket_drops, total.avg_latency_ms);
+    for (int i = 0; i < num_threads; i++) {
+        printf(" %lu", per_thread[i]);
+    }
+    printf("\n");
+    *prev = total;
+}
+
+int main(int argc, char *argv[]) {
     int port = DEFAULT_PORT;
     const char *bind_ip = DEFAULT_SERVER_IP;
     int perf_test_mode = 0;
-    stats_t stats = {0};
-    uint32_t expected_seq = 0;
+    int echo_mode = 0;    // 反射模式（代替TC3回送数据包）
+    int batch_size = 1;   // 每次recvmmsg()最多接收的包数，1表示逐包recvmsg()
+    int num_threads = 1;  // 接收线程数，大于1时使用SO_REUSEPORT分片
+    int ts_mode = TS_MODE_OFF;
+    const char *ts_iface = NULL;
+    int io_backend = IO_BACKEND_SOCKET;
+    int gro = 0;          // 是否启用UDP GRO合并接收
+    const char *xdp_iface = NULL;   // AF_XDP网卡，NULL表示按绑定地址查找
+    int xdp_mode = XSK_MODE_SKB;
+    int xdp_queue = 0;    // 第一个接收线程绑定的网卡队列
+    int seq_window = SEQWIN_DEFAULT_SIZE;   // 乱序/丢包判定窗口（序列号个数）
+    int max_flows = FLOWTAB_DEFAULT_MAX_FLOWS;   // 每个接收线程跟踪的最大流数
+    int flow_idle = FLOWTAB_DEFAULT_IDLE_SEC;    // 空闲流淘汰时间（秒）
+    int pipe_workers = 0; // 每个接收线程的流水线处理线程数，0表示不使用流水线
+    int pipe_pool = PIPE_DEFAULT_POOL_SIZE;
+    int pipe_slot = PIPE_DEFAULT_SLOT_SIZE;
+    lowlat_t ll;          // 低延迟配置（--low-latency）
+    lowlat_defaults(&ll);
+    report_t report;      // 周期时间序列报告（--report）
+    report_defaults(&report);
+    int shm_enabled = 0;  // 共享内存实时统计（--shm）
+    char shm_name[SHMSTATS_NAME_MAX] = "";
+    shmstats_t shm;
+    memset(&shm, 0, sizeof(shm));
     
     // 解析命令行参数
+    enum { OPT_TIMESTAMPING = 256, OPT_TS_IFACE, OPT_IO, OPT_GRO, OPT_XDP_IFACE, OPT_XDP_MODE,
+           OPT_XDP_QUEUE, OPT_SEQ_WINDOW, OPT_MAX_FLOWS, OPT_FLOW_IDLE, OPT_PIPELINE, OPT_PIPE_POOL,
+           OPT_PIPE_SLOT, OPT_LOG_LEVEL, OPT_LOG_RATE, OPT_LOW_LATENCY, OPT_BUSY_POLL, OPT_RT_PRIO,
+           OPT_MLOCK, OPT_CPUS, OPT_RCVBUF, OPT_SNDBUF, OPT_RCVBUF_AUTO, OPT_REPORT,
+           OPT_REPORT_INTERVAL, OPT_REPORT_FILE, OPT_SHM };
+    static const struct option long_options[] = {
+        {"timestamping", optional_argument, NULL, OPT_TIMESTAMPING},
+        {"ts-iface",     required_argument, NULL, OPT_TS_IFACE},
+        {"io",           required_argument, NULL, OPT_IO},
+        {"gro",          no_argument,       NULL, OPT_GRO},
+        {"xdp-iface",    required_argument, NULL, OPT_XDP_IFACE},
+        {"xdp-mode",     required_argument, NULL, OPT_XDP_MODE},
+        {"xdp-queue",    required_argument, NULL, OPT_XDP_QUEUE},
+        {"seq-window",   required_argument, NULL, OPT_SEQ_WINDOW},
+        {"max-flows",    required_argument, NULL, OPT_MAX_FLOWS},
+        {"flow-idle",    required_argument, NULL, OPT_FLOW_IDLE},
+        {"pipeline",     required_argument, NULL, OPT_PIPELINE},
+        {"pipe-pool",    required_argument, NULL, OPT_PIPE_POOL},
+        {"pipe-slot",    required_argument, NULL, OPT_PIPE_SLOT},
+        {"log-level",    required_argument, NULL, OPT_LOG_LEVEL},
+        {"log-rate",     required_argument, NULL, OPT_LOG_RATE},
+        {"low-latency",  no_argument,       NULL, OPT_LOW_LATENCY},
+        {"busy-poll",    required_argument, NULL, OPT_BUSY_POLL},
+        {"rt-prio",      required_argument, NULL, OPT_RT_PRIO},
+        {"mlock",        no_argument,       NULL, OPT_MLOCK},
+        {"cpus",         required_argument, NULL, OPT_CPUS},
+        {"rcvbuf",       required_argument, NULL, OPT_RCVBUF},
+        {"sndbuf",       required_argument, NULL, OPT_SNDBUF},
+        {"rcvbuf-auto",  no_argument,       NULL, OPT_RCVBUF_AUTO},
+        {"report",       required_argument, NULL, OPT_REPORT},
+        {"report-interval", required_argument, NULL, OPT_REPORT_INTERVAL},
+        {"report-file",  required_argument, NULL, OPT_REPORT_FILE},
+        {"shm",          optional_argument, NULL, OPT_SHM},
+        {NULL, 0, NULL, 0}
+    };
     int opt;
-    while ((opt = getopt(argc, argv, "hp:i:t")) != -1) {
+    while ((opt = getopt_long(argc, argv, "hp:i:teB:T:", long_options, NULL)) != -1) {
         switch (opt) {
             case 'h':
                 print_usage(argv[0]);
@@ -34,109 +1158,519 @@ int main(int argc, char *argv[]) {
             case 't':
                 perf_test_mode = 1;
                 break;
+            case 'e':
+                echo_mode = 1;
+                break;
+            case 'B':
+                batch_size = atoi(optarg);
+                if (batch_size < 1) {
+                    batch_size = 1;
+                } else if (batch_size > MAX_BATCH_SIZE) {
+                    batch_size = MAX_BATCH_SIZE;
+                }
+                break;
+            case 'T':
+                num_threads = atoi(optarg);
+                if (num_threads < 1) {
+                    num_threads = 1;
+                } else if (num_threads > MAX_SERVER_THREADS) {
+                    num_threads = MAX_SERVER_THREADS;
+                }
+                break;
+            case OPT_TIMESTAMPING:
+                if (!optarg || strcmp(optarg, "sw") == 0) {
+                    ts_mode = TS_MODE_SOFTWARE;
+                } else if (strcmp(optarg, "hw") == 0) {
+                    ts_mode = TS_MODE_HARDWARE;
+                } else {
+                    fprintf(stderr, "Error: Unknown timestamping mode '%s' (use sw or hw)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_TS_IFACE:
+                ts_iface = optarg;
+                break;
+            case OPT_GRO:
+                gro = 1;
+                break;
+            case OPT_IO:
+                if (parse_io_backend(optarg, &io_backend) < 0) {
+                    fprintf(stderr, "Error: Unknown I/O backend '%s' (use socket, uring or xdp)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_XDP_IFACE:
+                xdp_iface = optarg;
+                break;
+            case OPT_XDP_MODE:
+                if (parse_xsk_mode(optarg, &xdp_mode) < 0) {
+                    fprintf(stderr, "Error: Unknown XDP mode '%s' (use skb or native)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_XDP_QUEUE:
+                xdp_queue = atoi(optarg);
+                if (xdp_queue < 0) {
+                    xdp_queue = 0;
+                }
+                break;
+            case OPT_SEQ_WINDOW:
+                seq_window = atoi(optarg);
+                if (seq_window < 1) {
+                    seq_window = SEQWIN_DEFAULT_SIZE;
+                }
+                break;
+            case OPT_MAX_FLOWS:
+                max_flows = atoi(optarg);
+                if (max_flows < 1) {
+                    max_flows = 1;
+                }
+                break;
+            case OPT_FLOW_IDLE:
+                flow_idle = atoi(optarg);
+                if (flow_idle < 0) {
+                    flow_idle = 0;
+                }
+                break;
+            case OPT_PIPELINE:
+                pipe_workers = atoi(optarg);
+                if (pipe_workers < 0) {
+                    pipe_workers = 0;
+                } else if (pipe_workers > PIPE_MAX_WORKERS) {
+                    pipe_workers = PIPE_MAX_WORKERS;
+                }
+                break;
+            case OPT_PIPE_POOL:
+                pipe_pool = atoi(optarg);
+                if (pipe_pool < 1) {
+                    pipe_pool = PIPE_DEFAULT_POOL_SIZE;
+                }
+                break;
+            case OPT_PIPE_SLOT:
+                pipe_slot = atoi(optarg);
+                if (pipe_slot < PIPE_MIN_SLOT_SIZE) {
+                    pipe_slot = PIPE_MIN_SLOT_SIZE;
+                } else if (pipe_slot > MAX_BUFFER_SIZE) {
+                    pipe_slot = MAX_BUFFER_SIZE;
+                }
+                break;
+            case OPT_LOG_LEVEL:
+                if (parse_log_level(optarg, &log_level) < 0) {
+                    fprintf(stderr, "Error: Unknown log level '%s' (use error, warn, info or debug)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_LOG_RATE:
+                log_rate = (uint32_t)(atoi(optarg) > 0 ? atoi(optarg) : 0);
+                break;
+            case OPT_LOW_LATENCY:
+                ll.enabled = 1;
+                break;
+            case OPT_BUSY_POLL:
+                ll.enabled = 1;
+                ll.busy_poll_us = atoi(optarg) > 0 ? atoi(optarg) : 0;
+                break;
+            case OPT_RT_PRIO:
+                ll.enabled = 1;
+                ll.rt_prio = atoi(optarg);
+                if (ll.rt_prio < 1 || ll.rt_prio > 99) {
+                    fprintf(stderr, "Error: --rt-prio must be between 1 and 99\n");
+                    return 1;
+                }
+                break;
+            case OPT_MLOCK:
+                ll.enabled = 1;
+                ll.mlock = 1;
+                break;
+            case OPT_CPUS:
+                ll.enabled = 1;
+                ll.num_cpus = lowlat_parse_cpus(optarg, ll.cpus, LOWLAT_MAX_CPUS);
+                if (ll.num_cpus <= 0) {
+                    fprintf(stderr, "Error: Invalid CPU list '%s' (example: 2-3,6)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_RCVBUF:
+            case OPT_SNDBUF:
+                if (sockbuf_parse_size(optarg, opt == OPT_RCVBUF ? &sockbuf_rcvbuf : &sockbuf_sndbuf) < 0) {
+                    fprintf(stderr, "Error: Invalid buffer size '%s' (bytes, k/m suffix, up to %d MB)\n",
+                            optarg, SOCKBUF_AUTO_MAX / (1024 * 1024));
+                    return 1;
+                }
+                break;
+            case OPT_RCVBUF_AUTO:
+                sockbuf_auto = 1;
+                break;
+            case OPT_REPORT:
+                if (report_parse_format(optarg, &report.format) < 0) {
+                    fprintf(stderr, "Error: Invalid report format '%s' (use json or csv)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_REPORT_INTERVAL:
+                report.interval_ms = atoi(optarg);
+                if (report.interval_ms < REPORT_MIN_INTERVAL_MS) {
+                    fprintf(stderr, "Error: --report-interval must be at least %d ms\n", REPORT_MIN_INTERVAL_MS);
+                    return 1;
+                }
+                break;
+            case OPT_REPORT_FILE:
+                report.path = optarg;
+                break;
+            case OPT_SHM:
+                shm_enabled = 1;
+                if (optarg) {
+                    if (optarg[0] == '\0' || strchr(optarg + 1, '/') != NULL ||
+                        strlen(optarg) >= SHMSTATS_NAME_MAX - 1) {
+                        fprintf(stderr, "Error: Invalid shared memory name '%s' (example: udp_server.8888)\n", optarg);
+                        return 1;
+                    }
+                    snprintf(shm_name, sizeof(shm_name), "%s", optarg);
+                }
+                break;
             default:
                 print_usage(argv[0]);
                 return 1;
         }
     }
     
-    // 注册信号处理
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // 注册信号处理（不设置SA_RESTART，使阻塞的recvmsg/recvmmsg能被Ctrl+C中断）
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    
+    // AF_XDP绕过协议栈，拿不到内核时间戳和GRO
+    if (io_backend == IO_BACKEND_XDP && (ts_mode != TS_MODE_OFF || gro)) {
+        fprintf(stderr, "Error: --io xdp cannot be combined with --timestamping or --gro\n");
+        return 1;
+    }
+    
+    // 流水线在I/O线程中用recvmmsg()直接收进缓冲池，处理线程拿不到控制消息，也不拆分GRO数据报
+    if (pipe_workers > 0 && (io_backend != IO_BACKEND_SOCKET || ts_mode != TS_MODE_OFF || gro)) {
+        fprintf(stderr, "Error: --pipeline requires --io socket and cannot be combined with --timestamping or --gro\n");
+        return 1;
+    }
+    
+    // 自旋接收只实现在socket接收循环中
+    if (ll.enabled && io_backend != IO_BACKEND_SOCKET) {
+        fprintf(stderr, "Error: --low-latency requires --io socket\n");
+        return 1;
+    }
+    if (ll.enabled) {
+        lowlat_select_cpus(&ll);
+    }
+    if (report_open(&report, "server") < 0) {
+        return 1;
+    }
+    
+    // io_uring不可用（内核过旧或被禁用）时退回socket路径
+    if (io_backend == IO_BACKEND_URING && uring_probe() < 0) {
+        fprintf(stderr, "Warning: io_uring unavailable (%s), falling back to socket I/O\n", strerror(errno));
+        io_backend = IO_BACKEND_SOCKET;
+    }
     
-    // 创建socket
-    sockfd = create_udp_socket();
-    if (sockfd < 0) {
+    // 分配每线程接收上下文（缓存行对齐）：前num_threads个为接收（I/O）线程，
+    // 流水线模式下随后是各I/O线程的处理线程，I/O线程i的第w个处理线程位于num_threads + i * pipe_workers + w
+    int num_ctx = num_threads * (1 + pipe_workers);
+    server_ctx_t *ctxs = NULL;
+    if (posix_memalign((void **)&ctxs, CACHE_LINE_SIZE, sizeof(server_ctx_t) * num_ctx) != 0) {
+        fprintf(stderr, "Error: Failed to allocate receive contexts\n");
         return 1;
     }
+    memset(ctxs, 0, sizeof(server_ctx_t) * num_ctx);
+    pipe_t *pipes = NULL;
+    if (pipe_workers > 0) {
+        pipes = calloc(num_threads, sizeof(pipe_t));
+        if (!pipes) {
+            fprintf(stderr, "Error: Failed to allocate receive pipelines\n");
+            free(ctxs);
+            return 1;
+        }
+    }
     
-    // 绑定socket
-    if (bind_socket(sockfd, bind_ip, port) < 0) {
-        close(sockfd);
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cpus < 1) {
+        num_cpus = 1;
+    }
+    int ok = 1;
+    for (int i = 0; i < num_ctx; i++) {
+        server_ctx_t *ctx = &ctxs[i];
+        ctx->sockfd = -1;
+        ctx->perf_test_mode = perf_test_mode;
+        ctx->io_backend = io_backend;
+        ctx->publish = (num_ctx > 1) || shm_enabled;
+        ctx->cpu = (num_ctx > 1) ? (int)(i % num_cpus) : -1;
+        ctx->pipe_worker = -1;
+        if (ll.enabled) {
+            // 低延迟模式：每个线程（包括单线程模式的主线程）独占一个核自旋
+            ctx->cpu = lowlat_cpu(&ll, i);
+            ctx->spin = 1;
+            ctx->rt_prio = ll.rt_prio;
+            ctx->busy_poll_us = ll.busy_poll_us;
+        }
+        pthread_mutex_init(&ctx->snapshot_lock, NULL);
+        
+        if (i >= num_threads) {
+            // 流水线处理线程：只做解析与统计，不持有socket
+            int io = (i - num_threads) / pipe_workers;
+            ctx->pipe = &pipes[io];
+            ctx->pipe_worker = (i - num_threads) % pipe_workers;
+            ctx->verbose = (num_threads == 1 && pipe_workers == 1);
+            if (flowtab_init(&ctx->flows, max_flows, seq_window, flow_idle) < 0) {
+                ok = 0;
+                break;
+            }
+            continue;
+        }
+        ctx->echo_mode = echo_mode;
+        ctx->gro = gro;
+        ctx->verbose = (num_ctx == 1);
+        
+        // 预分配接收向量并打开socket；流水线的I/O线程不处理包，流表由其处理线程持有
+        if (pipe_workers > 0) {
+            ctx->pipe = &pipes[i];
+            if (pipe_init(ctx->pipe, pipe_workers, pipe_pool, pipe_slot) < 0) {
+                ok = 0;
+                break;
+            }
+        } else if (flowtab_init(&ctx->flows, max_flows, seq_window, flow_idle) < 0) {
+            ok = 0;
+            break;
+        }
+        if (recv_batch_init(&ctx->batch, batch_size) < 0 ||
+            server_ctx_open(ctx, bind_ip, port, num_threads > 1, ctx->publish, ts_mode, ts_iface) < 0) {
+            ok = 0;
+            break;
+        }
+    }
+    // 共享内存统计：每个线程（包括流水线的I/O线程和处理线程）一个槽位
+    if (ok && shm_enabled) {
+        if (shm_name[0] == '\0') {
+            shmstats_default_name(shm_name, sizeof(shm_name), port);
+        }
+        if (shmstats_create(&shm, shm_name, num_ctx, bind_ip, port, SHMSTATS_DEFAULT_INTERVAL_MS) < 0) {
+            ok = 0;
+        }
+        for (int i = 0; ok && i < num_ctx; i++) {
+            ctxs[i].shm = &shm;
+            ctxs[i].shm_slot = &shm.threads[i];
+            ctxs[i].shm_slot->role = ctxs[i].pipe_worker >= 0 ? SHMSTATS_ROLE_PIPELINE : SHMSTATS_ROLE_RECEIVE;
+        }
+    }
+    if (!ok) {
+        for (int i = 0; i < num_ctx; i++) {
+            server_ctx_close(&ctxs[i]);
+        }
+        for (int i = 0; pipes && i < num_threads; i++) {
+            pipe_free(&pipes[i]);
+        }
+        free(pipes);
+        free(ctxs);
         return 1;
     }
+    if (ts_mode != TS_MODE_OFF) {
+        tai_offset_ns = (int64_t)(get_time_ns(PERF_CLOCK_TAI) - get_time_ns(PERF_CLOCK_REALTIME));
+    }
+    
+    // 低延迟模式：先锁定内存，再让所有缓冲区提前完成缺页
+    if (ll.enabled) {
+        if (ll.mlock) {
+            lowlat_lock_memory();
+        }
+        for (int i = 0; i < num_ctx; i++) {
+            server_ctx_prefault(&ctxs[i]);
+        }
+    }
+    
+    // UDP socket仍保持绑定：未重定向的包（其他队列）照常由协议栈接收，也不会触发ICMP端口不可达
+    xdp_prog_t xdp_prog = { .prog_fd = -1, .map_fd = -1, .link_fd = -1 };
+    if (io_backend == IO_BACKEND_XDP &&
+        server_xdp_setup(ctxs, num_threads, bind_ip, port, xdp_iface, xdp_mode, xdp_queue, &xdp_prog) < 0) {
+        fprintf(stderr, "Warning: AF_XDP unavailable, falling back to socket I/O\n");
+        io_backend = IO_BACKEND_SOCKET;
+        for (int i = 0; i < num_threads; i++) {
+            ctxs[i].io_backend = IO_BACKEND_SOCKET;
+        }
+    }
+    
+    // 周期计数器时钟：启动时标定，之后收包时间戳不再调用clock_gettime()
+    tsc_init();
     
     printf("UDP Server started on %s:%d\n", bind_ip, port);
     printf("Waiting for UDP packets from TC3...\n");
     if (perf_test_mode) {
-        printf("Performance test mode: Receiving packets only (no echo)\n");
+        printf("Performance test mode: %s\n",
+               echo_mode ? "Reflecting packets back to sender (echo)" : "Receiving packets only (no echo)");
     } else {
-        printf("Interactive mode: Receiving packets only (no echo)\n");
+        printf("Interactive mode: %s\n",
+               echo_mode ? "Reflecting packets back to sender (echo)" : "Receiving packets only (no echo)");
+    }
+    if (io_backend == IO_BACKEND_XDP) {
+        char ifname[IF_NAMESIZE];
+        printf("I/O backend: AF_XDP on %s, queues %d-%d (%s mode, %s), UDP stack bypassed\n",
+               if_indextoname(ctxs[0].xsk->ifindex, ifname), xdp_queue, xdp_queue + num_threads - 1,
+               xdp_mode == XSK_MODE_NATIVE ? "native" : "skb", ctxs[0].xsk->zerocopy ? "zero-copy" : "copy");
+    } else if (io_backend == IO_BACKEND_URING) {
+        printf("I/O backend: io_uring (multishot recvmsg, %d provided buffers per thread)\n", URING_BUFFERS);
+    } else if (batch_size > 1) {
+        printf("Batched receive: up to %d packets per recvmmsg()\n", batch_size);
+    }
+    if (ctxs[0].gro) {
+        printf("UDP GRO: enabled (coalesced datagrams are split into packets in userspace)\n");
+    }
+    if (num_threads > 1 && ll.enabled) {
+        printf("Receive threads: %d (SO_REUSEPORT)\n", num_threads);
+    } else if (num_threads > 1) {
+        printf("Receive threads: %d (SO_REUSEPORT, pinned to CPUs 0-%ld)\n", num_threads,
+               (num_threads < num_cpus ? num_threads : num_cpus) - 1);
+    }
+    if (pipe_workers > 0) {
+        printf("Receive pipeline: %d processing thread(s) per receive thread, %d x %u byte buffers per pool\n",
+               pipe_workers, pipe_pool, pipes[0].pool.slot_size);
+    }
+    lowlat_print_info(&ll, num_ctx);
+    sockbuf_print_info(ctxs[0].sockfd);
+    report_print_info(&report);
+    shmstats_print_info(&shm);
+    if (ctxs[0].ts_breakdown) {
+        printf("Kernel timestamping: %s\n", ctxs[0].ts_mode == TS_MODE_HARDWARE ? "hardware" : "software");
+    }
+    if (perf_test_mode) {
+        tsc_print_info();
+        if (flow_idle > 0) {
+            printf("Flow table: up to %d flows per thread, idle flows evicted after %d s\n", max_flows, flow_idle);
+        } else {
+            printf("Flow table: up to %d flows per thread, no idle eviction\n", max_flows);
+        }
     }
     printf("Press Ctrl+C to stop\n\n");
     
-    gettimeofday(&stats.start_time, NULL);
+    stats_t total;
+    memset(&total, 0, sizeof(total));
+    gettimeofday(&total.start_time, NULL);
     
-    // 主循环：只接收数据
-    while (running) {
-        ssize_t recv_len = recvfrom(sockfd, buffer, MAX_BUFFER_SIZE, 0,
-                                    (struct sockaddr *)&client_addr, &client_len);
-        
-        if (recv_len < 0) {
-            if (errno == EINTR) {
-                continue;
+    // 逐包日志经后台线程异步写出，终端速度不影响接收循环
+    log_init();
+    server_report_arg_t report_arg = { .ctxs = ctxs, .num_ctx = num_ctx };
+    report_start(&report, server_report_sample, &report_arg, 0);
+    if (shm_enabled) {
+        shmstats_start(&shm);
+    }
+    
+    if (num_ctx == 1) {
+        // 单线程：主线程直接运行接收循环
+        server_worker_main(&ctxs[0]);
+    } else {
+        // 多线程：工作线程屏蔽SIGINT/SIGTERM，由主线程响应信号并负责周期汇总报告
+        // 流水线的处理线程在其I/O线程退出并取空处理环后结束，先加入I/O线程不会丢失在途的包
+        sigset_t block, old;
+        sigemptyset(&block);
+        sigaddset(&block, SIGINT);
+        sigaddset(&block, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &block, &old);
+        int started = 0;
+        for (; started < num_ctx; started++) {
+            if (pthread_create(&ctxs[started].thread, NULL, server_worker_main, &ctxs[started]) != 0) {
+                fprintf(stderr, "Error: Failed to create receive thread %d\n", started);
+                running = 0;
+                break;
             }
-            perror("recvfrom failed");
-            continue;
         }
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
         
-        stats.packets_received++;
-        stats.bytes_received += recv_len;
-        
-        // 打印接收信息
-        char client_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-        
-        // 如果是性能测试模式
-        if (perf_test_mode && recv_len >= (ssize_t)sizeof(perf_packet_t)) {
-            perf_packet_t *pkt = (perf_packet_t *)buffer;
-            
-            // 丢包检测：通过序列号判断
-            if (pkt->seq_num == expected_seq) {
-                expected_seq++;
-            } else if (pkt->seq_num > expected_seq) {
-                stats.packets_lost += (pkt->seq_num - expected_seq);
-                expected_seq = pkt->seq_num + 1;
-            }
-            
-            // 计算延迟（从发送时间戳到接收时间的延迟）
-            struct timeval recv_time;
-            gettimeofday(&recv_time, NULL);
-            double recv_time_ms = recv_time.tv_sec * 1000.0 + recv_time.tv_usec / 1000.0;
-            double send_time_ms = pkt->timestamp_sec * 1000.0 + pkt->timestamp_usec / 1000.0;
-            double latency_ms = recv_time_ms - send_time_ms;
-            
-            if (latency_ms > 0) {
-                if (stats.min_latency_ms == 0 || latency_ms < stats.min_latency_ms) {
-                    stats.min_latency_ms = latency_ms;
-                }
-                if (latency_ms > stats.max_latency_ms) {
-                    stats.max_latency_ms = latency_ms;
-                }
-                stats.total_latency_ms += latency_ms;
-                stats.avg_latency_ms = stats.total_latency_ms / stats.packets_received;
-            }
-            
-            // 性能测试模式下，每100个包显示一次进度
-            if (stats.packets_received % 100 == 0) {
-                printf("[RECV] From %s:%d, Packet #%u, Size: %zd bytes, "
-                       "Loss: %lu, Avg Latency: %.3f ms\n", 
-                       client_ip, ntohs(client_addr.sin_port), pkt->seq_num, recv_len,
-                       stats.packets_lost, stats.avg_latency_ms);
+        stats_t prev;
+        memset(&prev, 0, sizeof(prev));
+        double last_report = get_time_ms();
+        while (running) {
+            usleep(WORKER_RECV_TIMEOUT_MS * 1000);
+            double now = get_time_ms();
+            if (running && now - last_report >= SERVER_REPORT_INTERVAL_MS) {
+                print_periodic_report(ctxs, num_ctx, &prev, (now - last_report) / 1000.0);
+                last_report = now;
             }
-        } else {
-            // 交互模式或非性能测试包：显示每次接收
-            printf("[RECV] From %s:%d, Size: %zd bytes\n", 
-                   client_ip, ntohs(client_addr.sin_port), recv_len);
+        }
+        
+        for (int i = 0; i < started; i++) {
+            pthread_join(ctxs[i].thread, NULL);
         }
     }
     
-    gettimeofday(&stats.end_time, NULL);
+    gettimeofday(&total.end_time, NULL);
+    report_close(&report);
+    
+    // 各线程已退出：由主线程发布最终计数，之后标记服务器已退出并删除共享内存段
+    for (int i = 0; shm_enabled && i < num_ctx; i++) {
+        publish_shm(&ctxs[i]);
+    }
+    shmstats_destroy(&shm);
+    log_shutdown();
+    
+    // 汇总各线程的统计信息
+    uint64_t gro_datagrams = 0, gro_segments = 0;
+    seq_stats_t seq_total;
+    memset(&seq_total, 0, sizeof(seq_total));
+    uint64_t flows_created = 0, flows_evicted = 0, evicted_packets = 0, overflow_packets = 0;
+    int active_flows = 0;
+    for (int i = 0; i < num_ctx; i++) {
+        seq_stats_t seq;
+        flowtab_seq_stats(&ctxs[i].flows, &seq);
+        seq_stats_merge(&seq_total, &seq);
+        flows_created += ctxs[i].flows.flows_created;
+        flows_evicted += ctxs[i].flows.flows_evicted;
+        evicted_packets += ctxs[i].flows.evicted_packets;
+        overflow_packets += ctxs[i].flows.overflow_packets;
+        active_flows += ctxs[i].flows.count;
+        merge_stats(&total, &ctxs[i].stats);
+        gro_datagrams += ctxs[i].gro_datagrams;
+        gro_segments += ctxs[i].gro_segments;
+        if (i > 0 && ctxs[i].ts_breakdown) {
+            ts_breakdown_merge(ctxs[0].ts_breakdown, ctxs[i].ts_breakdown);
+        }
+    }
     
     printf("\nServer shutting down...\n");
-    print_stats(&stats);
+    if (num_ctx > 1) {
+        printf("Per-thread packets received:");
+        for (int i = (pipe_workers > 0 ? num_threads : 0); i < num_ctx; i++) {
+            printf(" [%d] %lu", i, ctxs[i].stats.packets_received);
+        }
+        printf("\n");
+    }
+    print_stats(&total);
+    print_sockbuf_report(ctxs, num_ctx, total.packets_lost);
+    if (perf_test_mode) {
+        seq_stats_print(&seq_total, "序列号统计");
+        printf("流表: 共出现 %lu 个流, 活跃 %d 个, 已淘汰空闲流 %lu 个 (%lu 包), 表满未跟踪的包 %lu\n",
+               flows_created, active_flows, flows_evicted, evicted_packets, overflow_packets);
+        print_flow_report(ctxs, num_ctx, active_flows);
+    }
+    for (int i = 0; pipes && i < num_threads; i++) {
+        pipe_print_report(&pipes[i], i);
+    }
+    if (ctxs[0].gro) {
+        printf("GRO合并数据报: %lu 个，共 %lu 个包（平均每个 %.1f 包，占全部接收包 %.1f%%）\n",
+               gro_datagrams, gro_segments,
+               gro_datagrams > 0 ? (double)gro_segments / gro_datagrams : 0.0,
+               total.packets_received > 0 ? gro_segments * 100.0 / total.packets_received : 0.0);
+    }
+    if (ctxs[0].ts_breakdown) {
+        ts_print_breakdown(ctxs[0].ts_breakdown);
+    }
+    if (io_backend == IO_BACKEND_XDP) {
+        print_xdp_report(ctxs, num_threads);
+    }
     
-    close(sockfd);
+    for (int i = 0; i < num_ctx; i++) {
+        server_ctx_close(&ctxs[i]);
+    }
+    for (int i = 0; pipes && i < num_threads; i++) {
+        pipe_free(&pipes[i]);
+    }
+    free(pipes);
+    xdp_prog_detach(&xdp_prog);
+    free(ctxs);
     return 0;
 }
-
@@ -0,0 +1,190 @@
+#include "../include/shmstats.h"
+#include "../include/common.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint64_t shmstats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t shmstats_size(uint32_t num_threads) {
+    return sizeof(shmstats_header_t) + (size_t)num_threads * sizeof(shmstats_thread_t);
+}
+
+void shmstats_default_name(char *buf, size_t len, int port) {
+    snprintf(buf, len, "/udp_server.%d", port);
+}
+
+// 段名必须以'/'开头且只有这一个'/'
+static void shmstats_set_name(shmstats_t *shm, const char *name) {
+    snprintf(shm->name, sizeof(shm->name), "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+int shmstats_create(shmstats_t *shm, const char *name, int num_threads, const char *bind_ip, int port,
+                    int interval_ms) {
+    memset(shm, 0, sizeof(*shm));
+    shmstats_set_name(shm, name);
+    shm->interval_ms = interval_ms;
+    shm->size = shmstats_size((uint32_t)num_threads);
+    
+    // 先删除旧段（上次异常退出残留或版本不同），已映射旧段的监控程序不受影响
+    shm_unlink(shm->name);
+    int fd = shm_open(shm->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error: shm_open %s failed: %s\n", shm->name, strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)shm->size) < 0) {
+        fprintf(stderr, "Error: ftruncate %s failed: %s\n", shm->name, strerror(errno));
+        close(fd);
+        shm_unlink(shm->name);
+        return -1;
+    }
+    void *base = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Error: mmap %s failed: %s\n", shm->name, strerror(errno));
+        shm_unlink(shm->name);
+        return -1;
+    }
+    shm->hdr = (shmstats_header_t *)base;
+    shm->threads = (shmstats_thread_t *)((char *)base + sizeof(shmstats_header_t));
+    shm->owner = 1;
+    
+    // 新段内容为零；各槽位的role由调用者在线程启动前填写
+    shmstats_header_t *hdr = shm->hdr;
+    hdr->version = SHMSTATS_VERSION;
+    hdr->size = shm->size;
+    hdr->num_threads = (uint32_t)num_threads;
+    hdr->interval_ms = (uint32_t)interval_ms;
+    hdr->pid = (int32_t)getpid();
+    hdr->port = (uint16_t)port;
+    snprintf(hdr->bind_ip, sizeof(hdr->bind_ip), "%s", bind_ip);
+    hdr->start_ns = shmstats_now_ns();
+    atomic_store(&hdr->heartbeat_ns, hdr->start_ns);
+    atomic_store(&hdr->running, 1);
+    // 魔数最后写入，读者看到魔数时其余字段已就绪
+    atomic_thread_fence(memory_order_release);
+    hdr->magic = SHMSTATS_MAGIC;
+    return 0;
+}
+
+static void *shmstats_thread_main(void *arg) {
+    shmstats_t *shm = (shmstats_t *)arg;
+    while (!atomic_load_explicit(&shm->stop, memory_order_acquire)) {
+        usleep((useconds_t)shm->interval_ms * 1000);
+        atomic_fetch_add_explicit(&shm->gen, 1, memory_order_relaxed);
+        atomic_store_explicit(&shm->hdr->heartbeat_ns, shmstats_now_ns(), memory_order_relaxed);
+    }
+    return NULL;
+}
+
+int shmstats_start(shmstats_t *shm) {
+    atomic_store(&shm->stop, 0);
+    
+    int err = start_background_thread(&shm->thread, shmstats_thread_main, shm);
+    if (err != 0) {
+        fprintf(stderr, "Warning: Failed to start shared memory stats thread: %s\n", strerror(err));
+        return -1;
+    }
+    shm->running = 1;
+    return 0;
+}
+
+void shmstats_destroy(shmstats_t *shm) {
+    if (!shm->hdr) {
+        return;
+    }
+    if (shm->running) {
+        atomic_store_explicit(&shm->stop, 1, memory_order_release);
+        pthread_join(shm->thread, NULL);
+        shm->running = 0;
+    }
+    atomic_store_explicit(&shm->hdr->running, 0, memory_order_release);
+    munmap(shm->hdr, shm->size);
+    if (shm->owner) {
+        shm_unlink(shm->name);
+    }
+    shm->hdr = NULL;
+    shm->threads = NULL;
+}
+
+int shmstats_attach(shmstats_t *shm, const char *name) {
+    memset(shm, 0, sizeof(*shm));
+    shmstats_set_name(shm, name);
+    int fd = shm_open(shm->name, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open %s: %s (is udp_server running with --shm?)\n",
+                shm->name, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(shmstats_header_t)) {
+        fprintf(stderr, "Error: %s is not a udp_server statistics segment\n", shm->name);
+        close(fd);
+        return -1;
+    }
+    shm->size = (size_t)st.st_size;
+    void *base = mmap(NULL, shm->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Error: mmap %s failed: %s\n", shm->name, strerror(errno));
+        return -1;
+    }
+    shm->hdr = (shmstats_header_t *)base;
+    shm->threads = (shmstats_thread_t *)((char *)base + sizeof(shmstats_header_t));
+    
+    const shmstats_header_t *hdr = shm->hdr;
+    if (hdr->magic != SHMSTATS_MAGIC || hdr->version != SHMSTATS_VERSION ||
+        hdr->size != shm->size || shmstats_size(hdr->num_threads) != shm->size) {
+        fprintf(stderr, "Error: %s has an unknown layout (version %u, expected %d)\n",
+                shm->name, hdr->version, SHMSTATS_VERSION);
+        munmap(base, shm->size);
+        shm->hdr = NULL;
+        return -1;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    shm->interval_ms = (int)hdr->interval_ms;
+    return 0;
+}
+
+void shmstats_detach(shmstats_t *shm) {
+    if (shm->hdr) {
+        munmap(shm->hdr, shm->size);
+        shm->hdr = NULL;
+        shm->threads = NULL;
+    }
+}
+
+int shmstats_read_thread(const shmstats_thread_t *t, shmstats_thread_t *out) {
+    for (int i = 0; i < SHMSTATS_READ_RETRIES; i++) {
+        uint32_t before = atomic_load_explicit(&t->seq, memory_order_acquire);
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(out, (const void *)t, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&t->seq, memory_order_relaxed) == before) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void shmstats_print_info(const shmstats_t *shm) {
+    if (!shm->hdr) {
+        return;
+    }
+    printf("Shared memory stats: /dev/shm%s, %u thread slots published every %d ms (view with udp_stat -n %s)\n",
+           shm->name, shm->hdr->num_threads, shm->interval_ms, shm->name);
+}
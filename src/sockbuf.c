@@ -0,0 +1,139 @@
+#include "../include/sockbuf.h"
+#include "../include/tsc.h"
+#include "../include/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <linux/sock_diag.h>
+
+#define SOCKBUF_RMEM_MAX_PATH "/proc/sys/net/core/rmem_max"
+#define SOCKBUF_WMEM_MAX_PATH "/proc/sys/net/core/wmem_max"
+
+int sockbuf_rcvbuf = SOCKBUF_DEFAULT_SIZE;
+int sockbuf_sndbuf = SOCKBUF_DEFAULT_SIZE;
+int sockbuf_auto = 0;
+
+// 读取sysctl整数值，失败返回-1
+static int read_sysctl_int(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    int value = -1;
+    if (fscanf(fp, "%d", &value) != 1) {
+        value = -1;
+    }
+    fclose(fp);
+    return value;
+}
+
+static int get_int_opt(int sockfd, int optname) {
+    int value = 0;
+    socklen_t len = sizeof(value);
+    if (getsockopt(sockfd, SOL_SOCKET, optname, &value, &len) < 0) {
+        return -1;
+    }
+    return value;
+}
+
+void sockbuf_apply(int sockfd) {
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &sockbuf_rcvbuf, sizeof(sockbuf_rcvbuf)) < 0) {
+        perror("setsockopt SO_RCVBUF failed");
+    }
+    if (setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &sockbuf_sndbuf, sizeof(sockbuf_sndbuf)) < 0) {
+        perror("setsockopt SO_SNDBUF failed");
+    }
+    int opt = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt)) < 0) {
+        perror("Warning: setsockopt SO_RXQ_OVFL failed, socket drops are not reported");
+    }
+}
+
+void sockbuf_read(int sockfd, sockbuf_stats_t *sb) {
+    int rcvbuf = get_int_opt(sockfd, SO_RCVBUF);
+    if (rcvbuf > 0) {
+        sb->rcvbuf = rcvbuf;
+    }
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(meminfo);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0 &&
+        len > SK_MEMINFO_DROPS * sizeof(uint32_t) && meminfo[SK_MEMINFO_DROPS] > sb->drops) {
+        __atomic_store_n(&sb->drops, meminfo[SK_MEMINFO_DROPS], __ATOMIC_RELAXED);
+    }
+}
+
+int sockbuf_autotune(int sockfd, sockbuf_stats_t *sb) {
+    if (sb->drops == sb->tuned_drops || sb->at_limit) {
+        return 0;
+    }
+    uint64_t now = tsc_now_ns();
+    if (now - sb->last_tune_ns < (uint64_t)SOCKBUF_TUNE_INTERVAL_MS * 1000000ULL) {
+        return 0;
+    }
+    sb->last_tune_ns = now;
+    sb->tuned_drops = sb->drops;
+    
+    // 内核报告的大小是请求值的两倍（含sk_buff记账开销）
+    int current = get_int_opt(sockfd, SO_RCVBUF) / 2;
+    int target = current > SOCKBUF_AUTO_MAX / 2 ? SOCKBUF_AUTO_MAX : current * 2;
+    if (target <= current) {
+        sb->at_limit = 1;
+        return 0;
+    }
+    
+    // 有CAP_NET_ADMIN时SO_RCVBUFFORCE不受rmem_max限制，否则最多扩大到rmem_max
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUFFORCE, &target, sizeof(target)) < 0) {
+        int rmem_max = read_sysctl_int(SOCKBUF_RMEM_MAX_PATH);
+        if (rmem_max > 0 && target > rmem_max) {
+            target = rmem_max;
+        }
+        if (target <= current || setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &target, sizeof(target)) < 0) {
+            sb->at_limit = 1;
+            LOG_WARN("[SOCKBUF] 接收socket已丢弃 %u 个包，接收缓冲区已达上限 %d KB (rmem_max)\n",
+                     sb->drops, current / 1024);
+            return 0;
+        }
+    }
+    sb->rcvbuf = get_int_opt(sockfd, SO_RCVBUF);
+    sb->grows++;
+    LOG_INFO("[SOCKBUF] 接收socket已丢弃 %u 个包，接收缓冲区扩大到 %d KB\n", sb->drops, target / 1024);
+    return 1;
+}
+
+void sockbuf_print_info(int sockfd) {
+    int rcvbuf = get_int_opt(sockfd, SO_RCVBUF);
+    int sndbuf = get_int_opt(sockfd, SO_SNDBUF);
+    int rmem_max = read_sysctl_int(SOCKBUF_RMEM_MAX_PATH);
+    int wmem_max = read_sysctl_int(SOCKBUF_WMEM_MAX_PATH);
+    
+    // 内核把请求值翻倍后记账，实际可用于数据的约为读回值的一半
+    printf("Socket buffers: receive %d KB requested, %d KB granted (rmem_max %d KB); "
+           "send %d KB requested, %d KB granted (wmem_max %d KB)\n",
+           sockbuf_rcvbuf / 1024, rcvbuf / 2 / 1024, rmem_max / 1024,
+           sockbuf_sndbuf / 1024, sndbuf / 2 / 1024, wmem_max / 1024);
+    if (rcvbuf / 2 < sockbuf_rcvbuf) {
+        printf("[WARNING] Receive buffer capped by net.core.rmem_max; raise it or run with CAP_NET_ADMIN\n");
+    }
+    if (sockbuf_auto) {
+        printf("Receive buffer auto-tune: doubled on socket drops, up to %d MB\n", SOCKBUF_AUTO_MAX / (1024 * 1024));
+    }
+}
+
+int sockbuf_parse_size(const char *str, int *bytes) {
+    char *end;
+    double value = strtod(str, &end);
+    if (end == str || value <= 0) {
+        return -1;
+    }
+    switch (*end) {
+        case 'k': case 'K': value *= 1024; end++; break;
+        case 'm': case 'M': value *= 1024 * 1024; end++; break;
+        default: break;
+    }
+    if (*end != '\0' || value > SOCKBUF_AUTO_MAX) {
+        return -1;
+    }
+    *bytes = (int)value;
+    return 0;
+}
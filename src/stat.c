@@ -0,0 +1,274 @@
+#include "../include/common.h"
+#include "../include/histogram.h"
+#include "../include/shmstats.h"
+
+// udp_stat：只读映射udp_server --shm发布的共享内存段，按固定间隔打印速率、丢包和延迟
+// 服务器不需要停止，也不感知监控程序的存在
+#define STAT_DEFAULT_INTERVAL_MS 1000
+#define STAT_STALE_PERIODS       5      // 心跳超过该数量的发布周期未更新时提示服务器可能已挂起
+
+static volatile int running = 1;
+
+static void signal_handler(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static void stat_usage(const char *program_name) {
+    printf("Usage: %s [options]\n", program_name);
+    printf("Description: Live statistics of a running udp_server started with --shm\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  -h              Show this help message\n");
+    printf("  -n <name>       Shared memory segment name (default: /udp_server.<port>)\n");
+    printf("  -p <port>       Server port used for the default name (default: %d)\n", DEFAULT_PORT);
+    printf("  -i <ms>         Refresh interval (default: %d)\n", STAT_DEFAULT_INTERVAL_MS);
+    printf("  -c <count>      Exit after count reports (default: until Ctrl+C or server exit)\n");
+    printf("  -T              Show one row per server thread\n");
+    printf("  -f              Show per-flow rates\n");
+    printf("\n");
+    printf("Examples:\n");
+    printf("  %s -p 8888\n", program_name);
+    printf("  %s -n udp_server.8888 -i 500 -T -f\n", program_name);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t delta(uint64_t cur, uint64_t prev) {
+    return cur > prev ? cur - prev : 0;
+}
+
+// 读取全部槽位，valid[i]标记是否读到一致快照；返回有效槽位数
+static int read_all(const shmstats_t *shm, shmstats_thread_t *out, int *valid) {
+    int count = 0;
+    for (uint32_t i = 0; i < shm->hdr->num_threads; i++) {
+        valid[i] = shmstats_read_thread(&shm->threads[i], &out[i]) == 0;
+        count += valid[i];
+    }
+    return count;
+}
+
+// 一行区间统计：cur与prev为同一线程（或汇总）的两次快照，dt为两次发布的间隔
+static void print_row(const char *label, const shmstats_thread_t *cur, const shmstats_thread_t *prev,
+                      double dt, const latency_hist_t *hist) {
+    uint64_t rx = delta(cur->packets_received, prev->packets_received);
+    uint64_t lost = delta(cur->packets_lost, prev->packets_lost);
+    printf("  %-10s rx %9.0f pps %9.2f Mbps  tx %9.0f pps %9.2f Mbps  lost %6lu (%.2f%%)  reord %lu  sock drops %lu",
+           label, rx / dt, delta(cur->bytes_received, prev->bytes_received) * 8.0 / dt / 1e6,
+           delta(cur->packets_sent, prev->packets_sent) / dt,
+           delta(cur->bytes_sent, prev->bytes_sent) * 8.0 / dt / 1e6,
+           lost, rx + lost > 0 ? lost * 100.0 / (rx + lost) : 0.0,
+           delta(cur->reordered, prev->reordered), delta(cur->socket_drops, prev->socket_drops));
+    if (hist->total_count > 0) {
+        printf("  lat p50 %.1f p99 %.1f max %.1f us",
+               hist_value_at_percentile(hist, 50.0) / 1e3, hist_value_at_percentile(hist, 99.0) / 1e3,
+               hist_value_at_percentile(hist, 100.0) / 1e3);
+    }
+    printf("\n");
+}
+
+static const shmstats_flow_t *find_flow(const shmstats_thread_t *t, const shmstats_flow_t *key) {
+    for (uint32_t i = 0; i < t->flow_count; i++) {
+        const shmstats_flow_t *f = &t->flows[i];
+        if (f->addr == key->addr && f->port == key->port && f->flow_id == key->flow_id) {
+            return f;
+        }
+    }
+    return NULL;
+}
+
+static void print_flows(const shmstats_thread_t *cur, const shmstats_thread_t *prev, int threads) {
+    printf("  %-21s %10s %8s %10s %10s %8s %10s %8s\n",
+           "flow", "flow_id", "thread", "pps", "Mbps", "lost", "avg_us", "idle_s");
+    for (int t = 0; t < threads; t++) {
+        double dt = (cur[t].publish_ns - prev[t].publish_ns) / 1e9;
+        for (uint32_t i = 0; i < cur[t].flow_count; i++) {
+            const shmstats_flow_t *f = &cur[t].flows[i];
+            const shmstats_flow_t *p = find_flow(&prev[t], f);
+            char addr[INET_ADDRSTRLEN + 8];
+            char ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &f->addr, ip, sizeof(ip));
+            snprintf(addr, sizeof(addr), "%s:%u", ip, ntohs(f->port));
+            double pps = (p && dt > 0) ? delta(f->packets, p->packets) / dt : 0.0;
+            double mbps = (p && dt > 0) ? delta(f->bytes, p->bytes) * 8.0 / dt / 1e6 : 0.0;
+            printf("  %-21s %10u %8d %10.0f %10.2f %8lu %10.1f %8.1f\n", addr, f->flow_id, t, pps, mbps,
+                   f->lost, f->latency_count > 0 ? f->latency_sum_ns / 1e3 / f->latency_count : 0.0,
+                   f->idle_ns / 1e9);
+        }
+        if (cur[t].flows_active > cur[t].flow_count) {
+            printf("  (thread %d: %u more active flows not published)\n", t, cur[t].flows_active - cur[t].flow_count);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *name = NULL;
+    int port = DEFAULT_PORT;
+    int interval_ms = STAT_DEFAULT_INTERVAL_MS;
+    int count = 0;
+    int per_thread = 0;
+    int show_flows = 0;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "hn:p:i:c:Tf")) != -1) {
+        switch (opt) {
+            case 'h':
+                stat_usage(argv[0]);
+                return 0;
+            case 'n':
+                name = optarg;
+                break;
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'i':
+                interval_ms = atoi(optarg);
+                if (interval_ms < 10) {
+                    fprintf(stderr, "Error: -i must be at least 10 ms\n");
+                    return 1;
+                }
+                break;
+            case 'c':
+                count = atoi(optarg);
+                break;
+            case 'T':
+                per_thread = 1;
+                break;
+            case 'f':
+                show_flows = 1;
+                break;
+            default:
+                stat_usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    char default_name[SHMSTATS_NAME_MAX];
+    if (!name) {
+        shmstats_default_name(default_name, sizeof(default_name), port);
+        name = default_name;
+    }
+    shmstats_t shm;
+    if (shmstats_attach(&shm, name) < 0) {
+        return 1;
+    }
+    
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    
+    const shmstats_header_t *hdr = shm.hdr;
+    int threads = (int)hdr->num_threads;
+    shmstats_thread_t *prev = calloc(threads, sizeof(shmstats_thread_t));
+    shmstats_thread_t *cur = calloc(threads, sizeof(shmstats_thread_t));
+    int *prev_valid = calloc(threads, sizeof(int));
+    int *cur_valid = calloc(threads, sizeof(int));
+    shmstats_thread_t *sum_prev = calloc(1, sizeof(shmstats_thread_t));
+    shmstats_thread_t *sum_cur = calloc(1, sizeof(shmstats_thread_t));
+    if (!prev || !cur || !prev_valid || !cur_valid || !sum_prev || !sum_cur) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+    
+    printf("Attached to /dev/shm%s: udp_server pid %d on %s:%u, %d thread slots, published every %u ms\n",
+           shm.name, hdr->pid, hdr->bind_ip, hdr->port, threads, hdr->interval_ms);
+    read_all(&shm, prev, prev_valid);
+    
+    int reports = 0;
+    while (running) {
+        usleep((useconds_t)interval_ms * 1000);
+        int server_running = atomic_load_explicit(&hdr->running, memory_order_acquire);
+        read_all(&shm, cur, cur_valid);
+        
+        // 区间延迟分布：各线程快照逐桶相减后合并
+        memset(sum_prev, 0, sizeof(*sum_prev));
+        memset(sum_cur, 0, sizeof(*sum_cur));
+        latency_hist_t total_hist;
+        hist_reset(&total_hist);
+        double dt_max = 0;
+        for (int t = 0; t < threads; t++) {
+            if (!prev_valid[t] || !cur_valid[t] || cur[t].publish_ns <= prev[t].publish_ns) {
+                continue;
+            }
+            double dt = (cur[t].publish_ns - prev[t].publish_ns) / 1e9;
+            if (dt > dt_max) {
+                dt_max = dt;
+            }
+            latency_hist_t hist;
+            hist_delta(&hist, &cur[t].latency, &prev[t].latency);
+            hist_merge(&total_hist, &hist);
+        }
+        
+        uint64_t now = now_ns();
+        uint64_t heartbeat = atomic_load_explicit(&hdr->heartbeat_ns, memory_order_relaxed);
+        time_t wall = time(NULL);
+        struct tm tm;
+        localtime_r(&wall, &tm);
+        printf("\n[%02d:%02d:%02d] up %.1f s%s\n", tm.tm_hour, tm.tm_min, tm.tm_sec,
+               (now > hdr->start_ns ? now - hdr->start_ns : 0) / 1e9,
+               !server_running ? ", server exited" :
+               now > heartbeat + (uint64_t)STAT_STALE_PERIODS * hdr->interval_ms * 1000000ULL ?
+               ", stale (server not publishing)" : "");
+        
+        // 各线程的发布时刻相差不超过一个发布周期，汇总行以最长的间隔计算速率
+        for (int t = 0; t < threads; t++) {
+            if (!prev_valid[t] || !cur_valid[t]) {
+                continue;
+            }
+            sum_prev->packets_received += prev[t].packets_received;
+            sum_prev->bytes_received += prev[t].bytes_received;
+            sum_prev->packets_sent += prev[t].packets_sent;
+            sum_prev->bytes_sent += prev[t].bytes_sent;
+            sum_prev->packets_lost += prev[t].packets_lost;
+            sum_prev->reordered += prev[t].reordered;
+            sum_prev->socket_drops += prev[t].socket_drops;
+            sum_cur->packets_received += cur[t].packets_received;
+            sum_cur->bytes_received += cur[t].bytes_received;
+            sum_cur->packets_sent += cur[t].packets_sent;
+            sum_cur->bytes_sent += cur[t].bytes_sent;
+            sum_cur->packets_lost += cur[t].packets_lost;
+            sum_cur->reordered += cur[t].reordered;
+            sum_cur->socket_drops += cur[t].socket_drops;
+        }
+        print_row("total", sum_cur, sum_prev, dt_max > 0 ? dt_max : interval_ms / 1e3, &total_hist);
+        if (per_thread) {
+            for (int t = 0; t < threads; t++) {
+                if (!prev_valid[t] || !cur_valid[t] || cur[t].publish_ns <= prev[t].publish_ns) {
+                    continue;
+                }
+                char label[32];
+                snprintf(label, sizeof(label), "[%d] %s", t,
+                         cur[t].role == SHMSTATS_ROLE_PIPELINE ? "pipe" : "recv");
+                latency_hist_t hist;
+                hist_delta(&hist, &cur[t].latency, &prev[t].latency);
+                print_row(label, &cur[t], &prev[t], (cur[t].publish_ns - prev[t].publish_ns) / 1e9, &hist);
+            }
+        }
+        if (show_flows) {
+            print_flows(cur, prev, threads);
+        }
+        fflush(stdout);
+        
+        shmstats_thread_t *tmp = prev;
+        prev = cur;
+        cur = tmp;
+        int *tmp_valid = prev_valid;
+        prev_valid = cur_valid;
+        cur_valid = tmp_valid;
+        if (!server_running || (count > 0 && ++reports >= count)) {
+            break;
+        }
+    }
+    
+    free(prev);
+    free(cur);
+    free(prev_valid);
+    free(cur_valid);
+    free(sum_prev);
+    free(sum_cur);
+    shmstats_detach(&shm);
+    return 0;
+}
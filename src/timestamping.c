@@ -0,0 +1,166 @@
+#include "../include/common.h"
+#include "../include/timestamping.h"
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+
+static uint64_t timespec_to_ns(const struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+uint64_t ts_realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return timespec_to_ns(&ts);
+}
+
+// 在网卡上开启硬件时间戳（需要root权限和驱动支持）
+static int enable_hw_timestamping(int sockfd, const char *ifname, int want_tx) {
+    struct hwtstamp_config config;
+    struct ifreq ifr;
+    
+    memset(&config, 0, sizeof(config));
+    config.tx_type = want_tx ? HWTSTAMP_TX_ON : HWTSTAMP_TX_OFF;
+    config.rx_filter = HWTSTAMP_FILTER_ALL;
+    
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    ifr.ifr_data = (char *)&config;
+    
+    if (ioctl(sockfd, SIOCSHWTSTAMP, &ifr) < 0) {
+        return -1;
+    }
+    // 部分驱动不支持FILTER_ALL，会降级为只对PTP包打时间戳
+    if (config.rx_filter == HWTSTAMP_FILTER_NONE) {
+        return -1;
+    }
+    return 0;
+}
+
+// 启用SO_TIMESTAMPING
+int ts_enable(int sockfd, int mode, const char *ifname, int want_tx) {
+    if (mode == TS_MODE_OFF) {
+        return TS_MODE_OFF;
+    }
+    
+    if (mode == TS_MODE_HARDWARE) {
+        if (!ifname) {
+            fprintf(stderr, "Warning: Hardware timestamping needs an interface, using software timestamps\n");
+            mode = TS_MODE_SOFTWARE;
+        } else if (enable_hw_timestamping(sockfd, ifname, want_tx) < 0) {
+            fprintf(stderr, "Warning: Hardware timestamping unavailable on %s (%s), using software timestamps\n",
+                    ifname, strerror(errno));
+            mode = TS_MODE_SOFTWARE;
+        }
+    }
+    
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (want_tx) {
+        flags |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    }
+    if (mode == TS_MODE_HARDWARE) {
+        flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+        if (want_tx) {
+            flags |= SOF_TIMESTAMPING_TX_HARDWARE;
+        }
+    }
+    
+    if (setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+        perror("setsockopt SO_TIMESTAMPING failed");
+        return -1;
+    }
+    return mode;
+}
+
+// 从控制消息中提取SCM_TIMESTAMPING（ts[0]为软件时间戳，ts[2]为硬件原始时间戳）
+static int extract_timestamping(const struct msghdr *msg, kernel_ts_t *ts) {
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR((struct msghdr *)msg); cmsg;
+         cmsg = CMSG_NXTHDR((struct msghdr *)msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            struct scm_timestamping tss;
+            memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));
+            ts->sw_ns = timespec_to_ns(&tss.ts[0]);
+            ts->hw_ns = timespec_to_ns(&tss.ts[2]);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int ts_get_rx(const struct msghdr *msg, kernel_ts_t *ts) {
+    ts->sw_ns = 0;
+    ts->hw_ns = 0;
+    return extract_timestamping(msg, ts);
+}
+
+// 读取错误队列中的发送时间戳（跳过ICMP错误等其他消息）
+int ts_read_tx(int sockfd, uint32_t *id, kernel_ts_t *ts) {
+    char control[TS_CONTROL_LEN];
+    struct msghdr msg;
+    
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        
+        if (recvmsg(sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            return -1;
+        }
+        
+        int have_ts = 0, have_id = 0;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                struct scm_timestamping tss;
+                memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));
+                ts->sw_ns = timespec_to_ns(&tss.ts[0]);
+                ts->hw_ns = timespec_to_ns(&tss.ts[2]);
+                have_ts = 1;
+            } else if ((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                       (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+                struct sock_extended_err serr;
+                memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+                if (serr.ee_errno == ENOMSG && serr.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                    *id = serr.ee_data;
+                    have_id = 1;
+                }
+            }
+        }
+        if (have_ts && have_id) {
+            return 1;
+        }
+    }
+}
+
+void ts_breakdown_reset(ts_breakdown_t *breakdown) {
+    hist_reset(&breakdown->app_to_kernel_tx);
+    hist_reset(&breakdown->wire);
+    hist_reset(&breakdown->kernel_rx_to_app);
+}
+
+void ts_breakdown_merge(ts_breakdown_t *dst, const ts_breakdown_t *src) {
+    hist_merge(&dst->app_to_kernel_tx, &src->app_to_kernel_tx);
+    hist_merge(&dst->wire, &src->wire);
+    hist_merge(&dst->kernel_rx_to_app, &src->kernel_rx_to_app);
+}
+
+// 打印延迟分解
+void ts_print_breakdown(const ts_breakdown_t *breakdown) {
+    printf("\n--- 延迟分解（SO_TIMESTAMPING） ---\n");
+    if (breakdown->app_to_kernel_tx.total_count > 0) {
+        printf("[应用发送→内核发送] ");
+        print_latency_percentiles(&breakdown->app_to_kernel_tx);
+    }
+    if (breakdown->wire.total_count > 0) {
+        printf("[线路与协议栈]       ");
+        print_latency_percentiles(&breakdown->wire);
+    }
+    if (breakdown->kernel_rx_to_app.total_count > 0) {
+        printf("[内核接收→应用]     ");
+        print_latency_percentiles(&breakdown->kernel_rx_to_app);
+    }
+}
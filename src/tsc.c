@@ -0,0 +1,149 @@
+#include "../include/tsc.h"
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#define TSC_SAMPLE_TRIES  8         // 每次对齐取读数夹逼最紧的一次
+#define TSC_COST_LOOPS    100000    // 测量单次读取开销的循环次数
+
+tsc_clock_t tsc_clock;
+_Thread_local uint64_t tsc_last_ns;
+
+uint64_t tsc_fallback_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 计数器频率恒定且各核同步时才可以直接换算时间
+static int tsc_supported(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    return (edx & (1U << 8)) != 0;     // invariant TSC
+#elif defined(__aarch64__)
+    return 1;                           // 通用定时器按固定频率计数
+#else
+    return 0;
+#endif
+}
+
+// 用两次计数器读数夹住一次clock_gettime()，取间隔最小的一组，以中点作为对应的计数器值
+static void tsc_sample(uint64_t *cycles, uint64_t *ns) {
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < TSC_SAMPLE_TRIES; i++) {
+        uint64_t before = tsc_read();
+        uint64_t now = tsc_fallback_ns();
+        uint64_t after = tsc_read();
+        if (after - before < best) {
+            best = after - before;
+            *cycles = before + (after - before) / 2;
+            *ns = now;
+        }
+    }
+}
+
+static void tsc_publish(uint64_t cycles, uint64_t ns, uint64_t mult, uint64_t rate) {
+    uint32_t seq = atomic_load_explicit(&tsc_clock.seq, memory_order_relaxed);
+    atomic_store_explicit(&tsc_clock.seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&tsc_clock.base_cycles, cycles, memory_order_relaxed);
+    atomic_store_explicit(&tsc_clock.base_ns, ns, memory_order_relaxed);
+    atomic_store_explicit(&tsc_clock.mult, mult, memory_order_relaxed);
+    atomic_store_explicit(&tsc_clock.rate, rate, memory_order_relaxed);
+    atomic_store_explicit(&tsc_clock.seq, seq + 2, memory_order_release);
+}
+
+int tsc_init(void) {
+    if (!tsc_supported()) {
+        return -1;
+    }
+    
+    uint64_t c0, ns0, c1, ns1;
+    tsc_sample(&c0, &ns0);
+    struct timespec wait = { 0, TSC_CALIBRATE_MS * 1000000L };
+    nanosleep(&wait, NULL);
+    tsc_sample(&c1, &ns1);
+    if (c1 <= c0 || ns1 <= ns0) {
+        return -1;
+    }
+    
+    uint64_t mult = (uint64_t)(((unsigned __int128)(ns1 - ns0) << TSC_SHIFT) / (c1 - c0));
+    tsc_clock.freq_hz = (uint64_t)((unsigned __int128)(c1 - c0) * 1000000000ULL / (ns1 - ns0));
+    tsc_clock.init_cycles = c0;
+    tsc_clock.init_ns = ns0;
+    tsc_clock.resync_cycles = tsc_clock.freq_hz / 1000 * TSC_RESYNC_MS;
+    tsc_publish(c1, ns1, mult, mult);
+    tsc_clock.enabled = 1;
+    return 0;
+}
+
+// 对照CLOCK_MONOTONIC_RAW修正换算参数：新对齐点取旧参数在该时刻外推的值（读数连续），
+// 换算系数选为在下一个重新对齐周期结束时与参考时钟重合；频率用自启动以来的长窗口计算
+// 同一时刻只有一个线程执行，其余线程继续使用旧参数
+void tsc_resync(void) {
+    if (atomic_exchange_explicit(&tsc_clock.resyncing, 1, memory_order_acquire)) {
+        return;
+    }
+    uint64_t cycles, ns;
+    tsc_sample(&cycles, &ns);
+    uint64_t base_cycles = atomic_load_explicit(&tsc_clock.base_cycles, memory_order_relaxed);
+    uint64_t base_ns = atomic_load_explicit(&tsc_clock.base_ns, memory_order_relaxed);
+    uint64_t mult = atomic_load_explicit(&tsc_clock.mult, memory_order_relaxed);
+    uint64_t old_rate = atomic_load_explicit(&tsc_clock.rate, memory_order_relaxed);
+    if (cycles > base_cycles && cycles > tsc_clock.init_cycles && ns > tsc_clock.init_ns) {
+        uint64_t rate = (uint64_t)(((unsigned __int128)(ns - tsc_clock.init_ns) << TSC_SHIFT) /
+                                   (cycles - tsc_clock.init_cycles));
+        // 与tsc_now_ns()相同的外推：超出一个周期的部分按旧的标定频率
+        uint64_t elapsed = cycles - base_cycles;
+        uint64_t slewed = elapsed < tsc_clock.resync_cycles ? elapsed : tsc_clock.resync_cycles;
+        uint64_t cur_ns = base_ns + (uint64_t)(((unsigned __int128)slewed * mult) >> TSC_SHIFT) +
+                          (uint64_t)(((unsigned __int128)(elapsed - slewed) * old_rate) >> TSC_SHIFT);
+        uint64_t target_ns = ns + (uint64_t)(((unsigned __int128)tsc_clock.resync_cycles * rate) >> TSC_SHIFT);
+        // 调整幅度限制在频率的一半到两倍之间，偏差过大时分几个周期追上
+        uint64_t new_mult = rate / 2;
+        if (target_ns > cur_ns) {
+            new_mult = (uint64_t)(((unsigned __int128)(target_ns - cur_ns) << TSC_SHIFT) / tsc_clock.resync_cycles);
+            if (new_mult < rate / 2) {
+                new_mult = rate / 2;
+            } else if (new_mult > rate * 2) {
+                new_mult = rate * 2;
+            }
+        }
+        tsc_publish(cycles, cur_ns, new_mult, rate);
+    }
+    atomic_store_explicit(&tsc_clock.resyncing, 0, memory_order_release);
+}
+
+void tsc_print_info(void) {
+    volatile uint64_t sink = 0;
+    uint64_t start = tsc_fallback_ns();
+    for (int i = 0; i < TSC_COST_LOOPS; i++) {
+        sink += tsc_now_ns();
+    }
+    uint64_t counter_cost = tsc_fallback_ns() - start;
+    start = tsc_fallback_ns();
+    for (int i = 0; i < TSC_COST_LOOPS; i++) {
+        sink += tsc_fallback_ns();
+    }
+    uint64_t syscall_cost = tsc_fallback_ns() - start;
+    (void)sink;
+    
+    if (tsc_clock.enabled) {
+        printf("Timestamp clock: %s %.3f MHz, %.1f ns/read (clock_gettime %.1f ns/read)\n",
+#if defined(__aarch64__)
+               "CNTVCT_EL0",
+#else
+               "TSC",
+#endif
+               tsc_clock.freq_hz / 1e6,
+               (double)counter_cost / TSC_COST_LOOPS, (double)syscall_cost / TSC_COST_LOOPS);
+    } else {
+        printf("Timestamp clock: clock_gettime(CLOCK_MONOTONIC_RAW), %.1f ns/read (cycle counter unavailable)\n",
+               (double)syscall_cost / TSC_COST_LOOPS);
+    }
+}
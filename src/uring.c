@@ -0,0 +1,294 @@
+#include "../include/common.h"
+#include "../include/uring.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                              void *arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int parse_io_backend(const char *str, int *backend) {
+    if (strcmp(str, "socket") == 0) {
+        *backend = IO_BACKEND_SOCKET;
+    } else if (strcmp(str, "uring") == 0 || strcmp(str, "io_uring") == 0) {
+        *backend = IO_BACKEND_URING;
+    } else if (strcmp(str, "xdp") == 0 || strcmp(str, "af_xdp") == 0) {
+        *backend = IO_BACKEND_XDP;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int uring_init(uring_t *ring, unsigned entries) {
+    struct io_uring_params params;
+    
+    memset(ring, 0, sizeof(*ring));
+    ring->ring_fd = -1;
+    
+    // COOP_TASKRUN（5.19+）减少完成通知的处理器间中断，旧内核不支持时退回默认设置
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    int fd = sys_io_uring_setup(entries, &params);
+    if (fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        fd = sys_io_uring_setup(entries, &params);
+    }
+    if (fd < 0) {
+        return -1;
+    }
+    ring->ring_fd = fd;
+    
+    // 映射提交队列、完成队列和SQE数组
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    
+    ring->sq_ring_ptr = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring_ptr == MAP_FAILED) {
+        ring->sq_ring_ptr = NULL;
+        uring_free(ring);
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring_ptr = ring->sq_ring_ptr;
+    } else {
+        ring->cq_ring_ptr = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring_ptr == MAP_FAILED) {
+            ring->cq_ring_ptr = NULL;
+            uring_free(ring);
+            return -1;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        uring_free(ring);
+        return -1;
+    }
+    
+    char *sq = ring->sq_ring_ptr;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sqe_tail = *ring->sq_tail;
+    
+    // SQ索引数组固定为恒等映射，之后只需推进尾部
+    unsigned *array = (unsigned *)(sq + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++) {
+        array[i] = i;
+    }
+    
+    char *cq = ring->cq_ring_ptr;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+void uring_free(uring_t *ring) {
+    // 先关闭ring，内核随之取消未完成的请求（包括多发接收）
+    if (ring->ring_fd >= 0) {
+        close(ring->ring_fd);
+    }
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring_ptr && ring->cq_ring_ptr != ring->sq_ring_ptr) {
+        munmap(ring->cq_ring_ptr, ring->cq_ring_size);
+    }
+    if (ring->sq_ring_ptr) {
+        munmap(ring->sq_ring_ptr, ring->sq_ring_size);
+    }
+    if (ring->buf_ring) {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+    }
+    free(ring->buffers);
+    memset(ring, 0, sizeof(*ring));
+    ring->ring_fd = -1;
+}
+
+int uring_setup_buffers(uring_t *ring, unsigned count, size_t control_len) {
+    // 多发recvmsg的缓冲区布局：io_uring_recvmsg_out | 源地址 | 控制消息 | 负载
+    ring->recv_template.msg_namelen = sizeof(struct sockaddr_in);
+    ring->recv_template.msg_controllen = control_len;
+    ring->buf_size = sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) +
+                     control_len + MAX_BUFFER_SIZE;
+    ring->buf_count = count;
+    ring->buf_mask = count - 1;
+    
+    ring->buffers = malloc(ring->buf_size * count);
+    if (!ring->buffers) {
+        errno = ENOMEM;
+        return -1;
+    }
+    
+    // 缓冲区环必须页对齐，用匿名映射分配
+    ring->buf_ring_size = count * sizeof(struct io_uring_buf);
+    void *mem = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return -1;
+    }
+    ring->buf_ring = mem;
+    
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = count;
+    reg.bgid = URING_BUF_GROUP;
+    if (sys_io_uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return -1;
+    }
+    
+    ring->buf_tail = 0;
+    for (unsigned i = 0; i < count; i++) {
+        uring_buf_recycle(ring, i);
+    }
+    uring_buf_publish(ring);
+    return 0;
+}
+
+struct io_uring_sqe *uring_get_sqe(uring_t *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sqe_tail - head >= ring->sq_entries) {
+        return NULL;
+    }
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int uring_submit(uring_t *ring, unsigned wait_nr, int timeout_ms) {
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    
+    unsigned flags = 0;
+    void *arg = NULL;
+    size_t arg_size = 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg ext;
+    if (wait_nr > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout_ms >= 0) {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+            memset(&ext, 0, sizeof(ext));
+            ext.ts = (uint64_t)(uintptr_t)&ts;
+            flags |= IORING_ENTER_EXT_ARG;
+            arg = &ext;
+            arg_size = sizeof(ext);
+        }
+    }
+    if (to_submit == 0 && wait_nr == 0) {
+        return 0;
+    }
+    
+    int ret = sys_io_uring_enter(ring->ring_fd, to_submit, wait_nr, flags, arg, arg_size);
+    if (ret < 0) {
+        if (errno == ETIME) {
+            return 0;
+        }
+        return -1;
+    }
+    return ret;
+}
+
+struct io_uring_cqe *uring_peek_cqe(uring_t *ring) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+void uring_cqe_seen(uring_t *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+void uring_prep_recvmsg_multishot(uring_t *ring, struct io_uring_sqe *sqe, int fd, uint64_t user_data) {
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)&ring->recv_template;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = user_data;
+}
+
+void uring_prep_sendmsg(struct io_uring_sqe *sqe, int fd, const struct msghdr *msg, uint64_t user_data) {
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->user_data = user_data;
+}
+
+int uring_recv_parse(uring_t *ring, const struct io_uring_cqe *cqe, uring_recv_t *out) {
+    if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+        return -1;
+    }
+    out->bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    
+    char *buf = ring->buffers + (size_t)out->bid * ring->buf_size;
+    const struct io_uring_recvmsg_out *hdr = (const struct io_uring_recvmsg_out *)buf;
+    char *name = buf + sizeof(*hdr);
+    char *control = name + ring->recv_template.msg_namelen;
+    
+    out->addr = (struct sockaddr_in *)name;
+    out->payload = control + ring->recv_template.msg_controllen;
+    out->payload_len = hdr->payloadlen;
+    memset(&out->msg, 0, sizeof(out->msg));
+    out->msg.msg_name = name;
+    out->msg.msg_namelen = hdr->namelen;
+    if (hdr->controllen > 0) {
+        out->msg.msg_control = control;
+        out->msg.msg_controllen = hdr->controllen;
+    }
+    out->msg.msg_flags = hdr->flags;
+    return 0;
+}
+
+void uring_buf_recycle(uring_t *ring, unsigned bid) {
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[ring->buf_tail & ring->buf_mask];
+    buf->addr = (uint64_t)(uintptr_t)(ring->buffers + (size_t)bid * ring->buf_size);
+    buf->len = (uint32_t)ring->buf_size;
+    buf->bid = (uint16_t)bid;
+    ring->buf_tail++;
+}
+
+void uring_buf_publish(uring_t *ring) {
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+int uring_probe(void) {
+    uring_t ring;
+    if (uring_init(&ring, 8) < 0) {
+        return -1;
+    }
+    int ret = uring_setup_buffers(&ring, 1, 0);
+    uring_free(&ring);
+    return ret;
+}
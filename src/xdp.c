@@ -0,0 +1,664 @@
+#include "../include/xdp.h"
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <net/if.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <ifaddrs.h>
+#include <poll.h>
+#include <stddef.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+#define NEIGH_RESOLVE_TIMEOUT_MS 1000   // 等待ARP解析下一跳MAC的最长时间
+
+static int sys_bpf(int cmd, union bpf_attr *attr) {
+    return (int)syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+int parse_xsk_mode(const char *str, int *mode) {
+    if (strcmp(str, "skb") == 0 || strcmp(str, "generic") == 0) {
+        *mode = XSK_MODE_SKB;
+    } else if (strcmp(str, "native") == 0 || strcmp(str, "drv") == 0) {
+        *mode = XSK_MODE_NATIVE;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// ==================== XDP程序 ====================
+
+#define BPF_INSN(c, d, s, o, i) \
+    ((struct bpf_insn){ .code = (c), .dst_reg = (d), .src_reg = (s), .off = (o), .imm = (i) })
+
+// 构造重定向程序，返回指令数。等价于：
+//   if (IPv4 && ihl == 5 && 非分片 && proto == UDP && dport == port && (!ip || daddr == ip))
+//       return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS);
+//   return XDP_PASS;
+// 常量按网络字节序直接与包内字段比较（32位比较，避免立即数符号扩展）
+static int build_redirect_prog(struct bpf_insn *insns, int map_fd, uint32_t dst_ip, uint16_t dst_port) {
+    enum { PASS = 24 };   // 下方PASS标签处的指令下标
+    int n = 0;
+    
+    insns[n++] = BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0);
+    insns[n++] = BPF_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1, offsetof(struct xdp_md, data), 0);
+    insns[n++] = BPF_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_1, offsetof(struct xdp_md, data_end), 0);
+    insns[n++] = BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+    insns[n++] = BPF_INSN(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, UDP_FRAME_HDR_LEN);
+    insns[n] = BPF_INSN(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, PASS - n - 1, 0);
+    n++;
+    
+    // 以太网类型、版本/首部长度、分片、协议、目的端口、目的地址
+    insns[n++] = BPF_INSN(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 12, 0);
+    insns[n] = BPF_INSN(BPF_JMP32 | BPF_JNE | BPF_K, BPF_REG_5, 0, PASS - n - 1, htons(ETH_P_IP));
+    n++;
+    insns[n++] = BPF_INSN(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, ETH_HLEN, 0);
+    insns[n] = BPF_INSN(BPF_JMP32 | BPF_JNE | BPF_K, BPF_REG_5, 0, PASS - n - 1, 0x45);
+    n++;
+    insns[n++] = BPF_INSN(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, ETH_HLEN + 6, 0);
+    insns[n] = BPF_INSN(BPF_JMP32 | BPF_JSET | BPF_K, BPF_REG_5, 0, PASS - n - 1, htons(IP_MF | IP_OFFMASK));
+    n++;
+    insns[n++] = BPF_INSN(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, ETH_HLEN + 9, 0);
+    insns[n] = BPF_INSN(BPF_JMP32 | BPF_JNE | BPF_K, BPF_REG_5, 0, PASS - n - 1, IPPROTO_UDP);
+    n++;
+    insns[n++] = BPF_INSN(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, ETH_HLEN + 20 + 2, 0);
+    insns[n] = BPF_INSN(BPF_JMP32 | BPF_JNE | BPF_K, BPF_REG_5, 0, PASS - n - 1, dst_port);
+    n++;
+    insns[n++] = BPF_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_5, BPF_REG_2, ETH_HLEN + 16, 0);
+    if (dst_ip != 0) {
+        insns[n] = BPF_INSN(BPF_JMP32 | BPF_JNE | BPF_K, BPF_REG_5, 0, PASS - n - 1, (int32_t)dst_ip);
+    } else {
+        insns[n] = BPF_INSN(BPF_JMP | BPF_JA, 0, 0, 0, 0);
+    }
+    n++;
+    
+    // bpf_redirect_map(map, rx_queue_index, XDP_PASS)：队列未注册socket时交给协议栈
+    insns[n++] = BPF_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, rx_queue_index), 0);
+    insns[n++] = BPF_INSN(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, map_fd);
+    insns[n++] = BPF_INSN(0, 0, 0, 0, 0);
+    insns[n++] = BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS);
+    insns[n++] = BPF_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map);
+    insns[n++] = BPF_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+    
+    // PASS:
+    insns[n++] = BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS);
+    insns[n++] = BPF_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+    return n;
+}
+
+int xdp_prog_attach(xdp_prog_t *prog, int ifindex, uint32_t dst_ip, uint16_t dst_port,
+                    int mode, int max_queues) {
+    union bpf_attr attr;
+    
+    prog->prog_fd = prog->map_fd = prog->link_fd = -1;
+    prog->ifindex = ifindex;
+    
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(int);
+    attr.value_size = sizeof(int);
+    attr.max_entries = max_queues;
+    prog->map_fd = sys_bpf(BPF_MAP_CREATE, &attr);
+    if (prog->map_fd < 0) {
+        perror("bpf(BPF_MAP_CREATE) XSKMAP failed");
+        return -1;
+    }
+    
+    struct bpf_insn insns[32];
+    int insn_cnt = build_redirect_prog(insns, prog->map_fd, dst_ip, dst_port);
+    static char log_buf[4096];
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uint64_t)(uintptr_t)insns;
+    attr.insn_cnt = insn_cnt;
+    attr.license = (uint64_t)(uintptr_t)"GPL";
+    attr.log_buf = (uint64_t)(uintptr_t)log_buf;
+    attr.log_size = sizeof(log_buf);
+    attr.log_level = 1;
+    prog->prog_fd = sys_bpf(BPF_PROG_LOAD, &attr);
+    if (prog->prog_fd < 0) {
+        perror("bpf(BPF_PROG_LOAD) failed");
+        if (log_buf[0]) {
+            fprintf(stderr, "%s\n", log_buf);
+        }
+        xdp_prog_detach(prog);
+        return -1;
+    }
+    
+    // bpf_link挂载（5.9+）：进程异常退出时内核自动卸载，不会在网卡上残留程序
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = prog->prog_fd;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = (mode == XSK_MODE_NATIVE) ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+    prog->link_fd = sys_bpf(BPF_LINK_CREATE, &attr);
+    if (prog->link_fd < 0) {
+        perror(errno == EBUSY ? "XDP attach failed (another XDP program is attached)"
+                              : "bpf(BPF_LINK_CREATE) XDP attach failed");
+        xdp_prog_detach(prog);
+        return -1;
+    }
+    return 0;
+}
+
+int xdp_prog_register(xdp_prog_t *prog, int queue_id, int xsk_fd) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = prog->map_fd;
+    attr.key = (uint64_t)(uintptr_t)&queue_id;
+    attr.value = (uint64_t)(uintptr_t)&xsk_fd;
+    attr.flags = BPF_ANY;
+    if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+        perror("bpf(BPF_MAP_UPDATE_ELEM) XSKMAP failed");
+        return -1;
+    }
+    return 0;
+}
+
+void xdp_prog_detach(xdp_prog_t *prog) {
+    if (prog->link_fd >= 0) {
+        close(prog->link_fd);
+    }
+    if (prog->prog_fd >= 0) {
+        close(prog->prog_fd);
+    }
+    if (prog->map_fd >= 0) {
+        close(prog->map_fd);
+    }
+    prog->prog_fd = prog->map_fd = prog->link_fd = -1;
+}
+
+// ==================== AF_XDP socket ====================
+
+static int xsk_map_ring(xsk_t *xsk, xsk_ring_t *ring, const struct xdp_ring_offset *off,
+                        size_t desc_size, off_t pgoff) {
+    ring->map_size = off->desc + XSK_RING_SIZE * desc_size;
+    ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     xsk->fd, pgoff);
+    if (ring->map == MAP_FAILED) {
+        ring->map = NULL;
+        return -1;
+    }
+    ring->producer = (uint32_t *)((char *)ring->map + off->producer);
+    ring->consumer = (uint32_t *)((char *)ring->map + off->consumer);
+    ring->flags = (uint32_t *)((char *)ring->map + off->flags);
+    ring->descs = (char *)ring->map + off->desc;
+    ring->size = XSK_RING_SIZE;
+    ring->mask = XSK_RING_SIZE - 1;
+    return 0;
+}
+
+static void xsk_unmap_ring(xsk_ring_t *ring) {
+    if (ring->map) {
+        munmap(ring->map, ring->map_size);
+        ring->map = NULL;
+    }
+}
+
+// 生产者环的空闲槽位数
+static uint32_t ring_prod_free(const xsk_ring_t *ring) {
+    return ring->size - (ring->local - __atomic_load_n(ring->consumer, __ATOMIC_ACQUIRE));
+}
+
+// 消费者环的可读描述符数
+static uint32_t ring_cons_avail(const xsk_ring_t *ring) {
+    return __atomic_load_n(ring->producer, __ATOMIC_ACQUIRE) - ring->local;
+}
+
+int xsk_open(xsk_t *xsk, int ifindex, int queue_id, int mode, int want_rx) {
+    memset(xsk, 0, sizeof(*xsk));
+    xsk->ifindex = ifindex;
+    xsk->queue_id = queue_id;
+    xsk->has_rx = want_rx;
+    
+    xsk->fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (xsk->fd < 0) {
+        perror("socket(AF_XDP) failed");
+        return -1;
+    }
+    
+    // 注册UMEM：一块页对齐的连续内存，按XSK_FRAME_SIZE切分为帧
+    xsk->umem_size = (size_t)XSK_NUM_FRAMES * XSK_FRAME_SIZE;
+    xsk->umem = mmap(NULL, xsk->umem_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (xsk->umem == MAP_FAILED) {
+        xsk->umem = NULL;
+        perror("mmap UMEM failed");
+        xsk_close(xsk);
+        return -1;
+    }
+    struct xdp_umem_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.addr = (uint64_t)(uintptr_t)xsk->umem;
+    reg.len = xsk->umem_size;
+    reg.chunk_size = XSK_FRAME_SIZE;
+    reg.headroom = 0;
+    if (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+        perror("setsockopt XDP_UMEM_REG failed");
+        xsk_close(xsk);
+        return -1;
+    }
+    
+    // 填充环和完成环属于UMEM，接收环和发送环属于socket
+    int ring_size = XSK_RING_SIZE;
+    if (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_FILL_RING, &ring_size, sizeof(ring_size)) < 0 ||
+        setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ring_size, sizeof(ring_size)) < 0 ||
+        (want_rx && setsockopt(xsk->fd, SOL_XDP, XDP_RX_RING, &ring_size, sizeof(ring_size)) < 0) ||
+        setsockopt(xsk->fd, SOL_XDP, XDP_TX_RING, &ring_size, sizeof(ring_size)) < 0) {
+        perror("setsockopt XDP ring size failed");
+        xsk_close(xsk);
+        return -1;
+    }
+    
+    struct xdp_mmap_offsets off;
+    socklen_t optlen = sizeof(off);
+    if (getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0) {
+        perror("getsockopt XDP_MMAP_OFFSETS failed");
+        xsk_close(xsk);
+        return -1;
+    }
+    if (xsk_map_ring(xsk, &xsk->fill, &off.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) < 0 ||
+        xsk_map_ring(xsk, &xsk->comp, &off.cr, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING) < 0 ||
+        (want_rx && xsk_map_ring(xsk, &xsk->rx, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) < 0) ||
+        xsk_map_ring(xsk, &xsk->tx, &off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) < 0) {
+        perror("mmap XDP ring failed");
+        xsk_close(xsk);
+        return -1;
+    }
+    
+    // 接收时前一半帧交给内核填充，其余作为空闲发送帧
+    xsk->free_frames = malloc(XSK_NUM_FRAMES * sizeof(uint64_t));
+    if (!xsk->free_frames) {
+        xsk_close(xsk);
+        return -1;
+    }
+    uint32_t first_free = 0;
+    if (want_rx) {
+        for (uint32_t i = 0; i < XSK_RING_SIZE; i++) {
+            ((uint64_t *)xsk->fill.descs)[i] = (uint64_t)i * XSK_FRAME_SIZE;
+        }
+        xsk->fill.local = XSK_RING_SIZE;
+        __atomic_store_n(xsk->fill.producer, xsk->fill.local, __ATOMIC_RELEASE);
+        first_free = XSK_RING_SIZE;
+    }
+    for (uint32_t i = first_free; i < XSK_NUM_FRAMES; i++) {
+        xsk->free_frames[xsk->free_count++] = (uint64_t)i * XSK_FRAME_SIZE;
+    }
+    
+    // 原生模式优先尝试零拷贝，驱动不支持时退回复制模式；通用模式只能复制
+    struct sockaddr_xdp sxdp;
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = ifindex;
+    sxdp.sxdp_queue_id = queue_id;
+    sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | (mode == XSK_MODE_NATIVE ? XDP_ZEROCOPY : XDP_COPY);
+    int ret = bind(xsk->fd, (struct sockaddr *)&sxdp, sizeof(sxdp));
+    if (ret < 0 && mode == XSK_MODE_NATIVE) {
+        sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_COPY;
+        ret = bind(xsk->fd, (struct sockaddr *)&sxdp, sizeof(sxdp));
+    } else if (ret == 0) {
+        xsk->zerocopy = (mode == XSK_MODE_NATIVE);
+    }
+    if (ret < 0) {
+        perror("bind AF_XDP socket failed");
+        xsk_close(xsk);
+        return -1;
+    }
+    return 0;
+}
+
+void xsk_close(xsk_t *xsk) {
+    xsk_unmap_ring(&xsk->rx);
+    xsk_unmap_ring(&xsk->tx);
+    xsk_unmap_ring(&xsk->fill);
+    xsk_unmap_ring(&xsk->comp);
+    if (xsk->fd >= 0) {
+        close(xsk->fd);
+    }
+    if (xsk->umem) {
+        munmap(xsk->umem, xsk->umem_size);
+    }
+    free(xsk->free_frames);
+    memset(xsk, 0, sizeof(*xsk));
+    xsk->fd = -1;
+}
+
+uint32_t xsk_recv(xsk_t *xsk, struct xdp_desc *descs, uint32_t max) {
+    uint32_t n = ring_cons_avail(&xsk->rx);
+    if (n > max) {
+        n = max;
+    }
+    const struct xdp_desc *ring = xsk->rx.descs;
+    for (uint32_t i = 0; i < n; i++) {
+        descs[i] = ring[(xsk->rx.local + i) & xsk->rx.mask];
+    }
+    xsk->rx.local += n;
+    __atomic_store_n(xsk->rx.consumer, xsk->rx.local, __ATOMIC_RELEASE);
+    return n;
+}
+
+void xsk_recycle(xsk_t *xsk, uint64_t addr) {
+    // 在途帧总数不超过填充环大小，填充环不会溢出
+    ((uint64_t *)xsk->fill.descs)[xsk->fill.local & xsk->fill.mask] = addr & ~(uint64_t)(XSK_FRAME_SIZE - 1);
+    xsk->fill.local++;
+}
+
+int xsk_tx_alloc(xsk_t *xsk, uint64_t *addr) {
+    if (xsk->free_count == 0) {
+        return -1;
+    }
+    *addr = xsk->free_frames[--xsk->free_count];
+    return 0;
+}
+
+void xsk_tx_release(xsk_t *xsk, uint64_t addr) {
+    xsk->free_frames[xsk->free_count++] = addr;
+}
+
+int xsk_send(xsk_t *xsk, uint64_t addr, uint32_t len) {
+    if (ring_prod_free(&xsk->tx) == 0) {
+        return -1;
+    }
+    struct xdp_desc *desc = &((struct xdp_desc *)xsk->tx.descs)[xsk->tx.local & xsk->tx.mask];
+    desc->addr = addr;
+    desc->len = len;
+    desc->options = 0;
+    xsk->tx.local++;
+    xsk->tx_pending++;
+    return 0;
+}
+
+void xsk_flush(xsk_t *xsk) {
+    if (xsk->has_rx && xsk->fill.local != *xsk->fill.producer) {
+        __atomic_store_n(xsk->fill.producer, xsk->fill.local, __ATOMIC_RELEASE);
+    }
+    if (xsk->tx.local != *xsk->tx.producer) {
+        __atomic_store_n(xsk->tx.producer, xsk->tx.local, __ATOMIC_RELEASE);
+    }
+    
+    // 复制模式下内核只在sendto()中处理发送环，零拷贝模式仅在设置NEED_WAKEUP时需要唤醒
+    if (xsk->tx_pending > 0 &&
+        (__atomic_load_n(xsk->tx.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP)) {
+        if (sendto(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 &&
+            errno != EAGAIN && errno != EBUSY && errno != ENOBUFS && errno != ENETDOWN) {
+            perror("AF_XDP tx wakeup failed");
+        }
+    }
+}
+
+uint32_t xsk_complete(xsk_t *xsk) {
+    uint32_t n = ring_cons_avail(&xsk->comp);
+    if (n == 0) {
+        return 0;
+    }
+    const uint64_t *ring = xsk->comp.descs;
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t addr = ring[(xsk->comp.local + i) & xsk->comp.mask];
+        if (xsk->has_rx) {
+            xsk_recycle(xsk, addr);
+        } else {
+            xsk->free_frames[xsk->free_count++] = addr;
+        }
+    }
+    xsk->comp.local += n;
+    __atomic_store_n(xsk->comp.consumer, xsk->comp.local, __ATOMIC_RELEASE);
+    xsk->tx_pending -= n;
+    return n;
+}
+
+int xsk_wait(xsk_t *xsk, int timeout_ms) {
+    struct pollfd pfd = { .fd = xsk->fd, .events = POLLIN };
+    return poll(&pfd, 1, timeout_ms);
+}
+
+void xsk_tx_prepare(xsk_t *xsk, const udp_path_t *path, const void *payload, size_t len) {
+    for (uint32_t i = 0; i < xsk->free_count; i++) {
+        char *frame = xsk_frame(xsk, xsk->free_frames[i]);
+        udp_frame_build(frame, path, len);
+        memcpy(frame + UDP_FRAME_HDR_LEN, payload, len);
+    }
+}
+
+int xsk_get_stats(const xsk_t *xsk, struct xdp_statistics *stats) {
+    socklen_t optlen = sizeof(*stats);
+    memset(stats, 0, sizeof(*stats));
+    return getsockopt(xsk->fd, SOL_XDP, XDP_STATISTICS, stats, &optlen);
+}
+
+// ==================== UDP/IP帧构造与解析 ====================
+
+static uint16_t ip_checksum(const void *data, size_t len) {
+    const uint16_t *p = data;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < len / 2; i++) {
+        sum += p[i];
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+size_t udp_frame_build(char *frame, const udp_path_t *path, size_t payload_len) {
+    struct ethhdr *eth = (struct ethhdr *)frame;
+    struct iphdr *ip = (struct iphdr *)(frame + ETH_HLEN);
+    struct udphdr *udp = (struct udphdr *)(frame + ETH_HLEN + sizeof(*ip));
+    
+    memcpy(eth->h_dest, path->dst_mac, ETH_ALEN);
+    memcpy(eth->h_source, path->src_mac, ETH_ALEN);
+    eth->h_proto = htons(ETH_P_IP);
+    
+    memset(ip, 0, sizeof(*ip));
+    ip->version = 4;
+    ip->ihl = 5;
+    ip->tot_len = htons(sizeof(*ip) + sizeof(*udp) + payload_len);
+    ip->frag_off = htons(IP_DF);
+    ip->ttl = 64;
+    ip->protocol = IPPROTO_UDP;
+    ip->saddr = path->src.sin_addr.s_addr;
+    ip->daddr = path->dst.sin_addr.s_addr;
+    ip->check = ip_checksum(ip, sizeof(*ip));
+    
+    // IPv4的UDP校验和可选，置0省去对负载逐包求和
+    udp->source = path->src.sin_port;
+    udp->dest = path->dst.sin_port;
+    udp->len = htons(sizeof(*udp) + payload_len);
+    udp->check = 0;
+    return UDP_FRAME_HDR_LEN + payload_len;
+}
+
+int udp_frame_parse(char *frame, uint32_t len, char **payload, uint32_t *payload_len,
+                    struct sockaddr_in *src) {
+    if (len < UDP_FRAME_HDR_LEN) {
+        return -1;
+    }
+    struct ethhdr *eth = (struct ethhdr *)frame;
+    struct iphdr *ip = (struct iphdr *)(frame + ETH_HLEN);
+    if (eth->h_proto != htons(ETH_P_IP) || ip->version != 4 || ip->protocol != IPPROTO_UDP) {
+        return -1;
+    }
+    size_t ip_hlen = (size_t)ip->ihl * 4;
+    if (ip_hlen < sizeof(*ip) || len < ETH_HLEN + ip_hlen + sizeof(struct udphdr)) {
+        return -1;
+    }
+    
+    // 以UDP长度为准（短帧可能带有以太网填充）
+    struct udphdr *udp = (struct udphdr *)(frame + ETH_HLEN + ip_hlen);
+    size_t udp_len = ntohs(udp->len);
+    if (udp_len < sizeof(*udp) || ETH_HLEN + ip_hlen + udp_len > len) {
+        return -1;
+    }
+    *payload = (char *)udp + sizeof(*udp);
+    *payload_len = (uint32_t)(udp_len - sizeof(*udp));
+    if (src) {
+        memset(src, 0, sizeof(*src));
+        src->sin_family = AF_INET;
+        src->sin_addr.s_addr = ip->saddr;
+        src->sin_port = udp->source;
+    }
+    return 0;
+}
+
+void udp_frame_reflect(char *frame) {
+    struct ethhdr *eth = (struct ethhdr *)frame;
+    struct iphdr *ip = (struct iphdr *)(frame + ETH_HLEN);
+    struct udphdr *udp = (struct udphdr *)(frame + ETH_HLEN + (size_t)ip->ihl * 4);
+    
+    uint8_t mac[ETH_ALEN];
+    memcpy(mac, eth->h_dest, ETH_ALEN);
+    memcpy(eth->h_dest, eth->h_source, ETH_ALEN);
+    memcpy(eth->h_source, mac, ETH_ALEN);
+    
+    uint32_t addr = ip->saddr;
+    ip->saddr = ip->daddr;
+    ip->daddr = addr;
+    
+    uint16_t port = udp->source;
+    udp->source = udp->dest;
+    udp->dest = port;
+    
+    // 发送端启用校验和卸载时（如veth），收到的UDP校验和可能只是伪首部部分和，回送时置0（IPv4允许）
+    udp->check = 0;
+}
+
+// ==================== 网卡与邻居解析 ====================
+
+int xdp_iface_by_addr(const char *ip, char *ifname, size_t len) {
+    struct in_addr addr;
+    struct ifaddrs *ifas;
+    if (inet_aton(ip, &addr) == 0 || getifaddrs(&ifas) < 0) {
+        return -1;
+    }
+    int ret = -1;
+    for (struct ifaddrs *ifa = ifas; ifa != NULL; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_INET &&
+            ((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr == addr.s_addr) {
+            snprintf(ifname, len, "%s", ifa->ifa_name);
+            ret = 0;
+            break;
+        }
+    }
+    freeifaddrs(ifas);
+    return ret;
+}
+
+// 在/proc/net/route中按最长前缀匹配查找经由iface到dst的网关，直连时返回dst本身
+static uint32_t route_next_hop(const char *iface, uint32_t dst) {
+    FILE *fp = fopen("/proc/net/route", "r");
+    if (!fp) {
+        return dst;
+    }
+    char line[256];
+    uint32_t next_hop = dst;
+    int best_len = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        char name[IF_NAMESIZE + 1];
+        unsigned int dest, gateway, flags, mask;
+        if (sscanf(line, "%16s %x %x %x %*d %*d %*d %x", name, &dest, &gateway, &flags, &mask) != 5 ||
+            strcmp(name, iface) != 0 || (dst & mask) != dest) {
+            continue;
+        }
+        int prefix_len = __builtin_popcount(mask);
+        if (prefix_len > best_len) {
+            best_len = prefix_len;
+            next_hop = gateway != 0 ? gateway : dst;
+        }
+    }
+    fclose(fp);
+    return next_hop;
+}
+
+// 在/proc/net/arp中查找iface上ip的已解析MAC
+static int arp_lookup(const char *iface, uint32_t ip, uint8_t *mac) {
+    FILE *fp = fopen("/proc/net/arp", "r");
+    if (!fp) {
+        return -1;
+    }
+    char line[256];
+    int ret = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        char ip_str[INET_ADDRSTRLEN], dev[IF_NAMESIZE + 1];
+        unsigned int flags, m[ETH_ALEN];
+        struct in_addr addr;
+        if (sscanf(line, "%15s %*x %x %x:%x:%x:%x:%x:%x %*s %16s", ip_str, &flags,
+                   &m[0], &m[1], &m[2], &m[3], &m[4], &m[5], dev) != 9 ||
+            inet_aton(ip_str, &addr) == 0 || addr.s_addr != ip || strcmp(dev, iface) != 0 ||
+            !(flags & 0x2)) {   // ATF_COM：已完成解析
+            continue;
+        }
+        for (int i = 0; i < ETH_ALEN; i++) {
+            mac[i] = (uint8_t)m[i];
+        }
+        ret = 0;
+        break;
+    }
+    fclose(fp);
+    return ret;
+}
+
+int xdp_resolve_path(const char *iface, const struct sockaddr_in *dst, uint16_t src_port,
+                     udp_path_t *path, int *ifindex, int *mtu) {
+    memset(path, 0, sizeof(*path));
+    path->dst = *dst;
+    
+    // 由内核路由选择源地址：对目的地址connect()一个临时UDP socket后读取本地地址
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    socklen_t len = sizeof(path->src);
+    if (connect(fd, (const struct sockaddr *)dst, sizeof(*dst)) < 0 ||
+        getsockname(fd, (struct sockaddr *)&path->src, &len) < 0) {
+        perror("Failed to route to server");
+        close(fd);
+        return -1;
+    }
+    path->src.sin_port = src_port;
+    
+    char ifname[IF_NAMESIZE];
+    if (iface) {
+        snprintf(ifname, sizeof(ifname), "%s", iface);
+    } else if (xdp_iface_by_addr(inet_ntoa(path->src.sin_addr), ifname, sizeof(ifname)) < 0) {
+        fprintf(stderr, "Error: No interface owns source address %s\n", inet_ntoa(path->src.sin_addr));
+        close(fd);
+        return -1;
+    }
+    
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    *ifindex = (int)if_nametoindex(ifname);
+    if (*ifindex == 0 || ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
+        fprintf(stderr, "Error: Cannot query interface %s: %s\n", ifname, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    memcpy(path->src_mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+    *mtu = ioctl(fd, SIOCGIFMTU, &ifr) == 0 ? ifr.ifr_mtu : 1500;
+    
+    // 下一跳MAC：ARP表中没有时发一个空包到discard端口触发解析
+    uint32_t next_hop = route_next_hop(ifname, dst->sin_addr.s_addr);
+    int resolved = arp_lookup(ifname, next_hop, path->dst_mac) == 0;
+    if (!resolved) {
+        struct sockaddr_in probe = *dst;
+        probe.sin_port = htons(9);
+        sendto(fd, NULL, 0, 0, (struct sockaddr *)&probe, sizeof(probe));
+        for (int waited = 0; !resolved && waited < NEIGH_RESOLVE_TIMEOUT_MS; waited += 10) {
+            usleep(10000);
+            resolved = arp_lookup(ifname, next_hop, path->dst_mac) == 0;
+        }
+    }
+    close(fd);
+    if (!resolved) {
+        struct in_addr hop = { .s_addr = next_hop };
+        fprintf(stderr, "Error: Cannot resolve MAC address of next hop %s on %s\n", inet_ntoa(hop), ifname);
+        return -1;
+    }
+    return 0;
+}
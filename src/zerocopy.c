@@ -0,0 +1,74 @@
+#include "../include/common.h"
+#include "../include/zerocopy.h"
+#include <poll.h>
+#include <linux/errqueue.h>
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+int zc_enable(int sockfd) {
+    int opt = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt)) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int zc_read_completions(int sockfd, zc_stats_t *stats) {
+    char control[128];
+    struct msghdr msg;
+    int total = 0;
+    
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        
+        if (recvmsg(sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return total;
+        }
+        
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                  (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            struct sock_extended_err serr;
+            memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+            if (serr.ee_errno != 0 || serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            
+            // 一条通知覆盖编号区间[ee_info, ee_data]（32位，可能回绕）
+            uint32_t n = serr.ee_data - serr.ee_info + 1;
+            stats->completed += n;
+            if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                stats->copied += n;
+            }
+            total += n;
+        }
+    }
+}
+
+int zc_wait_completions(int sockfd, zc_stats_t *stats, int timeout_ms) {
+    // 错误队列非空时poll()总会返回POLLERR，无需订阅其他事件
+    struct pollfd pfd = { .fd = sockfd, .events = 0 };
+    if (poll(&pfd, 1, timeout_ms) <= 0 || !(pfd.revents & POLLERR)) {
+        return 0;
+    }
+    return zc_read_completions(sockfd, stats);
+}
+
+void zc_print_report(const zc_stats_t *stats) {
+    uint64_t zerocopy = stats->completed - stats->copied;
+    printf("零拷贝发送: %lu 次调用, 已完成 %lu 次, 其中零拷贝 %lu 次 (%.1f%%), 回退复制 %lu 次\n",
+           stats->calls, stats->completed, zerocopy,
+           stats->completed > 0 ? zerocopy * 100.0 / stats->completed : 0.0, stats->copied);
+    if (stats->completed > 0 && stats->copied == stats->completed) {
+        printf("[INFO] 所有发送都回退为复制（回环接口或网卡不支持零拷贝时属正常现象）\n");
+    }
+}